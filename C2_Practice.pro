@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,19 +9,61 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    alternatives.cpp \
+    anytimesearch.cpp \
     canvas.cpp \
+    cellgrid.cpp \
+    clearance.cpp \
+    connectivity.cpp \
     field.cpp \
+    flowfield.cpp \
+    frontiersearch.cpp \
+    geometry.cpp \
+    gridsearch.cpp \
+    hierarchy.cpp \
+    landmarks.cpp \
+    lineofsight.cpp \
+    liveplanner.cpp \
     main.cpp \
     mainwindow.cpp \
+    mapjournal.cpp \
+    maploader.cpp \
+    mapsnapshot.cpp \
+    multiagent.cpp \
+    quadtree.cpp \
+    sweepline.cpp \
+    tourplanner.cpp \
+    tracerecorder.cpp \
     utils.cpp
 
 HEADERS += \
+    alternatives.h \
+    anytimesearch.h \
     canvas.h \
+    cellgrid.h \
+    clearance.h \
+    connectivity.h \
     field.h \
+    flowfield.h \
+    frontiersearch.h \
+    geometry.h \
+    gridsearch.h \
+    hierarchy.h \
+    landmarks.h \
+    lineofsight.h \
+    liveplanner.h \
     mainwindow.h \
+    mapjournal.h \
+    maploader.h \
+    mapsnapshot.h \
     meshpoint.h \
+    multiagent.h \
     obstacle.h \
     prioqueue.h \
+    quadtree.h \
+    sweepline.h \
+    tourplanner.h \
+    tracerecorder.h \
     utils.h
 
 FORMS += \
@@ -0,0 +1,236 @@
+//!
+//! Альтернативные маршруты методом плато.
+//! Один поиск в обе стороны: дерево кратчайших путей Дейкстры от старта и обратное дерево от финиша
+//! (оба ограничены стоимостью `(1 + stretch)` от кратчайшей, обратное строится в пуле потоков параллельно
+//! прямому). Плато -- цепочка клеток, рёбра которой лежат в обоих деревьях сразу; через любую клетку
+//! плато проходит маршрут "по прямому дереву до плато, по обратному -- от плато до финиша", и на всём
+//! плато этот маршрут локально кратчайший. Длинное плато -- отдельный коридор карты, короткое -- петля
+//! вокруг кратчайшего пути, поэтому кандидаты перебираются по убыванию длины плато.
+//! Кандидат принимается, если с каждым уже принятым маршрутом он делит не больше `1 - diversity` своей
+//! стоимости. Общей считается клетка в коридоре шириной `corridor` клеток вокруг принятого маршрута:
+//! иначе на ровном поле соседние "лесенки" одинаковой длины считались бы непохожими
+//!
+
+#include <algorithm>
+#include <limits>
+#include <QtConcurrent>
+#include <QDebug>
+#include <QElapsedTimer>
+#include "alternatives.h"
+
+static const double infinity = std::numeric_limits<double>::infinity();
+static const QPoint evenOffsets[4] = { QPoint(0, 1), QPoint(0, -1), QPoint(-1, 0), QPoint(1, 0) };
+static const QPoint oddOffsets[4] = { QPoint(1, 0), QPoint(-1, 0), QPoint(0, -1), QPoint(0, 1) };
+
+//!
+//! \param mesh Сетка
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//!
+AlternativeRoutes::AlternativeRoutes(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows)
+    : mesh(mesh), cols(cols), rows(rows) {
+}
+
+//!
+//! Учитывать размер агента: клетки, где агент радиуса radius не помещается, считаются стенами
+//!
+//! \param map Карта расстояний до стен (0 -- не учитывать)
+//! \param radius Радиус агента в клетках сетки
+//!
+void AlternativeRoutes::setClearance(const ClearanceMap* map, float radius) {
+    clearance = map;
+    this->radius = radius;
+}
+
+//!
+//! Количество плато, найденных последним поиском
+//!
+int AlternativeRoutes::candidates() const {
+    return found;
+}
+
+//!
+//! Найти до count заметно разных маршрутов
+//! Стоимость считается так же, как в `Field::aStarPath`: старт стоит 1, шаг -- 1 + непроходимость клетки.
+//! Первый маршрут -- кратчайший, остальные идут в порядке отбора
+//!
+//! \param start Начальная клетка (координаты на сетке)
+//! \param finish Конечная клетка (координаты на сетке)
+//! \param count Сколько маршрутов нужно (не больше `maxRoutes`)
+//! \param diversity Доля стоимости маршрута, которая должна идти в стороне от каждого уже принятого (0..1)
+//! \param stretch Насколько маршрут может быть дороже кратчайшего (0.4 -- на 40%)
+//! \param routes Вектор для сохранения клеток маршрутов от старта к финишу
+//! \param costs Вектор для сохранения стоимостей маршрутов
+//! \return Количество найденных маршрутов (0, если пути нет)
+//!
+int AlternativeRoutes::find(const QPoint& start, const QPoint& finish, int count, double diversity, double stretch, QVector<QVector<QPoint>>& routes, QVector<double>& costs) {
+    QElapsedTimer timer;
+    timer.start();
+    routes.clear();
+    costs.clear();
+    found = 0;
+    count = qBound(0, count, (int)maxRoutes);
+    diversity = qBound(0., diversity, 1.);
+    if (count == 0 || start.x() < 0 || start.y() < 0 || start.x() >= cols || start.y() >= rows) return 0;
+    if (finish.x() < 0 || finish.y() < 0 || finish.x() >= cols || finish.y() >= rows) return 0;
+
+    prepare();
+    int si = start.x() * rows + start.y();
+    int fi = finish.x() * rows + finish.y();
+    if (step[si] < 0 || step[fi] < 0) return 0;
+    if (si == fi) {
+        routes.append({ start });
+        costs.append(1.);
+        return 1;
+    }
+
+    QFuture<void> pending = QtConcurrent::run([this, fi, si, stretch]() { grow(backward, fi, si, stretch, true); });
+    grow(forward, si, fi, stretch, false);
+    pending.waitForFinished();
+    if (forward.dist[fi] == infinity) return 0;
+    double shortest = forward.dist[fi];
+    double limit = shortest * (1. + stretch);
+
+    // Плато: цепочки рёбер c -> backward.parent[c], для которых forward.parent[backward.parent[c]] == c
+    auto plateauEdge = [this](int c) {
+        int n = backward.parent[c];
+        return n >= 0 && forward.parent[n] == c;
+    };
+    QVector<Plateau> plateaus;
+    for (int c = 0; c < cols * rows; c++) {
+        if (forward.dist[c] == infinity || backward.dist[c] == infinity || !plateauEdge(c)) continue;
+        int p = forward.parent[c];
+        if (p >= 0 && backward.parent[p] == c) continue;
+        double cost = forward.dist[c] + backward.dist[c];
+        if (cost > limit) continue;
+        int e = c;
+        while (plateauEdge(e)) e = backward.parent[e];
+        double length = forward.dist[e] - forward.dist[c];
+        if (c != si && length < minPlateau * cost) continue;
+        plateaus.append({ c, cost, length });
+    }
+    found = plateaus.size();
+    // Кратчайший маршрут идёт первым, остальные -- по убыванию длины плато
+    std::sort(plateaus.begin(), plateaus.end(), [](const Plateau& a, const Plateau& b) {
+        return a.length > b.length || (a.length == b.length && a.cost < b.cost);
+    });
+    auto best = std::min_element(plateaus.begin(), plateaus.end(), [](const Plateau& a, const Plateau& b) {
+        return a.cost < b.cost || (a.cost == b.cost && a.length > b.length);
+    });
+    if (best != plateaus.end()) std::rotate(plateaus.begin(), best, best + 1);
+
+    int corridor = qMax((int)minCorridor, qRound(corridorFraction * ((finish - start).manhattanLength())));
+    QVector<int> cover(cols * rows, 0);
+    QVector<int> stamp(cols * rows, -1);
+    QVector<int> cells;
+    for (int k = 0; k < plateaus.size() && routes.size() < count; k++) {
+        if (!route(plateaus[k], cells, stamp, k)) continue;
+
+        bool distinct = true;
+        for (int r = 0; r < routes.size() && distinct; r++) {
+            double shared = 0.;
+            for (int c : cells) {
+                if (cover[c] & (1 << r)) shared += step[c];
+            }
+            distinct = shared <= (1. - diversity) * plateaus[k].cost;
+        }
+        if (!distinct) continue;
+
+        int bit = 1 << routes.size();
+        QVector<QPoint> points;
+        for (int c : cells) {
+            int x = c / rows, y = c % rows;
+            points.append(QPoint(x, y));
+            for (int i = qMax(0, x - corridor); i <= qMin(cols - 1, x + corridor); i++) {
+                int* column = cover.data() + i * rows;
+                for (int j = qMax(0, y - corridor); j <= qMin(rows - 1, y + corridor); j++) column[j] |= bit;
+            }
+        }
+        routes.append(points);
+        costs.append(plateaus[k].cost);
+    }
+
+    qInfo() << "AlternativeRoutes::find" << routes.size() << "of" << found << "plateaus in" << timer.elapsed() << "ms";
+    return routes.size();
+}
+
+//!
+//! Стоимость шага в каждую клетку (индекс `i * rows + j`), -1 -- клетка непроходима
+//!
+void AlternativeRoutes::prepare() {
+    step.fill(-1., cols * rows);
+    for (auto it = mesh.constBegin(); it != mesh.constEnd(); ++it) {
+        const QPoint& p = it.key();
+        if (p.x() >= cols || p.y() >= rows || it->walkness >= 1.) continue;
+        int cell = p.x() * rows + p.y();
+        if (clearance != 0 && !clearance->passable(cell, radius)) continue;
+        step[cell] = 1. + it->walkness;
+    }
+}
+
+//!
+//! Построить дерево кратчайших путей Дейкстры
+//! Поиск идёт до опустошения очереди или пока стоимость не превысит `(1 + stretch)` от стоимости до goal
+//!
+//! \param tree Дерево (расстояния и родители)
+//! \param root Корень дерева
+//! \param goal Клетка на другом конце маршрута
+//! \param stretch Допустимое удлинение маршрута
+//! \param reverse Обратное дерево: расстояние -- стоимость пути от клетки до корня без стоимости самой клетки,
+//! родитель -- следующая клетка к корню
+//!
+void AlternativeRoutes::grow(Tree& tree, int root, int goal, double stretch, bool reverse) {
+    tree.dist.fill(infinity, cols * rows);
+    tree.parent.fill(-1, cols * rows);
+    PriorityQueue<int, double> queue;
+    tree.dist[root] = reverse ? 0. : 1.;
+    queue.put(root, tree.dist[root]);
+
+    double limit = infinity;
+    while (!queue.empty()) {
+        double key = queue.top().first;
+        int ci = queue.get();
+        if (key > tree.dist[ci]) continue;
+        if (key > limit) break;
+        if (ci == goal) limit = (key + (reverse ? 1. : 0.)) * (1. + stretch);
+
+        QPoint current(ci / rows, ci % rows);
+        const QPoint* offsets = (current.x() + current.y()) % 2 == 0 ? evenOffsets : oddOffsets;
+        for (int k = 0; k < 4; k++) {
+            QPoint next = current + offsets[k];
+            if (next.x() < 0 || next.y() < 0 || next.x() >= cols || next.y() >= rows) continue;
+            int ni = next.x() * rows + next.y();
+            if (step[ni] < 0) continue;
+            double cost = key + (reverse ? step[ci] : step[ni]);
+            if (cost < tree.dist[ni]) {
+                tree.dist[ni] = cost;
+                tree.parent[ni] = ci;
+                queue.put(ni, cost);
+            }
+        }
+    }
+}
+
+//!
+//! Собрать маршрут через начало плато: по прямому дереву от старта, по обратному до финиша
+//!
+//! \param plateau Плато
+//! \param cells Вектор для сохранения клеток маршрута от старта к финишу
+//! \param stamp Метки посещения клеток
+//! \param mark Метка этого маршрута
+//! \return false, если маршрут проходит через одну клетку дважды
+//!
+bool AlternativeRoutes::route(const Plateau& plateau, QVector<int>& cells, QVector<int>& stamp, int mark) const {
+    cells.clear();
+    for (int c = plateau.first; c >= 0; c = forward.parent[c]) {
+        stamp[c] = mark;
+        cells.append(c);
+    }
+    std::reverse(cells.begin(), cells.end());
+    for (int c = backward.parent[plateau.first]; c >= 0; c = backward.parent[c]) {
+        if (stamp[c] == mark) return false;
+        stamp[c] = mark;
+        cells.append(c);
+    }
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef ALTERNATIVES_H
+#define ALTERNATIVES_H
+
+#include <QVector>
+#include <QHash>
+#include <QPoint>
+#include "meshpoint.h"
+#include "prioqueue.h"
+#include "clearance.h"
+
+class AlternativeRoutes {
+public:
+    static constexpr int maxRoutes = 16;
+    static constexpr double defaultStretch = 0.4;
+    static constexpr double minPlateau = 0.1;
+    static constexpr double corridorFraction = 0.03;
+    static constexpr int minCorridor = 2;
+
+    AlternativeRoutes(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows);
+    void setClearance(const ClearanceMap* map, float radius);
+    int find(const QPoint& start, const QPoint& finish, int count, double diversity, double stretch, QVector<QVector<QPoint>>& routes, QVector<double>& costs);
+    int candidates() const;
+
+protected:
+    const QHash<QPoint, MeshPoint>& mesh;
+    int cols, rows;
+    const ClearanceMap* clearance = 0;
+    float radius = 0.f;
+
+    struct Tree {
+        QVector<double> dist;
+        QVector<int> parent;
+    };
+
+    struct Plateau {
+        int first;
+        double cost;
+        double length;
+    };
+
+    QVector<double> step;
+    Tree forward, backward;
+    int found = 0;
+
+    void prepare();
+    void grow(Tree& tree, int root, int goal, double stretch, bool reverse);
+    bool route(const Plateau& plateau, QVector<int>& cells, QVector<int>& stamp, int mark) const;
+};
+
+#endif // ALTERNATIVES_H
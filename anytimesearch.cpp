@@ -0,0 +1,214 @@
+//!
+//! Поиск пути с ограничением по времени: ARA* (Anytime Repairing A*).
+//! Первый путь ищется взвешенным A* с ключом g + ε·h -- быстро, но с длиной не более ε от кратчайшей.
+//! Затем ε понижается, и поиск продолжается с тем же состоянием: клетки, стоимость которых
+//! улучшилась после закрытия, копятся в списке несогласованных и на следующей итерации возвращаются
+//! в открытый список, поэтому каждая итерация раскрывает только то, что изменилось.
+//! Поиск останавливается по дедлайну или когда ε = 1 (путь кратчайший).
+//! Первая итерация доводится до конца даже после дедлайна, чтобы всегда был ответ
+//!
+
+#include <algorithm>
+#include <QDebug>
+#include "anytimesearch.h"
+
+static const double infinity = std::numeric_limits<double>::infinity();
+static const QPoint evenOffsets[4] = { QPoint(0, 1), QPoint(0, -1), QPoint(-1, 0), QPoint(1, 0) };
+static const QPoint oddOffsets[4] = { QPoint(1, 0), QPoint(-1, 0), QPoint(0, -1), QPoint(0, 1) };
+
+//!
+//! \param mesh Сетка
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//! \param heuristic Согласованная эвристика (как `Field::heuristic`)
+//!
+AnytimeSearch::AnytimeSearch(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, const Heuristic& heuristic)
+    : mesh(mesh), cols(cols), rows(rows), heuristic(heuristic) {
+}
+
+//!
+//! Учитывать размер агента: клетки, где агент радиуса radius не помещается, считаются стенами
+//!
+//! \param map Карта расстояний до стен (0 -- не учитывать)
+//! \param radius Радиус агента в клетках сетки
+//!
+void AnytimeSearch::setClearance(const ClearanceMap* map, float radius) {
+    clearance = map;
+    this->radius = radius;
+}
+
+//!
+//! Найти путь к дедлайну
+//! Стоимость считается так же, как в `Field::aStarPath`: старт стоит 1, шаг -- 1 + непроходимость клетки
+//!
+//! \param start Начальная клетка (координаты на сетке)
+//! \param finish Конечная клетка (координаты на сетке)
+//! \param deadline Время на поиск в миллисекундах
+//! \param cells Вектор для сохранения клеток лучшего найденного пути от старта к финишу
+//! \return Стоимость пути, если путь найден
+//! \return 0, если путь не найден
+//!
+double AnytimeSearch::find(const QPoint& start, const QPoint& finish, int deadline, QVector<QPoint>& cells) {
+    clock.start();
+    cells.clear();
+    states.clear();
+    inconsistent.clear();
+    queue = PriorityQueue<int, double>();
+    goal = finish;
+    goalIndex = finish.x() * rows + finish.y();
+    epsilon = initialEpsilon;
+    iteration = 0;
+    reached = infinity;
+
+    int startIndex = start.x() * rows + start.y();
+    if (walknessAt(startIndex) >= 1. || walknessAt(goalIndex) >= 1.) return 0;
+    State& first = state(startIndex);
+    first.g = 1.;
+    first.open = true;
+    queue.put(startIndex, key(first));
+
+    double cost = 0;
+    while (improve(deadline, iteration == 0)) {
+        double found = state(goalIndex).g;
+        if (found == infinity) break;
+
+        // Путь по предкам может быть дешевле g финиша: улучшения закрытых клеток ещё не распространились
+        cells.clear();
+        cost = 1.;
+        for (int ci = goalIndex; ci != -1; ci = states[ci].parent) {
+            cells.append(coord(ci));
+            if (ci != startIndex) cost += 1. + walknessAt(ci);
+        }
+        std::reverse(cells.begin(), cells.end());
+        reached = qMax(1., qMin(epsilon, cost / lowerBound()));
+        qInfo() << "AnytimeSearch::iteration" << iteration << "Epsilon" << epsilon << "Bound" << reached << "Cost" << cost << "at" << clock.elapsed() << "ms";
+        iteration++;
+
+        if (epsilon <= 1. || reached <= 1. || clock.elapsed() >= deadline) break;
+        epsilon = qMax(1., epsilon - epsilonStep);
+        for (int ci : inconsistent) {
+            State& st = states[ci];
+            st.incons = false;
+            st.open = true;
+        }
+        inconsistent.clear();
+        reorder();
+    }
+    if (cost == 0) reached = infinity;
+    return cost;
+}
+
+//!
+//! Гарантированная оценка: длина найденного пути не больше кратчайшей, умноженной на это число
+//!
+double AnytimeSearch::bound() const {
+    return reached;
+}
+
+//!
+//! Количество завершённых итераций последнего поиска
+//!
+int AnytimeSearch::iterations() const {
+    return iteration;
+}
+
+//!
+//! Итерация взвешенного A* с текущим ε (ImprovePath)
+//!
+//! \param deadline Время на поиск в миллисекундах
+//! \param first Первая итерация (не прерывается по дедлайну)
+//! \return true если итерация завершена, false если прервана по дедлайну
+//!
+bool AnytimeSearch::improve(int deadline, bool first) {
+    int expanded = 0;
+    while (true) {
+        // Устаревшие записи очереди: клетка закрыта или её ключ изменился
+        while (!queue.empty()) {
+            const PriorityQueue<int, double>::element& top = queue.top();
+            const State& st = states[top.second];
+            if (st.open && qAbs(top.first - key(st)) < 1e-9) break;
+            queue.get();
+        }
+        if (queue.empty()) return true;
+        if (state(goalIndex).g <= queue.top().first) return true;
+        if (!first && ++expanded % deadlineCheck == 0 && clock.elapsed() >= deadline) return false;
+
+        int ci = queue.get();
+        State& current = states[ci];
+        current.open = false;
+        current.closed = iteration;
+        double base = current.g;
+
+        QPoint cell = coord(ci);
+        const QPoint* offsets = (cell.x() + cell.y()) % 2 == 0 ? evenOffsets : oddOffsets;
+        for (int k = 0; k < 4; k++) {
+            QPoint next = cell + offsets[k];
+            if (next.x() < 0 || next.y() < 0 || next.x() >= cols || next.y() >= rows) continue;
+            int ni = next.x() * rows + next.y();
+            double w = walknessAt(ni);
+            if (w >= 1.) continue;
+
+            State& neighbor = state(ni);
+            double cost = base + 1. + w;
+            if (cost >= neighbor.g) continue;
+            neighbor.g = cost;
+            neighbor.parent = ci;
+            if (neighbor.closed != iteration) {
+                neighbor.open = true;
+                queue.put(ni, key(neighbor));
+            } else if (!neighbor.incons) {
+                neighbor.incons = true;
+                inconsistent.append(ni);
+            }
+        }
+    }
+}
+
+//!
+//! Состояние клетки; создаётся при первом обращении с g = ∞
+//!
+AnytimeSearch::State& AnytimeSearch::state(int cell) {
+    auto it = states.find(cell);
+    if (it == states.end()) {
+        State st;
+        st.g = infinity;
+        st.h = heuristic(coord(cell), goal);
+        it = states.insert(cell, st);
+    }
+    return *it;
+}
+
+double AnytimeSearch::key(const State& st) const {
+    return st.g + epsilon * st.h;
+}
+
+double AnytimeSearch::walknessAt(int cell) const {
+    if (clearance != 0 && !clearance->passable(cell, radius)) return 1.;
+    auto it = mesh.constFind(coord(cell));
+    return it == mesh.constEnd() ? 1. : it->walkness;
+}
+
+//!
+//! Перестроить очередь открытых клеток с ключами для нового ε
+//!
+void AnytimeSearch::reorder() {
+    queue = PriorityQueue<int, double>();
+    for (auto it = states.constBegin(); it != states.constEnd(); ++it) {
+        if (it->open) queue.put(it.key(), key(*it));
+    }
+}
+
+//!
+//! Нижняя оценка стоимости кратчайшего пути: min(g + h) по открытым и несогласованным клеткам
+//!
+double AnytimeSearch::lowerBound() const {
+    double result = infinity;
+    for (auto it = states.constBegin(); it != states.constEnd(); ++it) {
+        if (it->open || it->incons) result = qMin(result, it->g + it->h);
+    }
+    return result;
+}
+
+QPoint AnytimeSearch::coord(int cell) const {
+    return QPoint(cell / rows, cell % rows);
+}
@@ -0,0 +1,64 @@
+#ifndef ANYTIMESEARCH_H
+#define ANYTIMESEARCH_H
+
+#include <functional>
+#include <limits>
+#include <QVector>
+#include <QHash>
+#include <QPoint>
+#include <QElapsedTimer>
+#include "meshpoint.h"
+#include "prioqueue.h"
+#include "clearance.h"
+
+class AnytimeSearch {
+public:
+    typedef std::function<double(const QPoint&, const QPoint&)> Heuristic;
+
+    static constexpr double initialEpsilon = 3.;
+    static constexpr double epsilonStep = 0.5;
+    static constexpr int deadlineCheck = 256;
+
+    AnytimeSearch(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, const Heuristic& heuristic);
+    void setClearance(const ClearanceMap* map, float radius);
+    double find(const QPoint& start, const QPoint& finish, int deadline, QVector<QPoint>& cells);
+    double bound() const;
+    int iterations() const;
+
+protected:
+    const QHash<QPoint, MeshPoint>& mesh;
+    int cols, rows;
+    Heuristic heuristic;
+    const ClearanceMap* clearance = 0;
+    float radius = 0.f;
+
+    struct State {
+        double g;
+        double h;
+        int parent = -1;
+        int closed = -1;
+        bool open = false;
+        bool incons = false;
+    };
+
+    QHash<int, State> states;
+    QVector<int> inconsistent;
+    PriorityQueue<int, double> queue;
+
+    QPoint goal;
+    int goalIndex = -1;
+    double epsilon = 1.;
+    int iteration = 0;
+    double reached = 1.;
+    QElapsedTimer clock;
+
+    bool improve(int deadline, bool first);
+    State& state(int cell);
+    double key(const State& st) const;
+    double walknessAt(int cell) const;
+    void reorder();
+    double lowerBound() const;
+    QPoint coord(int cell) const;
+};
+
+#endif // ANYTIMESEARCH_H
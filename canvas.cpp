@@ -3,15 +3,33 @@
 //! В основном используется для обработки и управления внутренним 'Полем'.
 //!
 
+#include <QtConcurrent>
+#include <QtMath>
 #include "canvas.h"
 #include "utils.h"
 
 Canvas::Canvas(QWidget* parent) : QWidget(parent) {
     setFocusPolicy(Qt::StrongFocus);
     setAttribute(Qt::WA_Hover);
+    repaintTimer.setSingleShot(true);
+    connect(&repaintTimer, &QTimer::timeout, this, &Canvas::flushDamage);
+    lastRepaint.start();
+    connect(&previewWatcher, &QFutureWatcher<bool>::finished, this, &Canvas::previewFinished);
+    loadTimer.setInterval(loadPollInterval);
+    connect(&loadTimer, &QTimer::timeout, this, &Canvas::pollLoad);
+    connect(&loadWatcher, &QFutureWatcher<int>::finished, this, &Canvas::loadFinished);
+    connect(&installWatcher, &QFutureWatcher<void>::finished, this, &Canvas::installFinished);
 }
 
 Canvas::~Canvas() {
+    previewActive = false;
+    previewWatcher.waitForFinished();
+    if (loader != 0) {
+        loader->cancel();
+        loadWatcher.waitForFinished();
+        installWatcher.waitForFinished();
+        delete loader;
+    }
     delete field;
 }
 
@@ -20,21 +38,28 @@ Canvas::~Canvas() {
 //! \param a Действие
 //!
 void Canvas::setAction(CanvasAction a) {
+    // Пока карта загружается, поле занято потоком загрузки
+    if (loader != 0) return;
     switch (action) {
         case POLYGON_CREATE:
             endDraw();
             break;
         case POLYGON_DELETE:
             if (changes) {
+                if (!field->getCrossings().isEmpty()) field->validateObstacles();
                 field->regenMesh();
                 wayLength = field->findPath();
             }
             break;
         case POLYGON_EDIT:
-            if (changes) field->regenMesh();
+            if (changes) {
+                field->validateObstacles();
+                field->regenMesh();
+            }
             break;
         case START:
         case END:
+        case STOPS:
             wayLength = field->findPath();
         default:
             break;
@@ -59,6 +84,30 @@ Field* Canvas::getField() {
     return field;
 }
 
+//!
+//! Начать запись трассы изменений карты и запросов пути
+//!
+//! \param path Путь до файла трассы
+//! \return Успех или нет
+//!
+bool Canvas::startTrace(const QString& path) {
+    if (!trace.open(path)) return false;
+    field->setTrace(&trace);
+    return true;
+}
+
+//!
+//! Закончить запись трассы
+//!
+void Canvas::stopTrace() {
+    field->setTrace(0);
+    trace.close();
+}
+
+bool Canvas::isTracing() const {
+    return trace.isOpen();
+}
+
 //!
 //! Событие показа холста.
 //! Используется для отложенной инициализации внутреннего поля.
@@ -73,7 +122,7 @@ void Canvas::showEvent(QShowEvent*) {
 //!
 //! Событие отрисовки холста.
 //!
-void Canvas::paintEvent(QPaintEvent*) {
+void Canvas::paintEvent(QPaintEvent* event) {
     QPainter painter;
 
     painter.begin(this);
@@ -85,17 +134,41 @@ void Canvas::paintEvent(QPaintEvent*) {
     painter.setPen(QPen(Qt::black));
     painter.drawRect(0, 0, canvasSize.width(), canvasSize.height());
 
+    if (loader != 0) {
+        // Препятствия загружаемой карты рисуются по мере разбора, до готовности сетки
+        if (!loadLayer.isNull()) painter.drawImage(QPoint(0, 0), loadLayer);
+        painter.setPen(QPen(QColor(0, 0, 0, 150), Field::polyWidth));
+        painter.setFont(QFont("Consolas", 10));
+        painter.drawText(QPoint(4, canvasSize.height() - 18), QString("Загрузка карты"));
+        painter.drawText(QPoint(4, canvasSize.height() - 6), installing ? QString("Построение сетки") : QString("[Esc] Отменить загрузку"));
+        painter.end();
+        return;
+    }
+
     // Drawing map
     field->draw(&painter);
 
+    if (!previewCells.isEmpty()) {
+        painter.setPen(QPen(Field::previewPath, Field::pathWidth));
+        QPolygon line;
+        for (const QPoint& cell : previewCells) line << cell * field->cellSize;
+        painter.drawPolyline(line);
+    }
+
     if (action == POLYGON_EDIT) {
         QPen p(Field::outlineDraw, Field::polyWidth);
         painter.setBrush(QColor(0, 0, 0, 0));
-        for (Obstacle& o : field->getObstacles()) {
-            for (QPoint& point : o.poly) {
-                p.setColor(&point == drag ? Field::lastPointDraw : Field::pointDraw);
+        // Маркеры вне перерисовываемой области не рисуются
+        QRect area = event->rect().adjusted(-damageMargin, -damageMargin, damageMargin, damageMargin);
+        const QVector<Obstacle>& obstacles = field->getObstacles();
+        for (int i = 0; i < obstacles.size(); i++) {
+            const QPolygon& poly = obstacles[i].poly;
+            if (!area.intersects(poly.boundingRect())) continue;
+            for (int k = 0; k < poly.size(); k++) {
+                if (!area.contains(poly[k])) continue;
+                p.setColor(i == attach && k == drag ? Field::lastPointDraw : Field::pointDraw);
                 painter.setPen(p);
-                painter.drawEllipse(point, 6, 6);
+                painter.drawEllipse(poly[k], 6, 6);
             }
         }
     }
@@ -119,7 +192,14 @@ void Canvas::paintEvent(QPaintEvent*) {
     painter.setFont(QFont("Consolas", 10));
 
     if (wayLength == 0) painter.drawText(QPoint(4, 14), QString("Длина пути: путь не найден"));
+    else if (wayLength > 0 && field->getPathBound() > 1.) painter.drawText(QPoint(4, 14), QString("Длина пути: %1 (не длиннее кратчайшего в %2 раза)").arg(wayLength).arg(field->getPathBound(), 0, 'f', 2));
+    else if (wayLength > 0 && !field->isPathOptimal()) painter.drawText(QPoint(4, 14), QString("Длина пути: %1 (не кратчайший, превышен бюджет памяти)").arg(wayLength));
     else if (wayLength > 0) painter.drawText(QPoint(4, 14), QString("Длина пути: %1").arg(wayLength));
+    if (wayLength > 0 && !field->getAlternativeLengths().isEmpty()) {
+        QStringList lengths;
+        for (double length : field->getAlternativeLengths()) lengths.append(QString::number(length));
+        painter.drawText(QPoint(4, 28), QString("Альтернативы: %1").arg(lengths.join(", ")));
+    }
 
     switch (action) {
         case WALKNESS:
@@ -146,6 +226,10 @@ void Canvas::paintEvent(QPaintEvent*) {
             painter.drawText(QPoint(4, canvasSize.height() - 18), QString("Установка финиша"));
             painter.drawText(QPoint(4, canvasSize.height() - 6), QString("[ЛКМ] Установить финиш, [ПКМ] Завершить, [Shift+ПКМ] Убрать"));
             break;
+        case STOPS:
+            painter.drawText(QPoint(4, canvasSize.height() - 18), QString("Установка остановок маршрута"));
+            painter.drawText(QPoint(4, canvasSize.height() - 6), QString("[ЛКМ] Добавить остановку, [Shift+ЛКМ] Убрать остановку, [ПКМ] Завершить, [Shift+ПКМ] Убрать все"));
+            break;
     }
 
     painter.end();
@@ -179,13 +263,13 @@ bool Canvas::event(QEvent* e) {
 //! \param event Событие
 //!
 void Canvas::mousePressEvent(QMouseEvent* event) {
+    if (loader != 0) return;
     QPoint pos = event->pos();
     switch (action) {
         case POLYGON_EDIT: {
             if (event->button() == Qt::LeftButton) {
                 if (!QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier)) startDrag(pos);
             }
-            update();
             break;
         }
         default:
@@ -198,13 +282,15 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
 //! \param event Событие
 //!
 void Canvas::mouseMoveEvent(QMouseEvent* event) {
+    if (loader != 0) return;
     QPoint pos = event->pos();
     switch (action) {
         case POLYGON_EDIT: {
+            QRect before = vertexDamage(attach, drag);
             if (moveDrag(pos)) {
                 changes = true;
                 emit statusUpdated(QString("Изменение препятствия: точка перемещена в [%1, %2]").arg(pos.x()).arg(pos.y()));
-                update();
+                damage(before.united(vertexDamage(attach, drag)));
             }
             break;
         }
@@ -218,6 +304,7 @@ void Canvas::mouseMoveEvent(QMouseEvent* event) {
 //! \param event Событие
 //!
 void Canvas::mouseReleaseEvent(QMouseEvent* event) {
+    if (loader != 0) return;
     QPoint pos = event->pos();
     switch (action) {
         case WALKNESS: {
@@ -228,6 +315,7 @@ void Canvas::mouseReleaseEvent(QMouseEvent* event) {
             break;
         }
         case START: {
+            QRect before = markerDamage(field->getStart());
             if (event->button() == Qt::LeftButton) {
                 field->setStart(pos);
                 emit statusUpdated(QString("Старт: установлен в [%1, %2]").arg(pos.x()).arg(pos.y()));
@@ -240,10 +328,11 @@ void Canvas::mouseReleaseEvent(QMouseEvent* event) {
                     emit statusUpdated(QString("Старт: убрано"));
                 }
             }
-            update();
+            damage(before.united(markerDamage(field->getStart())));
             break;
         }
         case END: {
+            QRect before = markerDamage(field->getEnd());
             if (event->button() == Qt::LeftButton) {
                 field->setEnd(pos);
                 emit statusUpdated(QString("Финиш: установлен в [%1, %2]").arg(pos.x()).arg(pos.y()));
@@ -256,10 +345,33 @@ void Canvas::mouseReleaseEvent(QMouseEvent* event) {
                     emit statusUpdated(QString("Финиш: убрано"));
                 }
             }
-            update();
+            damage(before.united(markerDamage(field->getEnd())));
+            break;
+        }
+        case STOPS: {
+            if (event->button() == Qt::LeftButton) {
+                if (!QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier)) {
+                    field->addStop(pos);
+                    emit statusUpdated(QString("Остановки: добавлена в [%1, %2]").arg(pos.x()).arg(pos.y()));
+                } else if (field->removeStop(pos)) {
+                    emit statusUpdated(QString("Остановки: убрана рядом с [%1, %2]").arg(pos.x()).arg(pos.y()));
+                }
+                int grab = qCeil(Field::stopGrabRadius);
+                damage(markerDamage(pos).adjusted(-grab, -grab, grab, grab));
+            } else {
+                if (!QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier)) {
+                    setAction(WALKNESS);
+                    emit statusUpdated(QString("Остановки: установка завершена"));
+                } else {
+                    field->clearStops();
+                    update();
+                    emit statusUpdated(QString("Остановки: убраны все"));
+                }
+            }
             break;
         }
         case POLYGON_CREATE: {
+            QRect before = drawDamage();
             if (event->button() == Qt::LeftButton) {
                 if (!QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier)) {
                     if (doDraw(pos)) {
@@ -271,6 +383,7 @@ void Canvas::mouseReleaseEvent(QMouseEvent* event) {
                     undoDraw();
                     emit statusUpdated(QString("Создание препятствия: %1 точек").arg(draw->count()));
                 }
+                damage(before.united(drawDamage()));
             } else if (event->button() == Qt::RightButton) {
                 if (!QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier)) {
                     bool ok;
@@ -280,20 +393,25 @@ void Canvas::mouseReleaseEvent(QMouseEvent* event) {
                         wayLength = field->findPath();
                         setAction(WALKNESS);
                         emit objectsUpdated(field->polyCount());
-                        emit statusUpdated(QString("Создание препятствия: завершено"));
+                        emit statusUpdated(QString("Создание препятствия: завершено") + crossingStatus());
                     }
                 } else {
                     setAction(WALKNESS);
                     emit statusUpdated(QString("Создание препятствия: действие отменено"));
                 }
             }
-            update();
             break;
         }
         case POLYGON_DELETE: {
             if (event->button() == Qt::LeftButton) {
+                Obstacle* obst = field->getObstacle(pos);
+                QRect before = obst == 0 ? QRect() : obstacleDamage(obst - field->getObstacles().constData());
+                // Пересечения хранят индексы препятствий, после удаления они сдвигаются
+                bool shifted = !field->getCrossings().isEmpty();
                 if (field->removeObstacle(pos)) {
                     changes = true;
+                    if (shifted) update();
+                    else damage(before);
                     emit objectsUpdated(field->polyCount());
                     emit statusUpdated(QString("Удаление препятствия: удалено"));
                 } else emit statusUpdated(QString("Удаление препятствия: препятствие не найдено"));
@@ -301,32 +419,45 @@ void Canvas::mouseReleaseEvent(QMouseEvent* event) {
                 setAction(WALKNESS);
                 emit statusUpdated(QString("Удаление препятствия: завершено"));
             }
-            update();
             break;
         }
         case POLYGON_EDIT: {
             if (event->button() == Qt::LeftButton) {
+                QRect handle = vertexDamage(attach, drag);
                 endDrag();
+                damage(handle);
                 if (QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier)) {
-                    changes = true;
-                    field->addToObstacle(pos);
+                    Obstacle* obst = field->getObstacle(pos);
+                    if (obst != 0) {
+                        int idx = obst - field->getObstacles().constData();
+                        QRect before = obstacleDamage(idx);
+                        changes = true;
+                        field->addToObstacle(*obst, pos);
+                        damage(before.united(obstacleDamage(idx)));
+                    }
                 }
             } else {
                 if (!QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier)) {
                     endDrag();
-                    field->regenMesh();
-                    wayLength = field->findPath();
+                    changes = true;
                     setAction(WALKNESS);
-                    emit statusUpdated(QString("Изменение препятствия: завершено"));
+                    wayLength = field->findPath();
+                    emit statusUpdated(QString("Изменение препятствия: завершено") + crossingStatus());
                 } else {
+                    Obstacle* obst = field->getObstacle(pos);
+                    int idx = obst == 0 ? -1 : obst - field->getObstacles().constData();
+                    QRect before = obstacleDamage(idx);
+                    unsigned count = field->polyCount();
                     if (field->removeFromObstacle(pos)) {
                         changes = true;
+                        if (field->polyCount() != count && !field->getCrossings().isEmpty()) update();
+                        else if (field->polyCount() != count) damage(before);
+                        else damage(before.united(obstacleDamage(idx)));
                         emit objectsUpdated(field->polyCount());
                         emit statusUpdated(QString("Изменение препятствия: точка удалена"));
                     } else emit statusUpdated(QString("Изменение препятствия: точка не найдена"));
                 }
             }
-            update();
             break;
         }
         default:
@@ -336,11 +467,104 @@ void Canvas::mouseReleaseEvent(QMouseEvent* event) {
 
 //!
 //! Загрузить карту в поле из XML-файла
+//! Карта загружается в фоне (`MapLoader`): холст показывает препятствия по мере разбора, строка состояния --
+//! стадию загрузки. Поле не меняется, пока загрузка не дойдёт до построения сетки, поэтому до этого
+//! её можно отменить (`Canvas::cancelLoad`) или начать загрузку другой карты
 //!
 //! \param path Путь до файла
 //!
 void Canvas::loadMap(const QString& path) {
-    int code = field->loadMap(path);
+    if (installing) {
+        emit statusUpdated(QString("Загрузка карты: дождитесь окончания построения сетки"));
+        return;
+    }
+    if (loader != 0) {
+        loader->cancel();
+        loadWatcher.waitForFinished();
+        endLoad();
+    }
+    endPreview();
+    loader = new MapLoader();
+    loadPath = path;
+    loadWatcher.setFuture(loader->start(path, field->cellSize));
+    loadTimer.start();
+    emit statusUpdated(QString("Загрузка карты: чтение XML-файла"));
+    update();
+}
+
+//!
+//! Идёт загрузка карты
+//!
+bool Canvas::isLoading() const {
+    return loader != 0;
+}
+
+//!
+//! Отменить загрузку карты
+//! Построение сетки уже не отменяется: поле к этому моменту занято новой картой
+//!
+void Canvas::cancelLoad() {
+    if (loader == 0 || installing) return;
+    loader->cancel();
+}
+
+//!
+//! Показать прогресс загрузки
+//! Новые препятствия дорисовываются в слой загрузки, перерисовывается только их область
+//!
+void Canvas::pollLoad() {
+    if (loader == 0 || installing) return;
+    MapLoader::Progress progress = loader->progress();
+    if (loadLayer.isNull() && !progress.size.isEmpty()) {
+        qreal ratio = devicePixelRatioF();
+        loadLayer = QImage(QSize(qCeil(progress.size.width() * ratio), qCeil(progress.size.height() * ratio)), QImage::Format_ARGB32_Premultiplied);
+        loadLayer.setDevicePixelRatio(ratio);
+        loadLayer.fill(Qt::transparent);
+        setMinimumSize(progress.size);
+        emit sizeChanged(progress.size);
+        update();
+    }
+
+    int from = loadObstacles.size();
+    if (!loadLayer.isNull() && loader->take(loadObstacles) > 0) {
+        QPainter painter(&loadLayer);
+        painter.setRenderHint(QPainter::Antialiasing);
+        QRect area;
+        for (int k = from; k < loadObstacles.size(); k++) {
+            Field::drawObstacle(&painter, loadObstacles[k]);
+            area |= loadObstacles[k].poly.boundingRect();
+        }
+        damage(area.adjusted(-damageMargin, -damageMargin, damageMargin, damageMargin));
+    }
+
+    switch (progress.stage) {
+    case MapLoader::PARSING:
+        emit statusUpdated(QString("Загрузка карты: разбор XML-файла %1%, препятствий: %2").arg(progress.percent).arg(progress.obstacles));
+        break;
+    case MapLoader::INDEXING:
+        emit statusUpdated(QString("Загрузка карты: проверка пересечений препятствий %1%").arg(progress.percent));
+        break;
+    case MapLoader::RASTERIZING:
+        emit statusUpdated(QString("Загрузка карты: непроходимость узлов сетки %1%").arg(progress.percent));
+        break;
+    default:
+        break;
+    }
+}
+
+//!
+//! Стадии загрузки закончились
+//! Если карта прочитана, она ставится в поле в фоновом потоке (`Field::installMap`)
+//!
+void Canvas::loadFinished() {
+    if (loader == 0 || installing || !loadWatcher.isFinished()) return;
+    int code = loadWatcher.result();
+    if (code < 0) {
+        endLoad();
+        setMinimumSize(field->size());
+        emit sizeChanged(field->size());
+        update();
+    }
     switch (code) {
     case -1:
         emit statusUpdated(QString("Загрузка карты: XML-файл не найден"));
@@ -351,23 +575,73 @@ void Canvas::loadMap(const QString& path) {
     case -3:
         emit statusUpdated(QString("Загрузка карты: XML-файл хранит недопустимые значения"));
         break;
+    case -4:
+        emit statusUpdated(QString("Загрузка карты: отменена"));
+        break;
     default:
-        setMinimumSize(field->size());
-        wayLength = field->lengthPath();
-        emit sizeChanged(field->size());
-        emit statusUpdated(QString("Загрузка карты: XML-файл успешно загружен"));
-        emit objectsUpdated(field->polyCount());
+        pollLoad();
+        installing = true;
+        loadTimer.stop();
+        emit statusUpdated(QString("Загрузка карты: построение сетки"));
         update();
+        installWatcher.setFuture(QtConcurrent::run([this]() { field->installMap(loadPath, loader->document()); }));
         break;
     }
 }
 
+//!
+//! Карта поставлена в поле
+//!
+void Canvas::installFinished() {
+    if (!installing || !installWatcher.isFinished()) return;
+    endLoad();
+    setMinimumSize(field->size());
+    wayLength = field->lengthPath();
+    emit sizeChanged(field->size());
+    emit statusUpdated(QString("Загрузка карты: XML-файл успешно загружен") + crossingStatus());
+    emit objectsUpdated(field->polyCount());
+    update();
+}
+
+//!
+//! Освободить загрузчик и слой загрузки
+//!
+void Canvas::endLoad() {
+    loadTimer.stop();
+    installing = false;
+    delete loader;
+    loader = 0;
+    loadObstacles.clear();
+    loadLayer = QImage();
+}
+
+//!
+//! Описание пересечений препятствий для строки состояния
+//!
+//! \return Пустая строка если пересечений нет
+//!
+QString Canvas::crossingStatus() {
+    const QVector<EdgeCrossing>& crossings = field->getCrossings();
+    if (crossings.isEmpty()) return QString();
+    int self = 0;
+    for (const EdgeCrossing& c : crossings) {
+        if (c.self()) self++;
+    }
+    const EdgeCrossing& first = crossings.first();
+    return QString(", найдено пересечений рёбер: %1 (самопересечений: %2), первое в [%3, %4]")
+        .arg(crossings.size()).arg(self).arg(qRound(first.point.x())).arg(qRound(first.point.y()));
+}
+
 //!
 //! Сохранить карту поля в XML-файл
 //!
 //! \param path Путь до файла
 //!
 void Canvas::saveMap(const QString& path) {
+    if (loader != 0) {
+        emit statusUpdated(QString("Сохранение карты: дождитесь окончания загрузки"));
+        return;
+    }
     int code = field->saveMap(path);
     switch (code) {
     case -1:
@@ -385,12 +659,103 @@ void Canvas::saveMap(const QString& path) {
 //! \param size Размеры карты
 //!
 void Canvas::resizeMap(QSize size) {
+    if (loader != 0) {
+        emit statusUpdated(QString("Изменение размеров: дождитесь окончания загрузки карты"));
+        return;
+    }
+    endPreview();
+    preview.invalidate();
+    if (field != 0) delete field;
     field = new Field(size.width(), size.height());
+    if (trace.isOpen()) field->setTrace(&trace);
     setMinimumSize(size);
     update();
     emit sizeChanged(size);
 }
 
+// Repaint -- Перерисовка
+
+//!
+//! Отметить область холста для перерисовки
+//! Области копятся и перерисовываются вместе не чаще раза в `Canvas::repaintInterval` мс,
+//! поэтому частые события (перетаскивание) не перерисовывают холст на каждое событие.
+//! Если с прошлой перерисовки прошло больше интервала, область перерисовывается сразу
+//!
+//! \param rect Область
+//!
+void Canvas::damage(const QRect& rect) {
+    if (rect.isEmpty()) return;
+    dirty |= rect;
+    if (repaintTimer.isActive()) return;
+    qint64 elapsed = lastRepaint.elapsed();
+    if (elapsed >= repaintInterval) flushDamage();
+    else repaintTimer.start(repaintInterval - elapsed);
+}
+
+//!
+//! Перерисовать накопленную область
+//!
+void Canvas::flushDamage() {
+    repaintTimer.stop();
+    if (!dirty.isEmpty()) update(dirty);
+    dirty = QRegion();
+    lastRepaint.restart();
+}
+
+//!
+//! Область препятствия вместе с подписью и маркерами вершин
+//!
+//! \param idx Индекс препятствия
+//! \return Пустая область, если препятствия нет
+//!
+QRect Canvas::obstacleDamage(int idx) {
+    const QVector<Obstacle>& obstacles = field->getObstacles();
+    if (idx < 0 || idx >= obstacles.size()) return QRect();
+    const QPolygon& poly = obstacles[idx].poly;
+    QPoint center = polygonCentroid(poly);
+    QRect rect = poly.boundingRect().united(QRect(center - QPoint(30, 30), QSize(60, 60)));
+    return rect.adjusted(-damageMargin, -damageMargin, damageMargin, damageMargin);
+}
+
+//!
+//! Область, которая меняется при перемещении вершины: соседние с ней рёбра
+//! (и закрашенный между ними треугольник) и подпись препятствия
+//!
+//! \param obstacle Индекс препятствия
+//! \param vertex Индекс вершины
+//! \return Пустая область, если вершины нет
+//!
+QRect Canvas::vertexDamage(int obstacle, int vertex) {
+    const QVector<Obstacle>& obstacles = field->getObstacles();
+    if (obstacle < 0 || obstacle >= obstacles.size()) return QRect();
+    const QPolygon& poly = obstacles[obstacle].poly;
+    if (vertex < 0 || vertex >= poly.size()) return QRect();
+    QPolygon edges;
+    edges << poly[(vertex + poly.size() - 1) % poly.size()] << poly[vertex] << poly[(vertex + 1) % poly.size()];
+    QPoint center = polygonCentroid(poly);
+    QRect rect = edges.boundingRect().united(QRect(center - QPoint(30, 30), QSize(60, 60)));
+    return rect.adjusted(-damageMargin, -damageMargin, damageMargin, damageMargin);
+}
+
+//!
+//! Область рисуемого препятствия
+//!
+QRect Canvas::drawDamage() {
+    if (draw == 0 || draw->isEmpty()) return QRect();
+    return draw->boundingRect().adjusted(-damageMargin, -damageMargin, damageMargin, damageMargin);
+}
+
+//!
+//! Область маркера старта или финиша
+//!
+//! \param point Точка
+//! \return Пустая область, если точка не задана
+//!
+QRect Canvas::markerDamage(const Waypoint& point) {
+    if (!point.has_value()) return QRect();
+    return QRect(*point - QPoint(damageMargin, damageMargin), QSize(2 * damageMargin + 1, 2 * damageMargin + 1));
+}
+
 // Polygon Editing -- Редактирование полигонов
 
 //!
@@ -402,16 +767,21 @@ void Canvas::resizeMap(QSize size) {
 void Canvas::startDrag(QPoint point) {
     endDrag();
     double closest = Field::pointGrabRadius;
-    for (Obstacle& obst : field->getObstacles()) {
-        for (QPoint& vertex : obst.poly) {
-            double dst = euclideanDistance(point, vertex);
+    const QVector<Obstacle>& obstacles = field->getObstacles();
+    for (int i = 0; i < obstacles.size(); i++) {
+        const QPolygon& poly = obstacles[i].poly;
+        for (int k = 0; k < poly.size(); k++) {
+            double dst = euclideanDistance(point, poly[k]);
             if (dst < closest && dst <= Field::pointGrabRadius) {
-                attach = &obst.poly;
-                drag = &vertex;
+                attach = i;
+                drag = k;
                 closest = dst;
             }
         }
     }
+    field->setLiveObstacle(attach);
+    damage(vertexDamage(attach, drag));
+    if (attach != -1) startPreview();
 }
 
 //!
@@ -422,28 +792,116 @@ void Canvas::startDrag(QPoint point) {
 //! \return Успех или нет
 //!
 bool Canvas::moveDrag(QPoint point) {
-    if (attach == 0 || !field->inMap(point)) return false;
-    QPolygon it = *attach;
-    QPoint old = *drag;
+    if (attach == -1 || !field->inMap(point)) return false;
+    const QPolygon& poly = field->getObstacles()[attach].poly;
+    QPolygon edges;
+    edges << poly[(drag + poly.size() - 1) % poly.size()] << poly[drag] << poly[(drag + 1) % poly.size()] << point;
+    QRect area = edges.boundingRect();
+    if (field->moveVertex(attach, drag, point)) patchPreview(area);
+    return true;
+}
 
-    *drag = point;
+//!
+//! Снять захват точки
+//!
+void Canvas::endDrag() {
+    attach = -1;
+    drag = -1;
+    field->setLiveObstacle(-1);
+    endPreview();
+}
 
-    for (Obstacle& obst : field->getObstacles()) {
-            if (obst.poly != it && obst.poly.intersects(it)) {
-                *drag = old;
-                break;
-            }
+// Path Preview -- Предпросмотр пути
+
+//!
+//! Начать предпросмотр пути на время перетаскивания вершины
+//! Поиск продолжается с прошлого перетаскивания, если с тех пор препятствия, старт и финиш не менялись,
+//! иначе непроходимость сетки считается заново по текущим препятствиям.
+//! Предпросмотр ищет путь точечного агента, поэтому при ненулевом `Field::agentRadius` он не показывается:
+//! иначе он рисовал бы пути через проходы, в которые агент не помещается
+//!
+void Canvas::startPreview() {
+    Waypoint start = field->getStart();
+    Waypoint end = field->getEnd();
+    if (field->adaptiveMesh || field->agentRadius > 0. || !start.has_value() || !end.has_value()) return;
+    MeshPoint* mstart = field->nearestMesh(*start);
+    MeshPoint* mend = field->nearestMesh(*end);
+    if (mstart == 0 || mend == 0) return;
+
+    QSize dims = field->meshSize();
+    unsigned revision = field->getObstacleRevision();
+    if (preview.matches(dims, mstart->meshCoord, mend->meshCoord, revision)) {
+        previewSequence = preview.result(previewCells);
+        damage(previewDamage());
+    } else {
+        preview.reset(field->rasterize(QRect(QPoint(0, 0), dims)), dims, mstart->meshCoord, mend->meshCoord, revision);
+        previewSequence = preview.result(previewCells);
+        previewCells.clear();
     }
+    previewActive = true;
+    runPreview();
+}
 
-    return true;
+//!
+//! Передать в предпросмотр изменение непроходимости узлов сетки в области карты
+//!
+//! \param area Область карты
+//!
+void Canvas::patchPreview(const QRect& area) {
+    if (!previewActive) return;
+    int size = field->cellSize;
+    QRect cells(QPoint((area.left() + size - 1) / size, (area.top() + size - 1) / size), QPoint(area.right() / size, area.bottom() / size));
+    cells = cells.intersected(QRect(QPoint(0, 0), field->meshSize()));
+    if (cells.isEmpty()) return;
+    preview.patch(cells, field->rasterize(cells));
+    runPreview();
 }
 
 //!
-//! Снять захват точки
+//! Запустить порцию поиска предпросмотра в фоновом потоке, если она ещё не идёт
 //!
-void Canvas::endDrag() {
-    attach = 0;
-    drag = 0;
+void Canvas::runPreview() {
+    if (!previewActive || previewWatcher.isRunning()) return;
+    previewWatcher.setFuture(QtConcurrent::run([this]() { return preview.step(previewBudget); }));
+}
+
+//!
+//! Порция поиска предпросмотра закончилась
+//! Новый путь перерисовывается, а если поиск не сошёлся или пришли новые изменения, запускается следующая порция
+//!
+void Canvas::previewFinished() {
+    bool done = previewWatcher.result();
+    if (!previewActive) return;
+    QVector<QPoint> cells;
+    quint64 sequence = preview.result(cells);
+    if (sequence != previewSequence) {
+        QRect before = previewDamage();
+        previewSequence = sequence;
+        previewCells = cells;
+        damage(before.united(previewDamage()));
+    }
+    if (!done) runPreview();
+}
+
+//!
+//! Закончить предпросмотр пути
+//! Состояние поиска сохраняется для следующего перетаскивания
+//!
+void Canvas::endPreview() {
+    if (!previewActive) return;
+    damage(previewDamage());
+    previewActive = false;
+    previewCells.clear();
+}
+
+//!
+//! Область пути предпросмотра
+//!
+QRect Canvas::previewDamage() {
+    if (previewCells.isEmpty()) return QRect();
+    QPolygon line;
+    for (const QPoint& cell : previewCells) line << cell * field->cellSize;
+    return line.boundingRect().adjusted(-damageMargin, -damageMargin, damageMargin, damageMargin);
 }
 
 // Polygon Drawing -- Функции рисования полигонов
@@ -467,9 +925,7 @@ bool Canvas::doDraw(QPoint point) {
     if (field->getFactorMap(point) != 0.) return false;
     QPolygon poly(*draw);
     poly << point;
-    for (Obstacle& o : field->getObstacles()) {
-            if (o.poly.intersects(poly)) return false;
-    }
+    if (field->intersectsObstacles(poly)) return false;
     (*draw) << point;
     return true;
 }
@@ -494,7 +950,8 @@ void Canvas::undoDraw() {
 void Canvas::confirmDraw(double w) {
     if (draw == 0) return;
     if (draw->length() > 2) {
-        field->getObstacles().append(Obstacle(*draw, w));
+        field->addObstacle(Obstacle(*draw, w));
+        field->validateObstacles();
         field->regenMesh();
     }
 }
@@ -8,7 +8,12 @@
 #include <QHoverEvent>
 #include <QLabel>
 #include <QInputDialog>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QRegion>
+#include <QFutureWatcher>
 #include "field.h"
+#include "liveplanner.h"
 #include "mainwindow.h"
 
 enum CanvasAction {
@@ -17,7 +22,8 @@ enum CanvasAction {
     END = 2,
     POLYGON_CREATE = 3,
     POLYGON_DELETE = 4,
-    POLYGON_EDIT = 5
+    POLYGON_EDIT = 5,
+    STOPS = 6
 };
 
 class Canvas : public QWidget
@@ -25,10 +31,17 @@ class Canvas : public QWidget
     Q_OBJECT
 
 public:
+    static constexpr int repaintInterval = 8;
+    static constexpr int damageMargin = 8;
+    static constexpr int previewBudget = 12;
+    static constexpr int loadPollInterval = 50;
+
     Canvas(QWidget* parent = 0);
     ~Canvas();
 
     void loadMap(const QString& path);
+    bool isLoading() const;
+    void cancelLoad();
     void saveMap(const QString& path);
     void resizeMap(QSize size);
 
@@ -36,6 +49,10 @@ public:
 
     Field* getField();
 
+    bool startTrace(const QString& path);
+    void stopTrace();
+    bool isTracing() const;
+
 signals:
     void coordMoved(QPoint p);
     void statusUpdated(QString s);
@@ -48,13 +65,34 @@ protected:
     double wayLength = -1;
     bool changes = false;
 
+    TraceRecorder trace;
+
     QPolygon* draw = 0;
-    QPolygon* attach = 0;
-    QPoint* drag = 0;
+    int attach = -1;
+    int drag = -1;
+
+    QRegion dirty;
+    QTimer repaintTimer;
+    QElapsedTimer lastRepaint;
+
+    LivePlanner preview;
+    QFutureWatcher<bool> previewWatcher;
+    QVector<QPoint> previewCells;
+    quint64 previewSequence = 0;
+    bool previewActive = false;
+
+    MapLoader* loader = 0;
+    QString loadPath;
+    QFutureWatcher<int> loadWatcher;
+    QFutureWatcher<void> installWatcher;
+    QTimer loadTimer;
+    QVector<Obstacle> loadObstacles;
+    QImage loadLayer;
+    bool installing = false;
 
     bool event(QEvent* e);
     void showEvent(QShowEvent* event);
-    void paintEvent(QPaintEvent*);
+    void paintEvent(QPaintEvent* event);
     void mouseReleaseEvent(QMouseEvent* e);
     void mousePressEvent(QMouseEvent* e);
     void mouseMoveEvent(QMouseEvent* e);
@@ -63,12 +101,33 @@ protected:
     bool moveDrag(QPoint point);
     void endDrag();
 
+    void startPreview();
+    void patchPreview(const QRect& area);
+    void runPreview();
+    void previewFinished();
+    void endPreview();
+    QRect previewDamage();
+
     void startDraw();
     bool doDraw(QPoint point);
     void undoDraw();
     void confirmDraw(double w);
     void endDraw();
 
+    void pollLoad();
+    void loadFinished();
+    void installFinished();
+    void endLoad();
+
+    QString crossingStatus();
+
+    void damage(const QRect& rect);
+    void flushDamage();
+    QRect obstacleDamage(int idx);
+    QRect vertexDamage(int obstacle, int vertex);
+    QRect drawDamage();
+    QRect markerDamage(const Waypoint& point);
+
 private:
     Ui::MainWindow* ui;
 };
@@ -0,0 +1,119 @@
+//!
+//! Раскладка клеток сетки в памяти.
+//! Поиск на сетке чаще всего обращается к четырём соседям клетки. В построчной раскладке
+//! (`i * rows + j`) соседи по x лежат на целый столбец дальше и почти всегда в другой строке кэша.
+//! Раскладка TILED хранит клетки плитками 8 x 8 (плитка непроходимости -- 512 байт), внутри плитки --
+//! по Z-кривой, поэтому соседи, кроме стоящих на краю плитки, лежат рядом. Номер клетки считает
+//! `CellGrid::index`; таблицы поиска (стоимости, предки, закрытые клетки) индексируются тем же номером,
+//! поэтому алгоритмам поиска раскладка не видна. По умолчанию раскладка построчная (`Field::cellLayout`):
+//! на замерах плитки выигрывают у неё не больше 10%, а с ориентирами на сетке 2000 x 2000 проигрывают (см. README)
+//!
+
+#include <limits>
+#include "cellgrid.h"
+
+static const double infinity = std::numeric_limits<double>::infinity();
+
+//!
+//! Заполнить сетку непроходимостью узлов
+//!
+//! \param factors Непроходимость узлов (индекс `i * rows + j`, как `Field::rasterize`)
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//! \param layout Раскладка клеток в памяти
+//!
+void CellGrid::assign(const QVector<double>& factors, int cols, int rows, Layout layout) {
+    kind = layout;
+    width = cols;
+    height = rows;
+    tilesAcross = (cols + tileMask) >> tileShift;
+    tilesDown = (rows + tileMask) >> tileShift;
+    if (layout == LINEAR) {
+        this->factors = factors;
+        return;
+    }
+    this->factors.fill(1., tilesAcross * tilesDown * tileCells);
+    double* data = this->factors.data();
+    const double* source = factors.constData();
+    for (int i = 0; i < cols; i++) {
+        for (int j = 0; j < rows; j++) data[index(i, j)] = source[i * rows + j];
+    }
+}
+
+void CellGrid::clear() {
+    width = height = 0;
+    tilesAcross = tilesDown = 0;
+    factors.clear();
+}
+
+CellGrid::Layout CellGrid::layout() const {
+    return kind;
+}
+
+int CellGrid::cols() const {
+    return width;
+}
+
+int CellGrid::rows() const {
+    return height;
+}
+
+//!
+//! Размер таблиц, индексируемых номером клетки (в раскладке TILED -- с клетками неполных плиток)
+//!
+int CellGrid::capacity() const {
+    return factors.size();
+}
+
+//!
+//! Таблицы поиска текущего потока
+//! Поиски идут из нескольких потоков одновременно (см. `MapSnapshot::findPath`), поэтому у каждого потока свои таблицы.
+//! Таблицы живут между поисками, поэтому поиск не выделяет память размером с сетку и не очищает её целиком.
+//! Цена -- `CellTables::footprint(capacity)` байт (13 байт на клетку, около 52 МБ для сетки 2000 x 2000)
+//! на каждый поток, который хоть раз искал путь с бюджетом памяти больше этого или без бюджета;
+//! память освобождается вместе с потоком (пул сервера путей завершает простаивающие потоки, см. `--idle`)
+//!
+CellTables& CellTables::local() {
+    static thread_local CellTables tables;
+    return tables;
+}
+
+//!
+//! Подготовить таблицы к новому поиску: сбросить клетки, затронутые прошлым поиском,
+//! или выделить таблицы заново, если изменился размер сетки
+//!
+//! \param capacity Размер таблиц (`CellGrid::capacity`)
+//!
+void CellTables::prepare(int capacity) {
+    // Новые векторы, а не fill: после перехода на меньшую сетку память под прежние таблицы не остаётся за потоком
+    if (costs.size() != capacity) {
+        costs = QVector<double>(capacity, infinity);
+        origins = QVector<int>(capacity, -1);
+        closed = QVector<bool>(capacity, false);
+        touched = QVector<int>();
+        return;
+    }
+    for (int cell : touched) {
+        costs[cell] = infinity;
+        origins[cell] = -1;
+        closed[cell] = false;
+    }
+    touched.clear();
+}
+
+//!
+//! Память под плотные таблицы поиска в байтах
+//!
+//! \param capacity Размер таблиц (`CellGrid::capacity`)
+//!
+qint64 CellTables::footprint(int capacity) {
+    return capacity * (qint64)(sizeof(double) + sizeof(int) + sizeof(bool));
+}
+
+//!
+//! Память, которую занимают таблицы текущего поиска, в байтах (для бюджета `Field::searchBudget`):
+//! плотные таблицы целиком и список затронутых клеток
+//!
+qint64 CellTables::footprint() const {
+    return footprint(costs.size()) + touched.size() * (qint64)sizeof(int);
+}
@@ -0,0 +1,84 @@
+#ifndef CELLGRID_H
+#define CELLGRID_H
+
+#include <QVector>
+#include <QPoint>
+
+class CellGrid {
+public:
+    enum Layout {
+        LINEAR = 0,
+        TILED = 1
+    };
+
+    static constexpr int tileShift = 3;
+    static constexpr int tileSide = 1 << tileShift;
+    static constexpr int tileMask = tileSide - 1;
+    static constexpr int tileCells = tileSide * tileSide;
+
+    void assign(const QVector<double>& factors, int cols, int rows, Layout layout);
+    void clear();
+
+    Layout layout() const;
+    int cols() const;
+    int rows() const;
+    int capacity() const;
+
+    //!
+    //! Номер клетки (i, j) в раскладке сетки; клетка должна быть внутри сетки
+    //! В раскладке TILED сетка разбита на плитки `tileSide` x `tileSide`, плитки идут по строкам,
+    //! клетки внутри плитки -- в порядке Z-кривой (биты i и j чередуются)
+    //!
+    inline int index(int i, int j) const {
+        if (kind == LINEAR) return i * height + j;
+        int tile = (j >> tileShift) * tilesAcross + (i >> tileShift);
+        return tile * tileCells + (spread[i & tileMask] | spread[j & tileMask] << 1);
+    }
+
+    inline int index(const QPoint& cell) const {
+        return index(cell.x(), cell.y());
+    }
+
+    inline bool contains(const QPoint& cell) const {
+        return cell.x() >= 0 && cell.y() >= 0 && cell.x() < width && cell.y() < height;
+    }
+
+    //!
+    //! Непроходимость клетки по номеру в раскладке (клетки плиток за краем сетки -- стены)
+    //!
+    inline double walkness(int index) const {
+        return factors[index];
+    }
+
+protected:
+    static constexpr int spread[tileSide] = { 0, 1, 4, 5, 16, 17, 20, 21 };
+
+    Layout kind = LINEAR;
+    int width = 0, height = 0;
+    int tilesAcross = 0, tilesDown = 0;
+    QVector<double> factors;
+};
+
+//!
+//! Таблицы поиска по сетке, индексируемые номером клетки в раскладке (`CellGrid::index`)
+//!
+struct CellTables {
+    QVector<double> costs;
+    QVector<int> origins;
+    QVector<bool> closed;
+    QVector<int> touched;
+
+    static CellTables& local();
+    static qint64 footprint(int capacity);
+    void prepare(int capacity);
+    qint64 footprint() const;
+
+    inline void reach(int cell, double cost, int origin) {
+        if (origins[cell] < 0) touched.append(cell);
+        costs[cell] = cost;
+        origins[cell] = origin;
+        closed[cell] = false;
+    }
+};
+
+#endif // CELLGRID_H
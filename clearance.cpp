@@ -0,0 +1,165 @@
+//!
+//! Карта свободного пространства (clearance).
+//! Для каждого узла сетки хранится евклидово расстояние (в клетках) до ближайшей стены
+//! (узла с непроходимостью 1) или до края карты, не больше `ClearanceMap::maxClearance`.
+//! Расстояния считаются разделимым преобразованием (Felzenszwalb-Huttenlocher): сначала
+//! расстояние вдоль оси x проходом по строкам целиком -- внутренний цикл идёт по смежной памяти
+//! столбца и векторизуется компилятором, затем точное квадратичное расстояние нижней огибающей
+//! парабол вдоль оси y, независимо для каждого столбца (столбцы обрабатываются параллельно).
+//! Расстояния ограничены сверху, поэтому изменение стен влияет только на узлы не дальше
+//! `maxClearance` от изменённых клеток -- при правке карты пересчитывается только это окно
+//!
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <QtConcurrent>
+#include <QDebug>
+#include <QElapsedTimer>
+#include "clearance.h"
+
+//!
+//! Обновить карту по непроходимости узлов сетки
+//! Если размеры сетки не изменились, пересчитывается только окно вокруг изменившихся стен
+//!
+//! \param factors Непроходимость узлов (индекс `i * rows + j`)
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//!
+void ClearanceMap::update(const QVector<double>& factors, int cols, int rows) {
+    QElapsedTimer timer;
+    timer.start();
+    QVector<quint8> next(cols * rows);
+    for (int k = 0; k < next.size(); k++) next[k] = factors[k] >= 1. ? 1 : 0;
+
+    QRect window;
+    if (cols != this->cols || rows != this->rows || distance.size() != cols * rows) {
+        this->cols = cols;
+        this->rows = rows;
+        distance.fill(0.f, cols * rows);
+        window = QRect(0, 0, cols, rows);
+    } else {
+        int left = cols, right = -1, top = rows, bottom = -1;
+        for (int i = 0; i < cols; i++) {
+            const quint8* a = walls.constData() + i * rows;
+            const quint8* b = next.constData() + i * rows;
+            if (memcmp(a, b, rows) == 0) continue;
+            left = qMin(left, i);
+            right = i;
+            for (int j = 0; j < rows; j++) {
+                if (a[j] == b[j]) continue;
+                top = qMin(top, j);
+                bottom = qMax(bottom, j);
+            }
+        }
+        if (right == -1) {
+            walls.swap(next);
+            return;
+        }
+        window = QRect(QPoint(left, top), QPoint(right, bottom))
+            .adjusted(-maxClearance, -maxClearance, maxClearance, maxClearance)
+            .intersected(QRect(0, 0, cols, rows));
+    }
+    walls.swap(next);
+    if (window.isEmpty()) return;
+    compute(window);
+    qInfo() << "ClearanceMap::update" << "Window" << window << "in" << timer.elapsed() << "ms";
+}
+
+void ClearanceMap::clear() {
+    cols = rows = 0;
+    walls.clear();
+    distance.clear();
+}
+
+//!
+//! Расстояния до стен всех узлов (индекс `i * rows + j`)
+//!
+const QVector<float>& ClearanceMap::distances() const {
+    return distance;
+}
+
+//!
+//! Расстояние до ближайшей стены в узле сетки (в клетках)
+//!
+float ClearanceMap::at(const QPoint& cell) const {
+    if (cell.x() < 0 || cell.y() < 0 || cell.x() >= cols || cell.y() >= rows) return 0.f;
+    return distance[cell.x() * rows + cell.y()];
+}
+
+//!
+//! Пересчитать расстояния в окне узлов
+//! Стены дальше `maxClearance` от окна на результат не влияют, поэтому расчёт идёт
+//! только в окне, расширенном на `maxClearance`
+//!
+//! \param window Окно узлов сетки
+//!
+void ClearanceMap::compute(const QRect& window) {
+    QRect context = window.adjusted(-maxClearance, -maxClearance, maxClearance, maxClearance).intersected(QRect(0, 0, cols, rows));
+    int width = context.width(), height = context.height();
+    const float cap = maxClearance + 1;
+
+    // Расстояние вдоль x: два прохода по столбцам, каждый -- по всей высоте окна сразу
+    QVector<float> along(width * height);
+    float* dx = along.data();
+    for (int i = 0; i < width; i++) {
+        const quint8* wall = walls.constData() + (context.left() + i) * rows + context.top();
+        float* column = dx + i * height;
+        const float* previous = i > 0 ? column - height : 0;
+        for (int j = 0; j < height; j++) {
+            float d = previous != 0 ? qMin(previous[j] + 1.f, cap) : cap;
+            column[j] = wall[j] ? 0.f : d;
+        }
+    }
+    for (int i = width - 2; i >= 0; i--) {
+        float* column = dx + i * height;
+        const float* following = column + height;
+        for (int j = 0; j < height; j++) column[j] = qMin(column[j], following[j] + 1.f);
+    }
+
+    // Точное расстояние вдоль y: нижняя огибающая парабол f(k) + (j - k)^2 в каждом столбце окна
+    int first = window.left() - context.left();
+    int count = window.width();
+    // Отсоединение от снимков карты до параллельной записи
+    float* result = distance.data();
+    QVector<int> bands;
+    for (int band = 0; band * columnsPerBand < count; band++) bands.append(band);
+    QtConcurrent::blockingMap(bands, [&](int band) {
+        QVector<float> f(height), z(height + 1);
+        QVector<int> v(height);
+        for (int c = band * columnsPerBand; c < qMin(count, (band + 1) * columnsPerBand); c++) {
+            int i = first + c;
+            const float* column = dx + i * height;
+            for (int j = 0; j < height; j++) f[j] = column[j] * column[j];
+
+            int k = 0;
+            v[0] = 0;
+            z[0] = -std::numeric_limits<float>::infinity();
+            z[1] = std::numeric_limits<float>::infinity();
+            for (int q = 1; q < height; q++) {
+                float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.f * (q - v[k]));
+                while (s <= z[k]) {
+                    k--;
+                    s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.f * (q - v[k]));
+                }
+                k++;
+                v[k] = q;
+                z[k] = s;
+                z[k + 1] = std::numeric_limits<float>::infinity();
+            }
+
+            int gi = context.left() + i;
+            float* out = result + gi * rows;
+            k = 0;
+            for (int q = 0; q < height; q++) {
+                while (z[k + 1] < q) k++;
+                int gj = context.top() + q;
+                if (gj < window.top() || gj > window.bottom()) continue;
+                float d = std::sqrt((float)((q - v[k]) * (q - v[k])) + f[v[k]]);
+                float border = qMin(qMin(gi + 1, cols - gi), qMin(gj + 1, rows - gj));
+                out[gj] = qMin(qMin(d, border), (float)maxClearance);
+            }
+        }
+    });
+}
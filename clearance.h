@@ -0,0 +1,38 @@
+#ifndef CLEARANCE_H
+#define CLEARANCE_H
+
+#include <QVector>
+#include <QPoint>
+#include <QRect>
+
+class ClearanceMap {
+public:
+    static constexpr int maxClearance = 64;
+    static constexpr int columnsPerBand = 32;
+
+    void update(const QVector<double>& factors, int cols, int rows);
+    void clear();
+
+    const QVector<float>& distances() const;
+    float at(const QPoint& cell) const;
+
+    //!
+    //! Агент радиуса radius (в клетках сетки) помещается в клетке: расстояние до ближайшей стены больше радиуса
+    //!
+    inline bool passable(int cell, float radius) const {
+        return radius <= 0.f || distance.isEmpty() || distance[cell] > radius;
+    }
+
+    inline bool passable(const QPoint& cell, float radius) const {
+        return passable(cell.x() * rows + cell.y(), radius);
+    }
+
+protected:
+    int cols = 0, rows = 0;
+    QVector<quint8> walls;
+    QVector<float> distance;
+
+    void compute(const QRect& window);
+};
+
+#endif // CLEARANCE_H
@@ -0,0 +1,179 @@
+//!
+//! Компоненты связности проходимых клеток сетки.
+//! Позволяет за O(1) ответить, что старт и финиш разделены стенами и путь не существует
+//!
+
+#include "connectivity.h"
+
+static const QPoint offsets[4] = { QPoint(0, 1), QPoint(0, -1), QPoint(-1, 0), QPoint(1, 0) };
+
+//!
+//! Полная разметка компонент заливкой
+//!
+//! \param mesh Сетка
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//!
+void Connectivity::build(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows) {
+    this->cols = cols;
+    this->rows = rows;
+    QVector<bool> blocked = blockedCells(mesh);
+
+    labels.fill(-1, cols * rows);
+    parent.clear();
+    for (int cell = 0; cell < labels.size(); cell++) {
+        if (blocked[cell] || labels[cell] != -1) continue;
+        int label = parent.size();
+        parent.append(label);
+        labels[cell] = label;
+        flood(cell, label, blocked);
+    }
+    flatten();
+}
+
+//!
+//! Обновить разметку после перегенерации сетки
+//! Переразмечаются только компоненты, затронутые изменившимися клетками:
+//! ставшие стенами клетки могут разделить компоненту -- её части заливаются заново,
+//! освободившиеся клетки объединяют соседние компоненты через систему непересекающихся множеств
+//!
+//! \param mesh Сетка
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//!
+void Connectivity::update(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows) {
+    if (cols != this->cols || rows != this->rows || labels.isEmpty() || parent.size() > labels.size()) {
+        build(mesh, cols, rows);
+        return;
+    }
+
+    QVector<bool> blocked = blockedCells(mesh);
+    QVector<int> opened, closed;
+    for (int cell = 0; cell < labels.size(); cell++) {
+        bool was = labels[cell] == -1;
+        if (was && !blocked[cell]) opened.append(cell);
+        if (!was && blocked[cell]) closed.append(cell);
+    }
+    if (opened.isEmpty() && closed.isEmpty()) return;
+
+    int firstNew = parent.size();
+    for (int cell : closed) labels[cell] = -1;
+    for (int cell : closed) {
+        QPoint c(cell / rows, cell % rows);
+        for (const QPoint& offset : offsets) {
+            QPoint n = c + offset;
+            if (!inGrid(n)) continue;
+            int ni = index(n);
+            if (labels[ni] == -1 || labels[ni] >= firstNew) continue;
+            int label = parent.size();
+            parent.append(label);
+            labels[ni] = label;
+            flood(ni, label, blocked);
+        }
+    }
+
+    for (int cell : opened) {
+        int label = parent.size();
+        parent.append(label);
+        labels[cell] = label;
+        QPoint c(cell / rows, cell % rows);
+        for (const QPoint& offset : offsets) {
+            QPoint n = c + offset;
+            if (!inGrid(n)) continue;
+            int ni = index(n);
+            if (labels[ni] != -1) unite(label, labels[ni]);
+        }
+    }
+    flatten();
+}
+
+//!
+//! Сбросить разметку
+//!
+void Connectivity::clear() {
+    cols = rows = 0;
+    labels.clear();
+    parent.clear();
+}
+
+//!
+//! Компонента клетки
+//!
+//! \param meshCoord Координаты на сетке
+//! \return Номер компоненты или -1 если клетка -- стена или вне сетки
+//!
+int Connectivity::component(const QPoint& meshCoord) const {
+    if (!inGrid(meshCoord)) return -1;
+    int label = labels[index(meshCoord)];
+    return label == -1 ? -1 : parent[label];
+}
+
+//!
+//! Проверка, лежат ли две клетки в одной компоненте связности
+//!
+//! \param a Координаты первой клетки на сетке
+//! \param b Координаты второй клетки на сетке
+//! \return Связаны клетки или нет
+//!
+bool Connectivity::connected(const QPoint& a, const QPoint& b) const {
+    int ca = component(a);
+    return ca != -1 && ca == component(b);
+}
+
+QVector<bool> Connectivity::blockedCells(const QHash<QPoint, MeshPoint>& mesh) const {
+    QVector<bool> blocked(cols * rows, true);
+    for (auto it = mesh.constBegin(); it != mesh.constEnd(); ++it) {
+        if (inGrid(it.key())) blocked[index(it.key())] = it.value().walkness >= 1.;
+    }
+    return blocked;
+}
+
+//!
+//! Заливка компоненты новой меткой
+//! Проходит по всем связанным проходимым клеткам, ещё не получившим метку `label`
+//!
+void Connectivity::flood(int cell, int label, const QVector<bool>& blocked) {
+    QVector<int> stack;
+    stack.append(cell);
+    while (!stack.isEmpty()) {
+        int current = stack.takeLast();
+        QPoint c(current / rows, current % rows);
+        for (const QPoint& offset : offsets) {
+            QPoint n = c + offset;
+            if (!inGrid(n)) continue;
+            int ni = index(n);
+            if (blocked[ni] || labels[ni] == label) continue;
+            labels[ni] = label;
+            stack.append(ni);
+        }
+    }
+}
+
+int Connectivity::find(int label) {
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+void Connectivity::unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a != b) parent[qMax(a, b)] = qMin(a, b);
+}
+
+//!
+//! Сжатие путей, после которого parent[label] -- сразу корень множества
+//!
+void Connectivity::flatten() {
+    for (int i = 0; i < parent.size(); i++) parent[i] = find(i);
+}
+
+bool Connectivity::inGrid(const QPoint& meshCoord) const {
+    return meshCoord.x() >= 0 && meshCoord.y() >= 0 && meshCoord.x() < cols && meshCoord.y() < rows;
+}
+
+int Connectivity::index(const QPoint& meshCoord) const {
+    return meshCoord.x() * rows + meshCoord.y();
+}
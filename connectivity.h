@@ -0,0 +1,33 @@
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <QVector>
+#include <QHash>
+#include <QPoint>
+#include "meshpoint.h"
+
+class Connectivity {
+public:
+    void build(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows);
+    void update(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows);
+    void clear();
+
+    int component(const QPoint& meshCoord) const;
+    bool connected(const QPoint& a, const QPoint& b) const;
+
+protected:
+    int cols = 0, rows = 0;
+    QVector<int> labels;
+    QVector<int> parent;
+
+    QVector<bool> blockedCells(const QHash<QPoint, MeshPoint>& mesh) const;
+    void flood(int cell, int label, const QVector<bool>& blocked);
+    int find(int label);
+    void unite(int a, int b);
+    void flatten();
+
+    bool inGrid(const QPoint& meshCoord) const;
+    int index(const QPoint& meshCoord) const;
+};
+
+#endif // CONNECTIVITY_H
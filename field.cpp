@@ -3,9 +3,25 @@
 //! и вычисления пути от одной точки до другой
 //!
 
+#include <QtConcurrent>
+#include <QThreadPool>
+#include <QSet>
+#include <QElapsedTimer>
+#include <QtMath>
 #include "field.h"
 #include "utils.h"
 
+static const Qt::PenStyle alternativeStyles[3] = { Qt::DashLine, Qt::DashDotLine, Qt::DashDotDotLine };
+
+//!
+//! Операция добавления препятствия для трассы
+//!
+static QString addRecord(const Obstacle& obst) {
+    QString op = QString("add %1 %2").arg(obst.walkness).arg(obst.poly.size());
+    for (const QPoint& point : obst.poly) op += QString(" %1 %2").arg(point.x()).arg(point.y());
+    return op;
+}
+
 Field::Field(unsigned w, unsigned h) {
     qDebug() << "Field::init" << w << h;
     this->width = w;
@@ -22,38 +38,47 @@ Field::~Field() {
 //! \param painter QPainter
 //!
 void Field::draw(QPainter* painter) {
+    qreal ratio = painter->device() != 0 ? painter->device()->devicePixelRatioF() : 1.;
+
     if (dGrid) {
-        QPen p(dGridOutline ? outlineGrid : QColor(0, 0, 0, 0));
-        painter->setPen(p);
-        for (auto it = mesh.keyValueBegin(); it != mesh.keyValueEnd(); ++it) {
-            QPoint startPoint = it->second.realCoord;
-            QColor sqColor = mix(easyObstacle, hardObstacle, it->second.walkness);
-            painter->setBrush(sqColor);
-            painter->drawRect(startPoint.x(), startPoint.y(), cellSize, cellSize);
-        }
+        quint64 key = ((quint64)meshRevision << 2) | (dGridOutline ? 1 : 0) | (adaptiveMesh ? 2 : 0);
+        if (updateLayer(gridLayer, gridKey, key, ratio)) renderGridLayer(gridLayer);
+        painter->drawImage(QPoint(0, 0), gridLayer);
     }
 
     if (!dNoObstacles) {
-        QPen p1(outlineObstacle, polyWidth);
-        QPen p2(textObstacle, polyWidth);
-        painter->setFont(QFont("Times", 16));
-        for (Obstacle& obst : obstacles) {
-            painter->setPen(p1);
-            QColor polyColor = mix(easyObstacle, hardObstacle, obst.walkness);
-            painter->setBrush(polyColor);
-            painter->drawPolygon(obst.poly);
-
-            painter->setPen(p2);
-            QPoint center = polygonCentroid(obst.poly);
-            if (obst.poly.boundingRect().contains(center)) {
-                QRect rect(center - QPoint(30, 30), QSize(60, 60));
-                double w = obst.walkness * 100;
-                painter->drawText(rect, Qt::AlignCenter, QString::number(w) + QString("%"));
-            }
+        quint64 key = ((quint64)obstacleRevision << 32) | (quint32)(liveObstacle + 1);
+        if (updateLayer(obstacleLayer, obstacleKey, key, ratio)) renderObstacleLayer(obstacleLayer);
+        painter->drawImage(QPoint(0, 0), obstacleLayer);
+        if (liveObstacle >= 0 && liveObstacle < obstacles.size()) drawObstacle(painter, obstacles[liveObstacle]);
+    }
+
+    if (!crossings.isEmpty()) {
+        painter->setPen(QPen(crossing, polyWidth * 2));
+        painter->setBrush(QColor(0, 0, 0, 0));
+        auto edgeLine = [this](int idx, int k) {
+            const QPolygon& poly = obstacles[idx].poly;
+            return QLine(poly[k], poly[(k + 1) % poly.size()]);
+        };
+        for (const EdgeCrossing& c : crossings) {
+            if (c.first >= obstacles.size() || c.second >= obstacles.size()) continue;
+            if (c.firstEdge >= obstacles[c.first].poly.size() || c.secondEdge >= obstacles[c.second].poly.size()) continue;
+            painter->drawLine(edgeLine(c.first, c.firstEdge));
+            painter->drawLine(edgeLine(c.second, c.secondEdge));
+            painter->drawEllipse(c.point, 5., 5.);
         }
     }
 
     if (!dNoPath) {
+        // Альтернативы рисуются под основным путём, каждая своим штрихом
+        for (int k = 0; k < alternatives.size(); k++) {
+            painter->setPen(QPen(k % 2 == 0 ? alternativePath : otherAlternativePath, pathWidth, alternativeStyles[k % 3]));
+            const QVector<MeshPoint>& alt = alternatives[k];
+            for (int i = 1; i < alt.length(); i++) {
+                painter->drawLine(alt[i-1].realCoord, alt[i].realCoord);
+            }
+        }
+
         QPen p(path, pathWidth, Qt::DotLine);
 
         for (int i = 1; i < way.length(); i++) {
@@ -64,6 +89,22 @@ void Field::draw(QPainter* painter) {
         }
     }
 
+    if (!dNoPath) {
+        QPen ap(agentPath, pathWidth, Qt::DotLine);
+        QPen ao(agentPath, pointWidth);
+        for (const Agent& agent : agents) {
+            painter->setPen(ap);
+            for (int i = 1; i < agent.way.length(); i++) {
+                painter->drawLine(agent.way[i-1].realCoord, agent.way[i].realCoord);
+            }
+            painter->setPen(ao);
+            painter->setBrush(fillStart);
+            painter->drawEllipse(agent.start, 4, 4);
+            painter->setBrush(fillEnd);
+            painter->drawEllipse(agent.goal, 4, 4);
+        }
+    }
+
     QPen p(outlineObstacle, pointWidth);
     painter->setPen(p);
 
@@ -76,12 +117,126 @@ void Field::draw(QPainter* painter) {
         painter->setBrush(fillEnd);
         painter->drawEllipse(*end, 6, 6);
     }
+
+    painter->setBrush(fillStop);
+    for (const QPoint& stop : stops) painter->drawEllipse(stop, 4, 4);
+}
+
+//!
+//! Нарисовать препятствие с подписью непроходимости
+//!
+//! \param painter QPainter
+//! \param obst Препятствие
+//!
+void Field::drawObstacle(QPainter* painter, const Obstacle& obst) {
+    painter->setPen(QPen(outlineObstacle, polyWidth));
+    painter->setBrush(mix(easyObstacle, hardObstacle, obst.walkness));
+    painter->drawPolygon(obst.poly);
+
+    painter->setPen(QPen(textObstacle, polyWidth));
+    painter->setFont(QFont("Times", 16));
+    QPoint center = polygonCentroid(obst.poly);
+    if (obst.poly.boundingRect().contains(center)) {
+        QRect rect(center - QPoint(30, 30), QSize(60, 60));
+        double w = obst.walkness * 100;
+        painter->drawText(rect, Qt::AlignCenter, QString::number(w) + QString("%"));
+    }
+}
+
+//!
+//! Подготовить слой отрисовки
+//! Неизменяемое между кадрами содержимое (сетка, препятствия) рисуется в слой один раз
+//! и перерисовывается, только когда меняется его ключ или размер поля
+//!
+//! \param layer Слой
+//! \param key Ключ содержимого слоя
+//! \param wanted Ключ текущего содержимого
+//! \param ratio Плотность пикселей устройства
+//! \return Слой очищен и его нужно нарисовать заново
+//!
+bool Field::updateLayer(QImage& layer, quint64& key, quint64 wanted, qreal ratio) {
+    QSize pixels(qCeil(width * ratio), qCeil(height * ratio));
+    if (layer.size() != pixels || layer.devicePixelRatio() != ratio) {
+        layer = QImage(pixels, QImage::Format_ARGB32_Premultiplied);
+        layer.setDevicePixelRatio(ratio);
+    } else if (key == wanted) {
+        return false;
+    }
+    layer.fill(Qt::transparent);
+    key = wanted;
+    return true;
+}
+
+//!
+//! Нарисовать сетку в слой
+//! Равномерная сетка рисуется изображением с пикселем на клетку, растянутым без сглаживания,
+//! вместо отдельного прямоугольника на каждую клетку
+//!
+//! \param layer Слой
+//!
+void Field::renderGridLayer(QImage& layer) {
+    QElapsedTimer timer;
+    timer.start();
+    QPainter painter(&layer);
+    QPen p(dGridOutline ? outlineGrid : QColor(0, 0, 0, 0));
+    if (adaptiveMesh) {
+        painter.setPen(p);
+        for (const QuadCell& cell : quadtree.cells()) {
+            painter.setBrush(mix(easyObstacle, hardObstacle, cell.walkness));
+            painter.drawRect(cell.rect);
+        }
+    } else {
+        QSize dims = meshSize();
+        if (dims.isEmpty()) return;
+        QImage cells(dims, QImage::Format_RGB32);
+        cells.fill(easyObstacle);
+        for (auto it = mesh.constBegin(); it != mesh.constEnd(); ++it) {
+            QRgb* line = (QRgb*)cells.scanLine(it.key().y());
+            line[it.key().x()] = mix(easyObstacle, hardObstacle, it->walkness).rgba();
+        }
+        painter.drawImage(QRect(0, 0, dims.width() * cellSize, dims.height() * cellSize), cells);
+        if (dGridOutline) {
+            painter.setPen(p);
+            for (int i = 0; i <= dims.width(); i++) painter.drawLine(QPoint(i * cellSize, 0), QPoint(i * cellSize, dims.height() * cellSize));
+            for (int j = 0; j <= dims.height(); j++) painter.drawLine(QPoint(0, j * cellSize), QPoint(dims.width() * cellSize, j * cellSize));
+        }
+    }
+    qInfo() << "Field::renderGridLayer" << "Rendered in" << timer.elapsed() << "ms";
+}
+
+//!
+//! Нарисовать препятствия в слой
+//! Перетаскиваемое препятствие (`Field::setLiveObstacle`) в слой не попадает и рисуется каждый кадр,
+//! поэтому перетаскивание вершины не перерисовывает слой
+//!
+//! \param layer Слой
+//!
+void Field::renderObstacleLayer(QImage& layer) {
+    QElapsedTimer timer;
+    timer.start();
+    QPainter painter(&layer);
+    painter.setRenderHint(QPainter::Antialiasing);
+    for (int i = 0; i < obstacles.size(); i++) {
+        if (i != liveObstacle) drawObstacle(&painter, obstacles[i]);
+    }
+    qInfo() << "Field::renderObstacleLayer" << "Rendered" << obstacles.size() << "in" << timer.elapsed() << "ms";
+}
+
+//!
+//! Задать препятствие, которое сейчас редактируется
+//! Оно рисуется поверх слоя препятствий каждый кадр
+//!
+//! \param idx Индекс препятствия (-1 -- нет)
+//!
+void Field::setLiveObstacle(int idx) {
+    liveObstacle = idx;
 }
 
 // Map -- Функции карты
 
 //!
 //! Загрузить карту из XML-файла
+//! Загрузка идёт стадиями `MapLoader`, текущий поток ждёт её окончания
 //!
 //! \param path Путь до XML-файла
 //! \return 0 в случае успеха
@@ -90,101 +245,83 @@ void Field::draw(QPainter* painter) {
 //! \return -3 если файл имеет неверные значения
 //!
 int Field::loadMap(const QString& path) {
-    obstacles.clear();
+    MapLoader loader;
+    int code = loader.start(path, cellSize).result();
+    if (code < 0) return code;
+    installMap(path, loader.document());
+    return 0;
+}
+
+//!
+//! Поставить в поле карту, загруженную `MapLoader`
+//! Непроходимость узлов, посчитанная при загрузке, используется, если шаг сетки не менялся
+//! и журнал не добавил правок
+//!
+//! \param path Путь до XML-файла (рядом лежат журнал правок и иерархия сжатия)
+//! \param doc Загруженная карта
+//!
+void Field::installMap(const QString& path, const MapDocument& doc) {
     way.clear();
-    start.reset();
-    end.reset();
+    alternatives.clear();
+    alternativeLengths.clear();
     mesh.clear();
-
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return -1;
-    QXmlStreamReader xml(&file);
-    bool ok;
-    while (!xml.atEnd() && !xml.hasError()) {
-        if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == QString("map")) {
-            QXmlStreamAttributes mapAttrs = xml.attributes();
-            if (!mapAttrs.hasAttribute("width") || !mapAttrs.hasAttribute("height")) return -2;
-            int wid = mapAttrs.value("width").toInt(&ok);
-            if (!ok || wid < minWidth || wid > maxWidth) return -3;
-            int hei = mapAttrs.value("height").toInt(&ok);
-            if (!ok || hei < minHeight || hei > maxHeight) return -3;
-            resizeMap(wid, hei, true);
-            while (!(xml.tokenType() == QXmlStreamReader::EndElement && xml.name() == QString("map"))) {
-                QXmlStreamReader::TokenType token = xml.readNext();
-                if (token == QXmlStreamReader::StartElement) {
-                    if (xml.name() == QString("polygons")) {
-                        while (!(xml.tokenType() == QXmlStreamReader::EndElement && xml.name() == QString("polygons"))) {
-                            if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == QString("poly")) {
-                                QXmlStreamAttributes polyAttrs = xml.attributes();
-                                if (!polyAttrs.hasAttribute("walkness")) return -2;
-                                QPolygon poly;
-                                double w = polyAttrs.value("walkness").toDouble(&ok);
-                                if (!ok || w < 0. || w > 1.) return -3;
-                                while (!(xml.tokenType() == QXmlStreamReader::EndElement && xml.name() == QString("poly"))) {
-                                    if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == QString("point")) {
-                                        QXmlStreamAttributes pointAttrs = xml.attributes();
-                                        if (!pointAttrs.hasAttribute("x") || !pointAttrs.hasAttribute("y")) return -2;
-                                        unsigned x = pointAttrs.value("x").toInt(&ok);
-                                        if (!ok || x < 0 || x > width) return -3;
-                                        unsigned y = pointAttrs.value("y").toInt(&ok);
-                                        if (!ok || y < 0 || y > height) return -3;
-                                        poly << QPoint(x, y);
-                                    }
-                                }
-                                obstacles.append(Obstacle(poly, w));
-                            }
-                        }
-                    }
-                    if (xml.name() == QString("path")) {
-                        while (!(xml.tokenType() == QXmlStreamReader::EndElement && xml.name() == QString("path"))) {
-                            if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == QString("point")) {
-                                QXmlStreamAttributes pointAttrs = xml.attributes();
-                                if (!pointAttrs.hasAttribute("x") || !pointAttrs.hasAttribute("y")) return -2;
-                                unsigned x = pointAttrs.value("x").toInt(&ok);
-                                if (!ok || x < 0 || x > width) return -3;
-                                unsigned y = pointAttrs.value("y").toInt(&ok);
-                                if (!ok || y < 0 || y > height) return -3;
-                                way.append(MeshPoint(QPoint(-1,-1), QPoint(x, y), 0));
-                            }
-                        }
-                    }
-                    if (xml.name() == QString("start")) {
-                        QXmlStreamAttributes startAttrs = xml.attributes();
-                        if (!startAttrs.hasAttribute("x") || !startAttrs.hasAttribute("y")) return -2;
-                        unsigned x = startAttrs.value("x").toInt(&ok);
-                        if (!ok || x < 0 || x > width) return -3;
-                        unsigned y = startAttrs.value("y").toInt(&ok);
-                        if (!ok || y < 0 || y > height) return -3;
-                        start.emplace(QPoint(x, y));
-                    }
-                    if (xml.name() == QString("end")) {
-                        QXmlStreamAttributes finishAttrs = xml.attributes();
-                        if (!finishAttrs.hasAttribute("x") || !finishAttrs.hasAttribute("y")) return -2;
-                        unsigned x = finishAttrs.value("x").toInt(&ok);
-                        if (!ok || x < 0 || x > width) return -3;
-                        unsigned y = finishAttrs.value("y").toInt(&ok);
-                        if (!ok || y < 0 || y > height) return -3;
-                        end.emplace(QPoint(x, y));
-                    }
-                }
-            }
+    journal.detach();
+    resizeMap(doc.width, doc.height, true);
+
+    obstacles = doc.obstacles;
+    obstacleRevision++;
+    edges = doc.edges;
+    crossings = doc.crossings;
+    for (const QPoint& point : doc.path) way.append(MeshPoint(QPoint(-1,-1), point, 0));
+    agents = doc.agents;
+    start = doc.start;
+    end = doc.end;
+    stops = doc.stops;
+
+    // Правки, дописанные в журнал после последней полной записи карты
+    QStringList edits;
+    if (MapJournal::read(path, doc.digest, edits) == 0) {
+        int applied = 0;
+        for (const QString& edit : edits) {
+            if (applyEdit(edit)) applied++;
         }
+        if (!edits.isEmpty()) qInfo() << "Field::load" << "Journal" << applied << "of" << edits.size() << "edits";
+        journal.attach(path, edits.size());
     }
-    regenMesh();
-    return 0;
+    QVector<double> factors;
+    if (edits.isEmpty()) {
+        if (doc.cellSize == cellSize) factors = doc.factors;
+    } else {
+        validateObstacles();
+    }
+
+    recordState();
+    regenMesh(factors);
+    // Иерархия из файла рядом с картой (`<карта>.ch`) подхватывается, только если она построена для этой сетки
+    if (hierarchyNearMap) loadHierarchy(path + ContractionHierarchy::fileSuffix);
+    // Путь в XML-файле найден до правок из журнала
+    if (!edits.isEmpty()) searchPath();
 }
 
 //!
 //! Сохранить карту в XML-файл
+//! Если карта загружена из этого файла или уже сохранялась в него, в журнал (см. `MapJournal`) дописываются
+//! только правки с прошлого сохранения; целиком XML пишется при первом сохранении и при уплотнении журнала
 //!
 //! \param path Путь до XML-файла
 //! \return 0 в случае успеха
 //! \return -1 если произошла ошибка
 //!
 int Field::saveMap(const QString& path) {
+    if (journal.attached(path) && !journal.needsCompaction() && journal.flush() == 0) {
+        saveHierarchyNear(path);
+        return 0;
+    }
+
     QFile file(path);
     if (!file.open(QFile::WriteOnly | QFile::Text)) return -1;
-    QXmlStreamWriter stream(&file);
+    QByteArray document;
+    QXmlStreamWriter stream(&document);
     stream.setAutoFormatting(true);
     stream.writeStartDocument();
     stream.writeStartElement("map");
@@ -216,6 +353,19 @@ int Field::saveMap(const QString& path) {
     }
     stream.writeEndElement(); // path
 
+    if (!agents.isEmpty()) {
+        stream.writeStartElement("agents");
+        for (Agent& agent : agents) {
+            stream.writeStartElement("agent");
+            stream.writeAttribute("sx", QString::number(agent.start.x()));
+            stream.writeAttribute("sy", QString::number(agent.start.y()));
+            stream.writeAttribute("ex", QString::number(agent.goal.x()));
+            stream.writeAttribute("ey", QString::number(agent.goal.y()));
+            stream.writeEndElement(); // agent
+        }
+        stream.writeEndElement(); // agents
+    }
+
     if (start.has_value()) {
         stream.writeStartElement("start");
         stream.writeAttribute("x", QString::number(start->x()));
@@ -230,11 +380,39 @@ int Field::saveMap(const QString& path) {
         stream.writeEndElement(); // end
     }
 
+    if (!stops.isEmpty()) {
+        stream.writeStartElement("stops");
+        for (const QPoint& stop : stops) {
+            stream.writeStartElement("stop");
+            stream.writeAttribute("x", QString::number(stop.x()));
+            stream.writeAttribute("y", QString::number(stop.y()));
+            stream.writeEndElement(); // stop
+        }
+        stream.writeEndElement(); // stops
+    }
+
     stream.writeEndElement(); // map
     stream.writeEndDocument();
+    if (file.write(document) != document.size()) return -1;
+    file.close();
+
+    // Новый журнал начинается с полной записи; старые правки уже вошли в XML
+    QByteArray digest = MapJournal::digestOf(document);
+    if (MapJournal::create(path, digest) == 0) journal.attach(path, 0);
+    else journal.detach();
+    saveHierarchyNear(path);
     return 0;
 }
 
+//!
+//! Сохранить иерархию сжатия рядом с картой, если она построена
+//!
+void Field::saveHierarchyNear(const QString& path) {
+    if (!hierarchy.isNull() && saveHierarchy(path + ContractionHierarchy::fileSuffix) < 0) {
+        qWarning() << "Field::save" << "Hierarchy not saved";
+    }
+}
+
 //!
 //! Поменять размеры карты
 //!
@@ -243,9 +421,13 @@ int Field::saveMap(const QString& path) {
 //!
 void Field::resizeMap(unsigned width, unsigned height, bool noRegen) {
     obstacles.clear();
+    obstacleRevision++;
+    crossings.clear();
     this->width = width;
     this->height = height;
     qDebug() << "Field::size" << "Set to" << width << height;
+    // При загрузке карты размер записывается в трассу вместе с её содержимым (`Field::recordState`)
+    if (!noRegen) record(QString("resize %1 %2").arg(width).arg(height));
     if (!noRegen) regenMesh();
 }
 
@@ -279,44 +461,143 @@ double Field::getFactorMap(const QPoint& point) {
 //!
 //! \brief Генерация сетки.
 //! Генерирует сетку, ширина ячейки которой равна `Field::cellSize`.
-//! Необходимый этап перед запуском нахождения кратчайшего пути
+//! Необходимый этап перед запуском нахождения кратчайшего пути.
+//! Непроходимость узлов считается параллельно полосами строк (`Field::rasterize`),
+//! каждая полоса пишет только в свои узлы, поэтому блокировки не нужны, а результат совпадает с последовательным
+//!
+//! \param precomputed Непроходимость узлов, уже посчитанная по текущим препятствиям (при загрузке карты);
+//! если размер не совпадает с сеткой, она считается заново
 //!
-void Field::regenMesh() {
+void Field::regenMesh(const QVector<double>& precomputed) {
     mesh.clear();
+    meshRevision++;
+    record(QString("regen %1 %2").arg(cellSize).arg(adaptiveMesh ? 1 : 0));
+
+    QSize dims = meshSize();
+    int cols = dims.width(), rows = dims.height();
+    QVector<double> factors = precomputed.size() == cols * rows ? precomputed : rasterize(QRect(QPoint(0, 0), dims));
+    const double* data = factors.constData();
 
-    for (unsigned i = 0; i * Field::cellSize < width; i++) {
-        for (unsigned j = 0; j * Field::cellSize < height; j++) {
+    mesh.reserve(cols * rows);
+    for (int i = 0; i < cols; i++) {
+        for (int j = 0; j < rows; j++) {
             QPoint meshCoord = QPoint(i, j);
             QPoint realCoord = QPoint(i * Field::cellSize, j * Field::cellSize);
-            double factor = getFactorMap(realCoord);
-            MeshPoint meshp(meshCoord, realCoord, factor);
-
-            mesh[meshCoord] = meshp;
+            mesh.insert(meshCoord, MeshPoint(meshCoord, realCoord, data[i * rows + j]));
         }
     }
 
+    cells.assign(factors, cols, rows, cellLayout);
     qInfo() << "Field::mesh" << "Generated size" << mesh.size();
+
+    connectivity.update(mesh, dims.width(), dims.height());
+    clearance.update(factors, cols, rows);
+    // Иерархия сжатия остаётся, только если непроходимость сетки не изменилась
+    if (!hierarchy.isNull() && hierarchy->fingerprint != ContractionHierarchy::fingerprintOf(factors, cols, rows)) {
+        qInfo() << "Field::hierarchy" << "Dropped, mesh changed";
+        hierarchy.reset();
+    }
+    sight.build(mesh, dims.width(), dims.height(), cellSize);
+    sight.setClearance(clearance.distances());
+    landmarks.rebuild(mesh, dims.width(), dims.height(), meshRevision);
+
+    if (adaptiveMesh) {
+        quadtree.build(obstacles, width, height, cellSize);
+        qInfo() << "Field::quadtree" << "Generated leaves" << quadtree.count();
+    } else {
+        quadtree.clear();
+    }
+
+    for (int i = 0; i < obstacles.size(); i++) obstacleEdges(i);
+    QSharedPointer<MapSnapshot> snap(new MapSnapshot());
+    snap->revision = meshRevision;
+    snap->width = width;
+    snap->height = height;
+    snap->cellSize = cellSize;
+    snap->obstacles = obstacles;
+    snap->edges = edges;
+    snap->mesh = mesh;
+    snap->cells = cells;
+    snap->connectivity = connectivity;
+    snap->sight = sight;
+    snap->clearance = clearance;
+    snap->landmarks = landmarks.future();
+    snap->hierarchy = hierarchy;
+    store.publish(snap);
+}
+
+//!
+//! Посчитать непроходимость узлов сетки в прямоугольнике клеток
+//! Прямоугольник делится на полосы строк, которые считаются параллельно
+//!
+//! \param cells Прямоугольник клеток сетки
+//! \return Непроходимость узлов (индекс `(i - left) * height + (j - top)`)
+//!
+QVector<double> Field::rasterize(const QRect& cells) const {
+    QVector<double> factors(cells.width() * cells.height());
+    if (factors.isEmpty()) return factors;
+    double* data = factors.data();
+    int height = cells.height();
+    int bandCount = qMin(height, QThreadPool::globalInstance()->maxThreadCount() * bandsPerThread);
+    QVector<int> bands;
+    for (int band = 0; band < bandCount; band++) bands.append(band);
+    QtConcurrent::blockingMap(bands, [&](int band) {
+        int from = height * band / bandCount, to = height * (band + 1) / bandCount;
+        rasterizeCells(data + from, height, QRect(cells.left(), cells.top() + from, cells.width(), to - from));
+    });
+    return factors;
+}
+
+//!
+//! Посчитать непроходимость узлов сетки в прямоугольнике клеток в текущем потоке.
+//! Препятствия отбираются по ограничивающему прямоугольнику один раз на вызов, порядок проверки
+//! тот же, что и в `Field::getFactorMap`, поэтому при перекрытии побеждает то же препятствие.
+//! Вызывается из нескольких потоков одновременно для непересекающихся полос
+//!
+//! \param factors Непроходимость узлов (индекс `(i - left) * stride + (j - top)`)
+//! \param stride Шаг между столбцами в factors
+//! \param cells Прямоугольник клеток сетки
+//!
+void Field::rasterizeCells(double* factors, int stride, const QRect& cells) const {
+    QRect area(cells.left() * cellSize, cells.top() * cellSize, (cells.width() - 1) * cellSize + 1, (cells.height() - 1) * cellSize + 1);
+    QVector<const Obstacle*> candidates;
+    QVector<QRect> boxes;
+    for (const Obstacle& obst : obstacles) {
+        QRect box = obst.poly.boundingRect();
+        if (!box.intersects(area)) continue;
+        candidates.append(&obst);
+        boxes.append(box);
+    }
+
+    for (int i = cells.left(); i <= cells.right(); i++) {
+        for (int j = cells.top(); j <= cells.bottom(); j++) {
+            QPoint realCoord(i * cellSize, j * cellSize);
+            double factor = 0.;
+            for (int k = 0; k < candidates.size(); k++) {
+                if (boxes[k].contains(realCoord) && candidates[k]->poly.containsPoint(realCoord, Qt::FillRule::OddEvenFill)) {
+                    factor = candidates[k]->walkness;
+                    break;
+                }
+            }
+            factors[(i - cells.left()) * stride + (j - cells.top())] = factor;
+        }
+    }
 }
 
 //!
 //! Ближайшая точка на сетке.
-//! Получить ближайшую точку на сетке используя произвольную точку
+//! Получить ближайшую точку на сетке используя произвольную точку.
+//! Узлы сетки лежат в точках, кратных `cellSize`, поэтому ближайший узел находится округлением координат
 //!
 //! \param point Точка
 //! \return Указатель на ближайшую точку или nullptr если не найдено
 //!
 MeshPoint* Field::nearestMesh(const QPoint& point) {
-    MeshPoint* shortestMesh = 0;
-    double shortestDist = width * height;
-    for (auto it = mesh.keyValueBegin(); it != mesh.keyValueEnd(); ++it) {
-        MeshPoint& meshp = it->second;
-        double dist = euclideanDistance(meshp.realCoord, point);
-        if (dist < shortestDist) {
-            shortestDist = dist;
-            shortestMesh = &meshp;
-        }
-    }
-    return shortestMesh;
+    QSize dims = meshSize();
+    if (dims.isEmpty()) return 0;
+    int i = qBound(0, qRound((double)point.x() / cellSize), dims.width() - 1);
+    int j = qBound(0, qRound((double)point.y() / cellSize), dims.height() - 1);
+    return getMesh(QPoint(i, j));
 }
 
 //!
@@ -331,6 +612,200 @@ MeshPoint* Field::getMesh(const QPoint& point) {
     return 0;
 }
 
+//!
+//! Включить/выключить запись трассы
+//! При включении в трассу сразу записывается текущее состояние карты, чтобы её можно было воспроизвести с нуля
+//!
+//! \param recorder Запись трассы или 0, чтобы выключить запись
+//!
+void Field::setTrace(TraceRecorder* recorder) {
+    trace = recorder;
+    recordState();
+    record(QString("regen %1 %2").arg(cellSize).arg(adaptiveMesh ? 1 : 0));
+}
+
+//!
+//! Дождаться фонового построения ориентиров для текущей сетки
+//! Нужно там, где важна воспроизводимость: без ориентиров A* может выбрать другой путь той же стоимости
+//!
+void Field::waitLandmarks() {
+    landmarks.wait();
+}
+
+//!
+//! Записать операцию в трассу, если запись включена, и в журнал правок (см. `MapJournal`)
+//!
+void Field::record(const QString& operation) {
+    if (muted) return;
+    if (trace != 0) trace->record(operation);
+    journal.record(operation);
+}
+
+//!
+//! Применить правку карты, записанную операцией трассы (см. `tracerecorder.cpp`)
+//! Используется при загрузке журнала правок и при воспроизведении трассы (`tools/tracereplay`);
+//! сама правка никуда не записывается
+//!
+//! \param operation Операция с аргументами
+//! \return false если операция не распознана или её аргументы не подходят к текущей карте
+//!
+bool Field::applyEdit(const QString& operation) {
+    QStringList args = operation.split(' ', Qt::SkipEmptyParts);
+    if (args.isEmpty()) return false;
+    QString op = args.takeFirst();
+    auto arg = [&args](int i) { return i < args.size() ? args[i].toInt() : 0; };
+    int count = obstacles.size();
+    bool wasMuted = muted;
+    muted = true;
+    bool ok = true;
+    if (op == "resize") {
+        resizeMap(arg(0), arg(1), true);
+    } else if (op == "add") {
+        QPolygon poly;
+        for (int i = 0; i < arg(1); i++) poly << QPoint(arg(2 + 2 * i), arg(3 + 2 * i));
+        addObstacle(Obstacle(poly, args.value(0).toDouble()));
+    } else if (op == "remove") {
+        ok = arg(0) >= 0 && arg(0) < count && removeObstacle(obstacles[arg(0)]);
+    } else if (op == "insert") {
+        ok = arg(0) >= 0 && arg(0) < count && addToObstacle(obstacles[arg(0)], QPoint(arg(1), arg(2)));
+    } else if (op == "erase") {
+        ok = arg(0) >= 0 && arg(0) < count && removeFromObstacle(obstacles[arg(0)], QPoint(arg(1), arg(2)));
+    } else if (op == "move") {
+        ok = moveVertex(arg(0), arg(1), QPoint(arg(2), arg(3)));
+    } else if (op == "start") {
+        if (args.value(0) == "-") unsetStart();
+        else setStart(QPoint(arg(0), arg(1)));
+    } else if (op == "end") {
+        if (args.value(0) == "-") unsetEnd();
+        else setEnd(QPoint(arg(0), arg(1)));
+    } else if (op == "stop") {
+        if (args.value(0) == "-") clearStops();
+        else addStop(QPoint(arg(0), arg(1)));
+    } else if (op == "unstop") {
+        ok = removeStop(QPoint(arg(0), arg(1)));
+    } else {
+        ok = false;
+    }
+    muted = wasMuted;
+    return ok;
+}
+
+//!
+//! Записать в трассу текущее состояние карты: размер, препятствия, старт, финиш и остановки
+//!
+void Field::recordState() {
+    if (trace == 0) return;
+    // Состояние уже есть в файле карты, поэтому пишется только в трассу, не в журнал правок
+    trace->record(QString("resize %1 %2").arg(width).arg(height));
+    for (const Obstacle& obst : obstacles) {
+        trace->record(addRecord(obst));
+    }
+    if (start.has_value()) trace->record(QString("start %1 %2").arg(start->x()).arg(start->y()));
+    if (end.has_value()) trace->record(QString("end %1 %2").arg(end->x()).arg(end->y()));
+    for (const QPoint& stop : stops) trace->record(QString("stop %1 %2").arg(stop.x()).arg(stop.y()));
+}
+
+//!
+//! Размеры сетки в ячейках
+//!
+//! \return Количество столбцов и строк сетки
+//!
+QSize Field::meshSize() {
+    return QSize((width + cellSize - 1) / cellSize, (height + cellSize - 1) / cellSize);
+}
+
+//!
+//! Получить последний опубликованный снимок карты
+//! Снимок публикуется при каждой генерации сетки и не меняется при последующем редактировании поля
+//!
+QSharedPointer<const MapSnapshot> Field::snapshot() {
+    return store.snapshot();
+}
+
+//!
+//! Хранилище снимков карты, из которого их можно брать в других потоках
+//!
+MapStore& Field::getStore() {
+    return store;
+}
+
+//!
+//! Построить иерархию сжатия для текущей сетки (см. `ContractionHierarchy`)
+//! Пока непроходимость сетки не изменится, пути точечного агента на равномерной сетке ищутся по иерархии,
+//! а при сохранении карты иерархия записывается рядом с ней
+//!
+//! \return Время построения в миллисекундах
+//!
+qint64 Field::buildHierarchy() {
+    QElapsedTimer timer;
+    timer.start();
+    QSize dims = meshSize();
+    hierarchy = ContractionHierarchy::build(meshFactors(), dims.width(), dims.height());
+    publishHierarchy();
+    return timer.elapsed();
+}
+
+//!
+//! Иерархия сжатия построена или загружена для текущей сетки
+//!
+bool Field::hasHierarchy() {
+    return !hierarchy.isNull();
+}
+
+//!
+//! Загрузить иерархию сжатия из файла
+//!
+//! \param path Путь до файла
+//! \return 0 в случае успеха
+//! \return -1 если файла нет, он повреждён или построен для другой сетки
+//!
+int Field::loadHierarchy(const QString& path) {
+    QSize dims = meshSize();
+    QSharedPointer<const ContractionHierarchy> loaded = ContractionHierarchy::load(path, ContractionHierarchy::fingerprintOf(meshFactors(), dims.width(), dims.height()));
+    if (loaded.isNull()) return -1;
+    hierarchy = loaded;
+    publishHierarchy();
+    qInfo() << "Field::hierarchy" << "Loaded" << path;
+    return 0;
+}
+
+//!
+//! Сохранить иерархию сжатия в файл
+//!
+//! \param path Путь до файла
+//! \return 0 в случае успеха
+//! \return -1 если иерархии нет или произошла ошибка
+//!
+int Field::saveHierarchy(const QString& path) {
+    if (hierarchy.isNull()) return -1;
+    return hierarchy->save(path);
+}
+
+//!
+//! Непроходимость узлов сетки (индекс `i * rows + j`), как её считает `Field::regenMesh`
+//!
+QVector<double> Field::meshFactors() {
+    QSize dims = meshSize();
+    int rows = dims.height();
+    QVector<double> factors(dims.width() * rows, 1.);
+    for (auto it = mesh.constBegin(); it != mesh.constEnd(); ++it) {
+        const QPoint& p = it.key();
+        if (p.x() < dims.width() && p.y() < rows) factors[p.x() * rows + p.y()] = it.value().walkness;
+    }
+    return factors;
+}
+
+//!
+//! Опубликовать снимок с текущей иерархией, остальное содержимое снимка разделяется с предыдущим
+//!
+void Field::publishHierarchy() {
+    QSharedPointer<const MapSnapshot> current = store.snapshot();
+    if (current.isNull()) return;
+    QSharedPointer<MapSnapshot> snap(new MapSnapshot(*current));
+    snap->hierarchy = hierarchy;
+    store.publish(snap);
+}
+
 // Points -- Точки пути
 
 //!
@@ -341,6 +816,7 @@ MeshPoint* Field::getMesh(const QPoint& point) {
 void Field::setStart(QPoint point) {
     qInfo() << "Field::start" << point;
     start.emplace(point);
+    record(QString("start %1 %2").arg(point.x()).arg(point.y()));
 }
 
 //!
@@ -351,6 +827,7 @@ void Field::setStart(QPoint point) {
 void Field::setEnd(QPoint point) {
     qInfo() << "Field::end" << point;
     end.emplace(point);
+    record(QString("end %1 %2").arg(point.x()).arg(point.y()));
 }
 
 //!
@@ -359,6 +836,7 @@ void Field::setEnd(QPoint point) {
 void Field::unsetStart() {
     qInfo() << "Field::start NULL";
     start.reset();
+    record("start -");
 }
 
 //!
@@ -367,6 +845,7 @@ void Field::unsetStart() {
 void Field::unsetEnd() {
     qInfo() << "Field::end NULL";
     end.reset();
+    record("end -");
 }
 
 //!
@@ -387,6 +866,138 @@ Waypoint Field::getEnd() {
     return end;
 }
 
+//!
+//! Добавить промежуточную остановку маршрута
+//! Путь от старта к финишу проходит через все остановки, порядок обхода подбирается (см. `Field::tourPath`)
+//!
+//! \param point Точка остановки
+//!
+void Field::addStop(QPoint point) {
+    qInfo() << "Field::stop" << point;
+    stops.append(point);
+    record(QString("stop %1 %2").arg(point.x()).arg(point.y()));
+}
+
+//!
+//! Убрать ближайшую к точке остановку (не дальше `stopGrabRadius`)
+//!
+//! \param point Точка
+//! \return Была ли убрана остановка
+//!
+bool Field::removeStop(const QPoint& point) {
+    int nearest = -1;
+    double best = stopGrabRadius;
+    for (int i = 0; i < stops.size(); i++) {
+        double d = euclideanDistance(stops[i], point);
+        if (d <= best) {
+            best = d;
+            nearest = i;
+        }
+    }
+    if (nearest < 0) return false;
+    qInfo() << "Field::stop" << "Removed" << stops[nearest];
+    stops.remove(nearest);
+    record(QString("unstop %1 %2").arg(point.x()).arg(point.y()));
+    return true;
+}
+
+//!
+//! Убрать все промежуточные остановки
+//!
+void Field::clearStops() {
+    qInfo() << "Field::stop NULL";
+    stops.clear();
+    record("stop -");
+}
+
+//!
+//! Получить промежуточные остановки в порядке добавления
+//!
+const QVector<QPoint>& Field::getStops() {
+    return stops;
+}
+
+// Agents -- Агенты
+
+//!
+//! Получить агентов карты
+//!
+//! \return Агенты
+//!
+QVector<Agent>& Field::getAgents() {
+    return agents;
+}
+
+//!
+//! Спланировать пути всех агентов карты без столкновений между ними
+//! Пути сохраняются в самих агентах. Поиск каждого агента ограничен бюджетом памяти `searchBudget`,
+//! агент, которому его не хватило, остаётся без пути
+//!
+//! \return Время планирования в миллисекундах
+//!
+qint64 Field::planAgents() {
+    QSize dims = meshSize();
+    CooperativePlanner planner(mesh, dims.width(), dims.height(), cellSize);
+    qint64 elapsed = planner.plan(agents, 0, searchBudget);
+    int solved = 0;
+    for (const Agent& agent : agents) {
+        if (agent.solved) solved++;
+    }
+    qInfo() << "Field::agents" << solved << "/" << agents.size() << "in" << elapsed << "ms";
+    return elapsed;
+}
+
+//!
+//! Проложить пути всех агентов карты к их целям независимо друг от друга (без учёта столкновений, в отличие
+//! от `Field::planAgents`). Агентов с общей целью ведёт одно поле стоимостей (`FlowField`): один проход Дейкстры
+//! от цели и спуск по градиенту для каждого агента. Поля строятся параллельно, с учётом радиуса агента `agentRadius`,
+//! и хранятся, пока не изменятся сетка, радиус или цели агентов. Пути сохраняются в самих агентах
+//!
+//! \return Время в миллисекундах
+//!
+qint64 Field::routeAgents() {
+    QElapsedTimer timer;
+    timer.start();
+    activeRadius = agentRadius / cellSize;
+
+    QSet<QPoint> goals;
+    for (const Agent& agent : agents) {
+        MeshPoint* goal = nearestMesh(agent.goal);
+        if (goal != 0) goals.insert(goal->meshCoord);
+    }
+    for (auto it = flows.begin(); it != flows.end();) {
+        if (goals.contains(it.key())) ++it;
+        else it = flows.erase(it);
+    }
+    QVector<std::pair<QPoint, FlowField*>> stale;
+    for (const QPoint& goal : goals) {
+        FlowField& field = flows[goal];
+        if (!field.valid(goal, meshRevision, activeRadius)) stale.append(std::make_pair(goal, &field));
+    }
+    QSize dims = meshSize();
+    QtConcurrent::blockingMap(stale, [&](const std::pair<QPoint, FlowField*>& job) {
+        job.second->setClearance(&clearance, activeRadius);
+        job.second->build(mesh, dims.width(), dims.height(), cellSize, job.first, meshRevision);
+    });
+
+    int solved = 0;
+    for (Agent& agent : agents) {
+        agent.way.clear();
+        agent.cost = 0;
+        MeshPoint* mstart = nearestMesh(agent.start);
+        MeshPoint* mgoal = nearestMesh(agent.goal);
+        if (mstart != 0 && mgoal != 0) agent.cost = flows[mgoal->meshCoord].descend(mstart->meshCoord, agent.way);
+        agent.solved = agent.cost > 0;
+        if (agent.solved) {
+            refinePath(agent.way);
+            solved++;
+        }
+    }
+    qint64 elapsed = timer.elapsed();
+    qInfo() << "Field::routeAgents" << solved << "/" << agents.size() << "Fields built" << stale.size() << "in" << elapsed << "ms";
+    return elapsed;
+}
+
 // Polygon Editing -- Редактирование полигонов
 
 //!
@@ -411,6 +1022,26 @@ QVector<Obstacle>& Field::getObstacles() {
     return obstacles;
 }
 
+//!
+//! Ревизия препятствий: меняется при каждом изменении препятствий, кроме перемещения
+//! вершин перетаскиваемого препятствия (`Field::setLiveObstacle`)
+//!
+unsigned Field::getObstacleRevision() {
+    return obstacleRevision;
+}
+
+//!
+//! Добавить препятствие
+//!
+//! \param obst Препятствие
+//!
+void Field::addObstacle(const Obstacle& obst) {
+    qInfo() << "Field::addObst" << obst.walkness;
+    obstacles.append(obst);
+    obstacleRevision++;
+    record(addRecord(obst));
+}
+
 //!
 //! Удалить препятствие по точке
 //!
@@ -425,15 +1056,20 @@ bool Field::removeObstacle(const QPoint& point) {
 
 //!
 //! Удалить препятствие
-//! Удаляемое препятствие должно присутствовать в списке препятствий поля
+//! Удаляемое препятствие должно быть элементом списка препятствий поля (ссылкой на него, а не копией):
+//! номер берётся по адресу, как в `Canvas`, поэтому из одинаковых препятствий удаляется именно это
 //!
 //! \param obst Препятствие.
 //! \return Успех или нет
 //!
 bool Field::removeObstacle(const Obstacle& obst) {
     qInfo() << "Field::remObst" << obst.walkness;
-    if (obstacles.removeOne(obst)) return true;
-    return false;
+    int idx = &obst - obstacles.constData();
+    if (idx < 0 || idx >= obstacles.size()) return false;
+    record(QString("remove %1").arg(idx));
+    obstacles.removeAt(idx);
+    obstacleRevision++;
+    return true;
 }
 
 
@@ -454,7 +1090,7 @@ bool Field::addToObstacle(const QPoint& point) {
 //! Добавляет точку в препятствие, разделяя ближайшее к этой точке ребро на две части,
 //! соединённых данной точкой
 //!
-//! \param obst Препятствие
+//! \param obst Препятствие (элемент списка препятствий поля, см. `Field::removeObstacle`)
 //! \param point Точка
 //!
 bool Field::addToObstacle(Obstacle& obst, const QPoint& point) {
@@ -472,7 +1108,9 @@ bool Field::addToObstacle(Obstacle& obst, const QPoint& point) {
             closest = dst;
         }
     }
+    record(QString("insert %1 %2 %3").arg(&obst - obstacles.constData()).arg(point.x()).arg(point.y()));
     obst.poly.insert(idx, point);
+    obstacleRevision++;
     qInfo() << "Field::addPoint" << point;
     return true;
 }
@@ -494,7 +1132,7 @@ bool Field::removeFromObstacle(const QPoint& point) {
 //! Удалить точку из препятствия
 //! Удаляет точку, которая лежит ближе всего к точке, данной пользователем
 //!
-//! \param obst Препятствие
+//! \param obst Препятствие (элемент списка препятствий поля, см. `Field::removeObstacle`)
 //! \param point Точка
 //! \return Успех или нет
 //!
@@ -511,17 +1149,99 @@ bool Field::removeFromObstacle(Obstacle& obst, const QPoint& point) {
         }
     }
     if (idx == -1) return false;
+    record(QString("erase %1 %2 %3").arg(&obst - obstacles.constData()).arg(point.x()).arg(point.y()));
     obst.poly.removeAt(idx);
+    obstacleRevision++;
     qInfo() << "Field::remPoint" << point;
-    if (obst.poly.size() < 3) removeObstacle(obst);
+    if (obst.poly.size() < 3) {
+        // Удаление -- часть операции erase, отдельно в трассу и журнал не пишется
+        bool wasMuted = muted;
+        muted = true;
+        removeObstacle(obst);
+        muted = wasMuted;
+    }
     return true;
 }
 
+//!
+//! Рёбра препятствия для точных проверок пересечения
+//! Рёбра строятся заново, только если полигон препятствия изменился
+//!
+//! \param idx Индекс препятствия
+//! \return Рёбра
+//!
+const EdgeBatch& Field::obstacleEdges(int idx) {
+    if (edges.size() != obstacles.size()) edges.resize(obstacles.size());
+    if (!edges[idx].matches(obstacles[idx].poly)) edges[idx].assign(obstacles[idx].poly);
+    return edges[idx];
+}
+
+//!
+//! Проверка на пересечение полигона с препятствиями
+//!
+//! \param poly Полигон
+//! \param except Индекс препятствия, которое не нужно учитывать (-1 -- учитывать все)
+//! \return Успех или нет
+//!
+bool Field::intersectsObstacles(const QPolygon& poly, int except) {
+    EdgeBatch batch(poly);
+    for (int i = 0; i < obstacles.size(); i++) {
+        if (i != except && obstacleEdges(i).intersects(batch)) return true;
+    }
+    return false;
+}
+
+//!
+//! Переместить вершину препятствия
+//! Вершина не перемещается, если препятствие после этого пересечёт другие препятствия
+//!
+//! \param obstacle Индекс препятствия
+//! \param vertex Индекс вершины
+//! \param point Новое положение вершины
+//! \return Перемещена вершина или нет
+//!
+bool Field::moveVertex(int obstacle, int vertex, const QPoint& point) {
+    if (obstacle < 0 || obstacle >= obstacles.size()) return false;
+    QPolygon moved = obstacles[obstacle].poly;
+    if (vertex < 0 || vertex >= moved.size()) return false;
+    moved[vertex] = point;
+    if (intersectsObstacles(moved, obstacle)) return false;
+    obstacles[obstacle].poly = moved;
+    // Перетаскиваемое препятствие рисуется поверх слоя, слой перерисовывать не нужно
+    if (obstacle != liveObstacle) obstacleRevision++;
+    record(QString("move %1 %2 %3 %4").arg(obstacle).arg(vertex).arg(point.x()).arg(point.y()));
+    return true;
+}
+
+//!
+//! Проверка всех препятствий на пересечения рёбер и самопересечения заметающей прямой (`SweepLine`).
+//! Редактор не даёт создать пересекающиеся препятствия, но загруженная карта может их содержать,
+//! а `getFactorMap` в области наложения вернёт непроходимость первого из них.
+//! Найденные пересечения подсвечиваются при отрисовке до следующей проверки
+//!
+//! \return Количество пересечений
+//!
+int Field::validateObstacles() {
+    QVector<QPolygon> polygons;
+    polygons.reserve(obstacles.size());
+    for (const Obstacle& obst : obstacles) polygons.append(obst.poly);
+    crossings = SweepLine().find(polygons);
+    return crossings.size();
+}
+
+//!
+//! Пересечения препятствий, найденные последней проверкой `Field::validateObstacles`
+//!
+const QVector<EdgeCrossing>& Field::getCrossings() {
+    return crossings;
+}
+
 // Pathfinding -- Пути
 
 //!
 //! Найти путь
 //! Ищет кратчайший путь по сгенерированной раннее сетке с помощью алгоритма A*.
+//! Если старт и финиш лежат в разных компонентах связности, то поиск не запускается.
 //! Если путь найден, то он сохранён в way.
 //!
 //! \return >0 если путь найден
@@ -529,21 +1249,68 @@ bool Field::removeFromObstacle(Obstacle& obst, const QPoint& point) {
 //! \return -1 если старт/финиш не задан
 //!
 double Field::findPath() {
+    double len = searchPath();
+    record(QString("find %1").arg(len));
+    return len;
+}
+
+//!
+//! Поиск пути без записи в трассу (см. `Field::findPath`)
+//!
+double Field::searchPath() {
     way.clear();
+    alternatives.clear();
+    alternativeLengths.clear();
+    pathOptimal = true;
+    pathBound = 1.;
+    // Размер агента учитывается только на равномерной сетке
+    activeRadius = adaptiveMesh ? 0.f : agentRadius / cellSize;
     if (!start.has_value() || !end.has_value()) return -1;
-    MeshPoint* mstart = nearestMesh(*start);
-    MeshPoint* mend = nearestMesh(*end);
-    if (mstart == 0 || mend == 0) return -1;
-    if (mstart->walkness == 1. || mend->walkness == 1.) return 0;
-
-    double shortest = aStarPath(mstart, mend, way);
+    MeshPoint* cstart = nearestMesh(*start);
+    MeshPoint* cend = nearestMesh(*end);
+    if (cstart == 0 || cend == 0) return -1;
+    if (!connectivity.connected(cstart->meshCoord, cend->meshCoord)) {
+        qInfo() << "Field::find" << "Disconnected";
+        return 0;
+    }
 
-    if (shortest > 0) {
-        way = smoothv1Path(way);
-        std::reverse(way.begin(), way.end());
-        way = splicePath(way);
-        way = smoothv1Path(way);
+    double shortest;
+    if (!stops.isEmpty() && !adaptiveMesh) {
+        if (cstart->walkness == 1. || cend->walkness == 1.) return 0;
+        double len = tourPath(cstart, cend, way);
+        qInfo() << "Field::find" << "Tour" << stops.size() << len;
+        return len;
     }
+    if (adaptiveMesh) {
+        int qstart = quadtree.cellAt(*start);
+        int qend = quadtree.cellAt(*end);
+        if (qstart == -1 || qend == -1) return -1;
+        if (quadtree.cell(qstart).walkness == 1. || quadtree.cell(qend).walkness == 1.) return 0;
+        shortest = quadPath(*start, *end, way);
+    } else {
+        if (cstart->walkness == 1. || cend->walkness == 1.) return 0;
+        if (!clearance.passable(cstart->meshCoord, activeRadius) || !clearance.passable(cend->meshCoord, activeRadius)) {
+            qInfo() << "Field::find" << "No clearance for radius" << agentRadius;
+            return 0;
+        }
+        // Альтернативы отводятся от кратчайшего пути, который находит их же поиск, -- он и показывается
+        if (alternativeCount > 1) {
+            QVector<QVector<MeshPoint>> ways;
+            QVector<double> lengths = findAlternatives(alternativeCount, ways);
+            if (ways.isEmpty()) return 0;
+            way = ways[0];
+            for (int k = 1; k < ways.size(); k++) {
+                alternatives.append(ways[k]);
+                alternativeLengths.append(lengths[k]);
+            }
+            qInfo() << "Field::find" << lengths[0] << "Alternatives" << alternatives.size();
+            return lengths[0];
+        }
+        if (!hierarchy.isNull() && activeRadius <= 0.f) shortest = hierarchyPath(cstart, cend, way);
+        else shortest = searchDeadline > 0 ? anytimePath(cstart, cend, way) : aStarPath(cstart, cend, way);
+    }
+
+    if (shortest > 0) refinePath(way);
 
     double len = lengthPath(way);
     qInfo() << "Field::find" << len << shortest;
@@ -551,39 +1318,94 @@ double Field::findPath() {
 }
 
 //!
-//! Под-функция A* для обработки соседних клеток в сетке
-//! Если текущая позиция + смещение выходит за рамки карты, то функция завершается.
-//! Если соседняя позиция имеет непроходимость 1.0, то препятствие считается стеной и его необходимо обойти
+//! Найти несколько заметно разных путей от старта до финиша (см. `AlternativeRoutes`)
+//! Пути не длиннее кратчайшего на `AlternativeRoutes::defaultStretch` и делят с каждым предыдущим
+//! не больше `1 - alternativeDiversity` своей стоимости. Только для равномерной сетки
+//!
+//! \param count Сколько путей нужно
+//! \param ways Вектор для сохранения путей (первый -- кратчайший), каждый от финиша к старту, как `Field::findPath`
+//! \return Длины путей
+//!
+QVector<double> Field::findAlternatives(int count, QVector<QVector<MeshPoint>>& ways) {
+    QVector<double> lengths;
+    ways.clear();
+    if (!start.has_value() || !end.has_value() || adaptiveMesh) return lengths;
+    MeshPoint* cstart = nearestMesh(*start);
+    MeshPoint* cend = nearestMesh(*end);
+    if (cstart == 0 || cend == 0) return lengths;
+    if (!connectivity.connected(cstart->meshCoord, cend->meshCoord)) return lengths;
+    activeRadius = agentRadius / cellSize;
+
+    QSize dims = meshSize();
+    AlternativeRoutes routes(mesh, dims.width(), dims.height());
+    routes.setClearance(&clearance, activeRadius);
+    QVector<QVector<QPoint>> cells;
+    QVector<double> costs;
+    routes.find(cstart->meshCoord, cend->meshCoord, count, alternativeDiversity, AlternativeRoutes::defaultStretch, cells, costs);
+    for (const QVector<QPoint>& route : cells) {
+        QVector<MeshPoint> alt;
+        for (const QPoint& cell : route) alt.append(mesh[cell]);
+        refinePath(alt);
+        lengths.append(lengthPath(alt));
+        ways.append(alt);
+    }
+    qInfo() << "Field::findAlternatives" << lengths;
+    return lengths;
+}
+
+//!
+//! Длины альтернатив последнего найденного пути (без самого пути)
+//!
+const QVector<double>& Field::getAlternativeLengths() {
+    return alternativeLengths;
+}
+
+//!
+//! Обработка найденного пути: сглаживание и упрощение.
+//! Путь должен идти от старта к финишу.
+//! Сглаживание срезает углы по прямой видимости, вытягивание натягивает путь в коридоре клеток.
+//! Вытягивание повторяется `LineOfSight::pullPasses` раз, перед каждым повтором путь снова сглаживается: вершины
+//! натянутого пути лежат у углов препятствий, и из них видно дальше, чем из узлов сетки, а сглаживание может
+//! увести путь из коридора прошлого вытягивания. Сглаживание идёт на месте, вытягивание пишет в переиспользуемый
+//! буфер `refineBuffer`, так что в установившемся режиме память не выделяется
+//!
+//! \param way Путь
+//!
+void Field::refinePath(QVector<MeshPoint>& way) {
+    smoothPath(way);
+    std::reverse(way.begin(), way.end());
+    for (int pass = 0; pass < LineOfSight::pullPasses; pass++) {
+        if (pass > 0) smoothPath(way);
+        pullPath(way, refineBuffer);
+        way.swap(refineBuffer);
+    }
+}
+
+//!
+//! Эвристика A*: нижняя оценка стоимости пути между клетками сетки
+//! Берётся максимум из манхэттенского расстояния и оценки по ориентирам (ALT),
+//! если таблицы ориентиров построены для текущей сетки
 //!
-//! \param queue Приоритетная очередь
-//! \param origins Hash-карта показывающая, откуда проложен путь
-//! \param costs Hash-карта показывающая, какая минимальная стоимость нужна для достижения этой клетки в сетке
-//! \param current Указатель на текущую позицию в сетке
-//! \param finish Цель (финиш)
-//! \param offset Смещение по координатам
+//! \param from Клетка (координаты на сетке)
+//! \param to Цель (координаты на сетке)
+//! \return Оценка стоимости
 //!
-void Field::aStarN(
-    PriorityQueue<MeshPoint*, double>& queue,
-    QHash<QPoint, QPoint>& origins,
-    QHash<QPoint, double>& costs,
-    MeshPoint* current,
-    MeshPoint* finish,
-    QPoint offset
-    ) {
-    QPoint off = current->meshCoord + offset;
-    if (!mesh.contains(off)) return;
-    MeshPoint* neighbor = &mesh[off];
-    if (neighbor->walkness >= 1.) return;
-    double new_cost = costs[current->meshCoord] + vectorLength(offset) + neighbor->walkness;
-    if (!costs.contains(neighbor->meshCoord) || new_cost < costs[neighbor->meshCoord]) {
-        costs[neighbor->meshCoord] = new_cost;
-        origins[neighbor->meshCoord] = current->meshCoord;
-        queue.put(neighbor, new_cost + simpleDistance(neighbor->meshCoord, finish->meshCoord));
+double Field::heuristic(const QPoint& from, const QPoint& to) {
+    double h = simpleDistance(from, to);
+    if (!activeLandmarks.isNull()) {
+        int rows = activeLandmarks->rows;
+        h = qMax(h, (double)activeLandmarks->bound(from.x() * rows + from.y(), to.x() * rows + to.y()));
     }
+    return h;
 }
 
 //!
-//! Алгоритм поиска пути A*
+//! Алгоритм поиска пути A* (см. `GridSearch`)
+//! Стоимость шага -- 1 + непроходимость клетки, в которую выполняется шаг. Клетки с непроходимостью 1.0
+//! считаются стенами, клетки, где агент радиуса `agentRadius` не помещается между стенами (см. `ClearanceMap`), обходятся.
+//! Если задан бюджет памяти `searchBudget` и плотные таблицы на всю сетку в него не помещаются, поиск идёт
+//! по хэш-таблицам затронутых клеток; если перерастают бюджет и они, поиск идёт в режиме с ограничением памяти
+//! (`Field::boundedPath`)
 //!
 //! \param start Начальная точка
 //! \param finish Конечная точка
@@ -593,140 +1415,230 @@ void Field::aStarN(
 //!
 double Field::aStarPath(MeshPoint* start, MeshPoint* finish, QVector<MeshPoint>& way) {
     way.clear();
-    PriorityQueue<MeshPoint*, double> queue;
-    queue.put(start, 1.);
-
-    QHash<QPoint, QPoint> origins;
-    QHash<QPoint, double> costs;
-    origins[start->meshCoord] = start->meshCoord;
-    costs[start->meshCoord] = 1.;
-    
-    while (!queue.empty()) {
-        MeshPoint* current = queue.get();
-        if (current == finish) break;
-        
-        if ((current->meshCoord.x() + current->meshCoord.y()) % 2 == 0) {
-            aStarN(queue, origins, costs, current, finish, QPoint(0, 1));
-            aStarN(queue, origins, costs, current, finish, QPoint(0, -1));
-            aStarN(queue, origins, costs, current, finish, QPoint(-1, 0));
-            aStarN(queue, origins, costs, current, finish, QPoint(1, 0));
-        } else {
-            aStarN(queue, origins, costs, current, finish, QPoint(1, 0));
-            aStarN(queue, origins, costs, current, finish, QPoint(-1, 0));
-            aStarN(queue, origins, costs, current, finish, QPoint(0, -1));
-            aStarN(queue, origins, costs, current, finish, QPoint(0, 1));
-        }
+    activeLandmarks = landmarks.tables(meshRevision);
+    GridSearch search(cells, [this](const QPoint& from, const QPoint& to) { return heuristic(from, to); }, searchBudget);
+    search.setClearance(&clearance, activeRadius);
+    QVector<QPoint> route;
+    double cost = search.find(start->meshCoord, finish->meshCoord, route);
+    if (search.exceeded()) {
+        qInfo() << "Field::astar" << "Budget exceeded after" << search.expanded() << "expansions";
+        return boundedPath(start, finish, way);
     }
 
-    QPoint current = finish->meshCoord;
-    if (!origins.contains(current)) return 0;
-    double cost = costs[finish->meshCoord];
-    while (current != start->meshCoord) {
-        MeshPoint meshp = mesh[current];
-        way.append(meshp);
-        current = origins[current];
-    }
-    way.append(*start);
-    std::reverse(way.begin(), way.end());
+    qInfo() << "Field::astar" << "Expanded" << search.expanded() << (activeLandmarks.isNull() ? "(manhattan)" : "(landmarks)");
+    for (const QPoint& cell : route) way.append(mesh[cell]);
     return cost;
 }
 
 //!
-//! Сглаживание пути
-//! Сглаживание пути быстрым методом линейного прохода
+//! Поиск пути с ограничением памяти `searchBudget` (см. `FrontierSearch`)
 //!
-//! \param vec Путь, который необходимо сгладить.
+//! \param start Начальная точка
+//! \param finish Конечная точка
+//! \param way Вектор для сохранения пути
+//! \return Длина пути, если путь найден
+//! \return 0, если путь не найден
 //!
-QVector<MeshPoint> Field::smoothv1Path(const QVector<MeshPoint>& vec) {
-    if (vec.length() < 1) return vec;
-    QVector <MeshPoint> finalVec;
-    int curr = 0;
-    int vec_size = vec.length();
-
-    finalVec.append(vec[curr]);
-    for (int i = 1; i < vec_size; ++i) {
-        QLine line(vec[curr].realCoord, vec[i].realCoord);
-        for (int j = 0; j < obstacles.length(); ++j) {
-            if (consistentIntersectPath(line, obstacles[j])) {
-                finalVec.append(vec[i-1]);
-                curr = i-1;
-                break;
-            }
-        }
+double Field::boundedPath(MeshPoint* start, MeshPoint* finish, QVector<MeshPoint>& way) {
+    QSize dims = meshSize();
+    FrontierSearch search(mesh, dims.width(), dims.height(), [this](const QPoint& from, const QPoint& to) { return heuristic(from, to); }, searchBudget);
+    search.setClearance(&clearance, activeRadius);
+    QVector<QPoint> cells;
+    double cost = search.find(start->meshCoord, finish->meshCoord, cells);
+    pathOptimal = search.optimal();
+    way.clear();
+    for (const QPoint& cell : cells) way.append(mesh[cell]);
+    return cost;
+}
+
+//!
+//! Поиск пути к дедлайну `searchDeadline` (см. `AnytimeSearch`)
+//! Возвращает лучший путь, найденный за отведённое время, и запоминает его гарантию в `pathBound`
+//!
+//! \param start Начальная точка
+//! \param finish Конечная точка
+//! \param way Вектор для сохранения пути
+//! \return Длина пути, если путь найден
+//! \return 0, если путь не найден
+//!
+double Field::anytimePath(MeshPoint* start, MeshPoint* finish, QVector<MeshPoint>& way) {
+    activeLandmarks = landmarks.tables(meshRevision);
+    QSize dims = meshSize();
+    AnytimeSearch search(mesh, dims.width(), dims.height(), [this](const QPoint& from, const QPoint& to) { return heuristic(from, to); });
+    search.setClearance(&clearance, activeRadius);
+    QVector<QPoint> cells;
+    double cost = search.find(start->meshCoord, finish->meshCoord, searchDeadline, cells);
+    pathBound = search.bound();
+    pathOptimal = pathBound <= 1.;
+    way.clear();
+    for (const QPoint& cell : cells) way.append(mesh[cell]);
+    return cost;
+}
+
+//!
+//! Поиск пути по иерархии сжатия (см. `ContractionHierarchy`)
+//! Путь кратчайший, как у A*, но просматриваются только сотни клеток
+//!
+//! \param start Начальная точка
+//! \param finish Конечная точка
+//! \param way Вектор для сохранения пути
+//! \return Длина пути, если путь найден
+//! \return 0, если путь не найден
+//!
+double Field::hierarchyPath(MeshPoint* start, MeshPoint* finish, QVector<MeshPoint>& way) {
+    QElapsedTimer timer;
+    timer.start();
+    int rows = meshSize().height();
+    QVector<int> cells;
+    float cost = hierarchy->query(start->meshCoord.x() * rows + start->meshCoord.y(), finish->meshCoord.x() * rows + finish->meshCoord.y(), cells);
+    qInfo() << "Field::hierarchy" << "Path" << cells.size() << "in" << timer.nsecsElapsed() / 1000 << "us";
+    way.clear();
+    if (cost < 0) return 0;
+    for (int cell : cells) way.append(mesh[QPoint(cell / rows, cell % rows)]);
+    // Стоимость считается от 1, как в `Field::aStarPath`
+    return cost + 1.;
+}
+
+//!
+//! Поиск пути через промежуточные остановки `stops` (см. `TourPlanner`)
+//! Отрезки между остановками сглаживаются по отдельности, чтобы вытягивание не срезало остановку,
+//! и сшиваются в один путь
+//!
+//! \param start Начальная точка
+//! \param finish Конечная точка
+//! \param way Вектор для сохранения пути (от финиша к старту, как после `Field::refinePath`)
+//! \return Длина сглаженного пути, если путь найден
+//! \return 0, если какую-то остановку нельзя посетить
+//!
+double Field::tourPath(MeshPoint* start, MeshPoint* finish, QVector<MeshPoint>& way) {
+    way.clear();
+    QVector<QPoint> cells = { start->meshCoord };
+    for (const QPoint& stop : stops) {
+        MeshPoint* cell = nearestMesh(stop);
+        if (cell == 0 || !connectivity.connected(start->meshCoord, cell->meshCoord)) return 0;
+        cells.append(cell->meshCoord);
+    }
+    cells.append(finish->meshCoord);
+
+    QSize dims = meshSize();
+    TourPlanner planner(mesh, dims.width(), dims.height());
+    planner.setClearance(&clearance, activeRadius);
+    if (!planner.measure(cells)) return 0;
+    QVector<int> order = planner.order();
+    if (order.isEmpty()) return 0;
+    qInfo() << "Field::tour" << "Order" << order << "cost" << planner.tourCost(order);
+
+    // Отрезки идут с конца: каждый после сглаживания развёрнут от своего финиша к своему старту
+    for (int k = order.size() - 1; k > 0; k--) {
+        QVector<MeshPoint> leg;
+        for (const QPoint& cell : planner.leg(order[k - 1], order[k])) leg.append(mesh[cell]);
+        refinePath(leg);
+        if (!way.isEmpty() && !leg.isEmpty()) leg.removeFirst();
+        way += leg;
     }
-    finalVec.append(vec[vec.length() - 1]);
-    return finalVec;
+    return lengthPath(way);
 }
 
 //!
-//! Сглаживание пути
-//! Сглаживание пути итеративным подходом упрощения
+//! Последний найденный путь кратчайший
+//! Может быть ложно, только если поиск упёрся в бюджет памяти и ему пришлось отбросить часть открытого списка
 //!
-//! \param vec Путь, который необходимо сгладить.
+bool Field::isPathOptimal() {
+    return pathOptimal;
+}
+
 //!
-QVector<MeshPoint> Field::smoothv2Path(const QVector<MeshPoint>& vec, int maxSteps) {
-    if (vec.length() < 2) return vec;
-    QVector <MeshPoint> reduced(vec);
-    QVector <MeshPoint> ignorance;
-
-    for (int it = 0; it < maxSteps && reduced.length() > 2; it++) {
-        QVector<MeshPoint> next;
-        next.append(reduced[0]);
-        int i = 1;
-        while (i < reduced.length()-1) {
-            if (ignorance.contains(reduced[i])) {
-                next.append(reduced[i]);
-                i += 1;
-                continue;
-            }
-            QLine line(reduced[i-1].realCoord, reduced[i+1].realCoord);
-            bool inter = false;
-            for (Obstacle& obst : obstacles) {
-                if (lineIntersectsPolygon(line, obst.poly)) {
-                    inter = true;
-                    break;
-                }
-            }
+//! Гарантия последнего найденного пути: он не длиннее кратчайшего, умноженного на это число
+//! (1 -- путь кратчайший; при урезании по бюджету памяти гарантии нет, см. `Field::isPathOptimal`)
+//!
+double Field::getPathBound() {
+    return pathBound;
+}
+
+//!
+//! Алгоритм поиска пути A* по графу смежности квадродерева.
+//! Узлы графа -- листья; переход в соседний лист стоит расстояние между их центрами (в ячейках сетки),
+//! умноженное на (1 + непроходимость соседа). В листьях старта и финиша вместо центра берутся сами точки
+//!
+//! \param start Начальная точка
+//! \param finish Конечная точка
+//! \param way Вектор для сохранения пути
+//! \return Длина пути, если путь найден
+//! \return 0, если путь не найден
+//!
+double Field::quadPath(const QPoint& start, const QPoint& finish, QVector<MeshPoint>& way) {
+    way.clear();
+    int qstart = quadtree.cellAt(start);
+    int qfinish = quadtree.cellAt(finish);
+    if (qstart == -1 || qfinish == -1) return 0;
+    if (qstart == qfinish) {
+        way.append(MeshPoint(QPoint(start.x() / cellSize, start.y() / cellSize), start, quadtree.cell(qstart).walkness));
+        way.append(MeshPoint(QPoint(finish.x() / cellSize, finish.y() / cellSize), finish, quadtree.cell(qfinish).walkness));
+        return 1. + euclideanDistance(start, finish) / cellSize;
+    }
+
+    auto position = [&](int idx) {
+        if (idx == qstart) return start;
+        if (idx == qfinish) return finish;
+        return quadtree.cell(idx).rect.center();
+    };
+
+    PriorityQueue<int, double> queue;
+    QVector<int> origins(quadtree.count(), -1);
+    QVector<double> costs(quadtree.count(), -1.);
+    queue.put(qstart, 1.);
+    origins[qstart] = qstart;
+    costs[qstart] = 1.;
 
-            if (inter) {
-                next.append(reduced[i]);
-                ignorance.append(reduced[i]);
-                i += 1;
-            } else {
-                next.append(reduced[i+1]);
-                i += 2;
+    while (!queue.empty()) {
+        int current = queue.get();
+        if (current == qfinish) break;
+        QPoint from = position(current);
+
+        for (int next : quadtree.cell(current).neighbors) {
+            const QuadCell& neighbor = quadtree.cell(next);
+            if (neighbor.walkness >= 1.) continue;
+            QPoint to = position(next);
+            double step = euclideanDistance(from, to) / cellSize;
+            double new_cost = costs[current] + step * (1. + neighbor.walkness);
+            if (costs[next] < 0 || new_cost < costs[next]) {
+                costs[next] = new_cost;
+                origins[next] = current;
+                queue.put(next, new_cost + euclideanDistance(to, finish) / cellSize);
             }
         }
-        next.append(reduced[reduced.length()-1]);
-        reduced = next;
     }
 
-    return reduced;
+    if (origins[qfinish] == -1) return 0;
+    int current = qfinish;
+    while (current != qstart) {
+        const QuadCell& cell = quadtree.cell(current);
+        QPoint pos = position(current);
+        way.append(MeshPoint(QPoint(pos.x() / cellSize, pos.y() / cellSize), pos, cell.walkness));
+        current = origins[current];
+    }
+    way.append(MeshPoint(QPoint(start.x() / cellSize, start.y() / cellSize), start, quadtree.cell(qstart).walkness));
+    std::reverse(way.begin(), way.end());
+    return costs[qfinish];
 }
 
 //!
-//! Разделение пути
-//! Разделить линии путя на точки с заданным интервалом
+//! Сглаживание пути на месте (см. `LineOfSight::smooth`)
+//!
+//! \param vec Путь, который необходимо сгладить.
+//!
+void Field::smoothPath(QVector<MeshPoint>& vec) {
+    sight.smooth(vec, activeRadius);
+}
+
+//!
+//! Вытягивание пути (см. `LineOfSight::pull`)
 //!
 //! \param vec Путь
-//! \param interval Интервал разбиения точек на линии (в пикселях).
+//! \param result Вектор для сохранения пути
 //!
-QVector<MeshPoint> Field::splicePath(const QVector<MeshPoint>& vec, int interval) {
-    QVector<MeshPoint> result;
-    for (int i = 1; i < vec.length(); i++) {
-        QLine formed(vec[i-1].realCoord, vec[i].realCoord);
-        double dist = euclideanDistance(formed.p1(), formed.p2());
-        double dx = formed.dx() / dist;
-        double dy = formed.dy() / dist;
-        for (int j = 0; j < dist; j += interval) {
-            QPoint init = formed.p1();
-            QPoint rp = QPoint(init.x() + dx * j, init.y() + dy * j);
-            MeshPoint mp = MeshPoint(QPoint(-1, -1), rp, 0);
-            result.append(mp);
-        }
-        result.append(vec[i]);
-    }
-    return result;
+void Field::pullPath(const QVector<MeshPoint>& vec, QVector<MeshPoint>& result) {
+    sight.pull(vec, result);
 }
 
 //!
@@ -749,22 +1661,6 @@ double Field::lengthPath() {
     return lengthPath(way);
 }
 
-//!
-//! Проверка на пересечение линии и полигона с учётом фактора непроходимости
-//!
-//! \param line Линия
-//! \param obst Препятствие
-//! \return Успех или нет
-//!
-bool Field::consistentIntersectPath(const QLine& line, const Obstacle& obst) {
-    double w1 = getFactorMap(line.p1());
-    double w2 = getFactorMap(line.p2());
-    if (w1 != obst.walkness && w2 != obst.walkness) return lineIntersectsPolygon(line, obst.poly);
-    else if (w1 == obst.walkness && w2 == obst.walkness) return false;
-    // else return true;
-    else return lineIntersectsPolygon(line, obst.poly);
-}
-
 //!
 //! Получить количество препятствий на карте
 //!
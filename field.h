@@ -3,6 +3,7 @@
 
 #include <QVector>
 #include <QPainter>
+#include <QImage>
 #include <QString>
 #include <QFile>
 #include <QDebug>
@@ -10,6 +11,26 @@
 #include "obstacle.h"
 #include "meshpoint.h"
 #include "prioqueue.h"
+#include "quadtree.h"
+#include "flowfield.h"
+#include "multiagent.h"
+#include "connectivity.h"
+#include "landmarks.h"
+#include "lineofsight.h"
+#include "geometry.h"
+#include "mapsnapshot.h"
+#include "tracerecorder.h"
+#include "mapjournal.h"
+#include "maploader.h"
+#include "sweepline.h"
+#include "frontiersearch.h"
+#include "anytimesearch.h"
+#include "gridsearch.h"
+#include "clearance.h"
+#include "cellgrid.h"
+#include "hierarchy.h"
+#include "alternatives.h"
+#include "tourplanner.h"
 
 typedef std::optional<QPoint> Waypoint;
 
@@ -30,6 +51,14 @@ public:
 
     static constexpr QColor fillStart = QColor(56, 186, 112);
     static constexpr QColor fillEnd = QColor(204, 103, 59);
+    static constexpr QColor fillStop = QColor(230, 190, 40);
+
+    static constexpr QColor agentPath = QColor(140, 62, 196);
+    static constexpr QColor previewPath = QColor(24, 117, 219, 110);
+    static constexpr QColor alternativePath = QColor(46, 139, 87);
+    static constexpr QColor otherAlternativePath = QColor(214, 137, 16);
+
+    static constexpr QColor crossing = QColor(220, 20, 60);
 
     static constexpr int minWidth = 100;
     static constexpr int maxWidth = 2000;
@@ -41,26 +70,51 @@ public:
     static constexpr float pathWidth = 2.4f;
 
     static constexpr double pointGrabRadius = 6.;
+    static constexpr double stopGrabRadius = 8.;
+
+    static constexpr int bandsPerThread = 4;
 
     bool dGrid = false;
     bool dGridOutline = false;
     bool dNoObstacles = false;
     bool dNoPath = false;
     int cellSize = 2;
+    bool adaptiveMesh = false;
+    CellGrid::Layout cellLayout = CellGrid::LINEAR;
+    qint64 searchBudget = 0;
+    int searchDeadline = 0;
+    double agentRadius = 0.;
+    int alternativeCount = 1;
+    double alternativeDiversity = 0.3;
+    bool hierarchyNearMap = true;
 
     Field(unsigned w, unsigned h);
     ~Field();
     void draw(QPainter* painter);
+    static void drawObstacle(QPainter* painter, const Obstacle& obst);
+    void setLiveObstacle(int idx);
 
     int loadMap(const QString& path);
+    void installMap(const QString& path, const MapDocument& doc);
     int saveMap(const QString& path);
     void resizeMap(unsigned width, unsigned heigh, bool noRegen = false);
     bool inMap(const QPoint& point);
     double getFactorMap(const QPoint& point);
 
-    void regenMesh();
+    void regenMesh(const QVector<double>& precomputed = QVector<double>());
     MeshPoint* nearestMesh(const QPoint& point);
     MeshPoint* getMesh(const QPoint& point);
+    QSize meshSize();
+    QVector<double> rasterize(const QRect& cells) const;
+    QSharedPointer<const MapSnapshot> snapshot();
+    void setTrace(TraceRecorder* recorder);
+    bool applyEdit(const QString& operation);
+    void waitLandmarks();
+    MapStore& getStore();
+    qint64 buildHierarchy();
+    bool hasHierarchy();
+    int loadHierarchy(const QString& path);
+    int saveHierarchy(const QString& path);
 
     void setStart(QPoint point);
     void setEnd(QPoint point);
@@ -68,25 +122,49 @@ public:
     void unsetEnd();
     Waypoint getStart();
     Waypoint getEnd();
+    void addStop(QPoint point);
+    bool removeStop(const QPoint& point);
+    void clearStops();
+    const QVector<QPoint>& getStops();
+
+    QVector<Agent>& getAgents();
+    qint64 planAgents();
+    qint64 routeAgents();
 
     Obstacle* getObstacle(const QPoint& point);
     QVector<Obstacle>& getObstacles();
+    unsigned getObstacleRevision();
+    void addObstacle(const Obstacle& obst);
     bool removeObstacle(const QPoint& point);
     bool removeObstacle(const Obstacle& obstacle);
     bool removeFromObstacle(const QPoint& point);
     bool removeFromObstacle(Obstacle& obst, const QPoint& point);
     bool addToObstacle(const QPoint& point);
     bool addToObstacle(Obstacle& obst, const QPoint& point);
+    bool moveVertex(int obstacle, int vertex, const QPoint& point);
+    const EdgeBatch& obstacleEdges(int idx);
+    bool intersectsObstacles(const QPolygon& poly, int except = -1);
+    int validateObstacles();
+    const QVector<EdgeCrossing>& getCrossings();
 
     double findPath();
-    void aStarN(PriorityQueue<MeshPoint*, double>& queue, QHash<QPoint, QPoint>& origins, QHash<QPoint, double>& costs, MeshPoint* current, MeshPoint* finish, QPoint offset);
+    double searchPath();
     double aStarPath(MeshPoint* start, MeshPoint* finish, QVector<MeshPoint>& way);
-    QVector<MeshPoint> smoothv1Path(const QVector<MeshPoint>& vec);
-    QVector<MeshPoint> smoothv2Path(const QVector<MeshPoint>& vec, int maxSteps = 16);
-    QVector<MeshPoint> splicePath(const QVector<MeshPoint>& vec, int interval = 2);
+    double boundedPath(MeshPoint* start, MeshPoint* finish, QVector<MeshPoint>& way);
+    double anytimePath(MeshPoint* start, MeshPoint* finish, QVector<MeshPoint>& way);
+    double hierarchyPath(MeshPoint* start, MeshPoint* finish, QVector<MeshPoint>& way);
+    double tourPath(MeshPoint* start, MeshPoint* finish, QVector<MeshPoint>& way);
+    bool isPathOptimal();
+    double getPathBound();
+    double heuristic(const QPoint& from, const QPoint& to);
+    double quadPath(const QPoint& start, const QPoint& finish, QVector<MeshPoint>& way);
+    QVector<double> findAlternatives(int count, QVector<QVector<MeshPoint>>& ways);
+    const QVector<double>& getAlternativeLengths();
+    void refinePath(QVector<MeshPoint>& way);
+    void smoothPath(QVector<MeshPoint>& vec);
+    void pullPath(const QVector<MeshPoint>& vec, QVector<MeshPoint>& result);
     double lengthPath(const QVector<MeshPoint>& vec);
     double lengthPath();
-    bool consistentIntersectPath(const QLine& line, const Obstacle& obst);
 
     QSize size();
     unsigned polyCount();
@@ -95,13 +173,49 @@ protected:
     unsigned width, height;
 
     Waypoint start, end;
+    QVector<QPoint> stops;
     QVector<Obstacle> obstacles;
+    QVector<EdgeBatch> edges;
+    QVector<EdgeCrossing> crossings;
     QVector<MeshPoint> way;
+    QVector<MeshPoint> refineBuffer;
+    QVector<QVector<MeshPoint>> alternatives;
+    QVector<double> alternativeLengths;
+    QVector<Agent> agents;
     QHash<QPoint, MeshPoint> mesh;
+    CellGrid cells;
+    QuadTree quadtree;
+    QHash<QPoint, FlowField> flows;
+    Connectivity connectivity;
+    Landmarks landmarks;
+    LineOfSight sight;
+    ClearanceMap clearance;
+    QSharedPointer<const LandmarkTables> activeLandmarks;
+    QSharedPointer<const ContractionHierarchy> hierarchy;
+    unsigned meshRevision = 0;
+    unsigned obstacleRevision = 0;
+    int liveObstacle = -1;
+    QImage gridLayer, obstacleLayer;
+    quint64 gridKey = 0, obstacleKey = 0;
+    bool pathOptimal = true;
+    double pathBound = 1.;
+    float activeRadius = 0.f;
+    MapStore store;
+    TraceRecorder* trace = 0;
+    MapJournal journal;
+    bool muted = false;
 
-    QPolygon* dragPoly = 0;
-    QPoint* dragPoint = 0;
     QPolygon* drawPoly = 0;
+
+    bool updateLayer(QImage& layer, quint64& key, quint64 wanted, qreal ratio);
+    void renderGridLayer(QImage& layer);
+    void renderObstacleLayer(QImage& layer);
+    void rasterizeCells(double* factors, int stride, const QRect& cells) const;
+    QVector<double> meshFactors();
+    void publishHierarchy();
+    void saveHierarchyNear(const QString& path);
+    void record(const QString& operation);
+    void recordState();
 };
 
 #endif // FIELD_H
@@ -0,0 +1,150 @@
+//!
+//! Поле стоимостей до цели (flow field).
+//! Один проход алгоритма Дейкстры от финиша считает стоимость пути до финиша из каждой клетки сетки,
+//! после чего путь из любой точки находится спуском по градиенту за O(длины пути)
+//!
+
+#include "flowfield.h"
+#include "prioqueue.h"
+
+static const QPoint evenOffsets[4] = { QPoint(0, 1), QPoint(0, -1), QPoint(-1, 0), QPoint(1, 0) };
+static const QPoint oddOffsets[4] = { QPoint(1, 0), QPoint(-1, 0), QPoint(0, -1), QPoint(0, 1) };
+
+//!
+//! Учитывать размер агента: клетки, где агент радиуса radius не помещается, считаются стенами
+//! Задаётся до `FlowField::build`
+//!
+//! \param map Карта расстояний до стен (0 -- не учитывать)
+//! \param radius Радиус агента в клетках сетки
+//!
+void FlowField::setClearance(const ClearanceMap* map, float radius) {
+    clearance = map;
+    this->radius = radius;
+}
+
+//!
+//! Построить поле стоимостей до цели
+//! Стоимость шага совпадает с `Field::aStarPath`: 1 + непроходимость клетки, в которую выполняется шаг.
+//! Как и в `Field::aStarPath`, стоимость самой цели равна 1
+//!
+//! \param mesh Сетка
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//! \param cellSize Размер ячейки сетки
+//! \param goal Цель (координаты на сетке)
+//! \param revision Ревизия сетки, для которой строится поле
+//!
+void FlowField::build(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, int cellSize, const QPoint& goal, unsigned revision) {
+    this->cols = cols;
+    this->rows = rows;
+    this->cellSize = cellSize;
+    this->goal = goal;
+    this->revision = revision;
+    ready = true;
+
+    walkness.fill(1., cols * rows);
+    costs.fill(-1., cols * rows);
+    for (auto it = mesh.constBegin(); it != mesh.constEnd(); ++it) {
+        if (inField(it.key())) walkness[index(it.key())] = it.value().walkness;
+    }
+    if (!inField(goal) || walkness[index(goal)] >= 1.) return;
+    if (clearance != 0 && !clearance->passable(index(goal), radius)) return;
+
+    PriorityQueue<int, double> queue;
+    costs[index(goal)] = 1.;
+    queue.put(index(goal), 1.);
+
+    while (!queue.empty()) {
+        int ci = queue.get();
+        QPoint current(ci / rows, ci % rows);
+        double stepCost = costs[ci] + 1. + walkness[ci];
+
+        for (const QPoint& offset : evenOffsets) {
+            QPoint next = current + offset;
+            if (!inField(next)) continue;
+            int ni = index(next);
+            if (walkness[ni] >= 1.) continue;
+            if (clearance != 0 && !clearance->passable(ni, radius)) continue;
+            if (costs[ni] < 0 || stepCost < costs[ni]) {
+                costs[ni] = stepCost;
+                queue.put(ni, stepCost);
+            }
+        }
+    }
+}
+
+//!
+//! Сбросить поле
+//!
+void FlowField::clear() {
+    ready = false;
+    walkness.clear();
+    costs.clear();
+}
+
+//!
+//! Проверить, построено ли поле для данной цели, ревизии сетки и радиуса агента
+//!
+//! \param goal Цель (координаты на сетке)
+//! \param revision Ревизия сетки
+//! \param radius Радиус агента в клетках сетки
+//! \return Актуально поле или нет
+//!
+bool FlowField::valid(const QPoint& goal, unsigned revision, float radius) const {
+    return ready && this->goal == goal && this->revision == revision && this->radius == radius;
+}
+
+//!
+//! Стоимость пути из клетки до цели
+//!
+//! \param meshCoord Координаты на сетке
+//! \return Стоимость или -1 если цель недостижима
+//!
+double FlowField::cost(const QPoint& meshCoord) const {
+    if (!ready || !inField(meshCoord)) return -1.;
+    return costs[index(meshCoord)];
+}
+
+//!
+//! Спуск по градиенту поля от клетки до цели
+//! На каждом шаге выбирается соседняя клетка с наименьшей стоимостью
+//!
+//! \param from Начальная клетка (координаты на сетке)
+//! \param way Вектор для сохранения пути
+//! \return Стоимость пути, если путь найден
+//! \return 0, если цель недостижима
+//!
+double FlowField::descend(const QPoint& from, QVector<MeshPoint>& way) const {
+    way.clear();
+    double total = cost(from);
+    if (total < 0) return 0;
+
+    QPoint current = from;
+    way.append(MeshPoint(current, current * cellSize, walkness[index(current)]));
+    while (current != goal) {
+        const QPoint* offsets = (current.x() + current.y()) % 2 == 0 ? evenOffsets : oddOffsets;
+        QPoint best = current;
+        double bestCost = costs[index(current)];
+        for (int i = 0; i < 4; i++) {
+            QPoint next = current + offsets[i];
+            if (!inField(next)) continue;
+            double c = costs[index(next)];
+            if (c >= 0 && c < bestCost) {
+                best = next;
+                bestCost = c;
+            }
+        }
+        if (best == current) return 0;
+        current = best;
+        way.append(MeshPoint(current, current * cellSize, walkness[index(current)]));
+    }
+    return total;
+}
+
+bool FlowField::inField(const QPoint& meshCoord) const {
+    return meshCoord.x() >= 0 && meshCoord.y() >= 0 && meshCoord.x() < cols && meshCoord.y() < rows;
+}
+
+int FlowField::index(const QPoint& meshCoord) const {
+    return meshCoord.x() * rows + meshCoord.y();
+}
@@ -0,0 +1,36 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <QVector>
+#include <QHash>
+#include <QPoint>
+#include "meshpoint.h"
+#include "clearance.h"
+
+class FlowField {
+public:
+    void setClearance(const ClearanceMap* map, float radius);
+    void build(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, int cellSize, const QPoint& goal, unsigned revision);
+    void clear();
+    bool valid(const QPoint& goal, unsigned revision, float radius = 0.f) const;
+
+    double cost(const QPoint& meshCoord) const;
+    double descend(const QPoint& from, QVector<MeshPoint>& way) const;
+
+protected:
+    bool ready = false;
+    unsigned revision = 0;
+    QPoint goal;
+    int cols = 0, rows = 0;
+    int cellSize = 1;
+    const ClearanceMap* clearance = 0;
+    float radius = 0.f;
+
+    QVector<double> walkness;
+    QVector<double> costs;
+
+    bool inField(const QPoint& meshCoord) const;
+    int index(const QPoint& meshCoord) const;
+};
+
+#endif // FLOWFIELD_H
@@ -0,0 +1,217 @@
+//!
+//! Поиск пути с ограничением памяти.
+//! Фронтальный A* (frontier search): хранится только открытый список, закрытые клетки забываются.
+//! Чтобы не порождать закрытые клетки повторно, каждая открытая клетка помнит, из каких соседей
+//! её уже раскрывали, и в их сторону не ходит. Эвристика согласованная, поэтому оптимальность A* сохраняется.
+//! Без закрытого списка путь нельзя восстановить по предкам, поэтому каждая клетка несёт «опорную»
+//! клетку -- первую на своём пути, где пройденная стоимость не меньше оценки остатка (примерно середина пути).
+//! Найденная опорная клетка делит задачу на две, которые решаются так же (divide and conquer).
+//! Если не помещается даже открытый список, худшие по f клетки отбрасываются -- путь
+//! тогда может оказаться не кратчайшим или не найтись, это отражается в `FrontierSearch::optimal`
+//!
+
+#include <algorithm>
+#include <QDebug>
+#include "frontiersearch.h"
+
+static const QPoint directions[4] = { QPoint(0, 1), QPoint(0, -1), QPoint(-1, 0), QPoint(1, 0) };
+static const int opposite[4] = { 1, 0, 3, 2 };
+// Тот же порядок соседей, что и в `Field::aStarPath`
+static const int evenOrder[4] = { 0, 1, 2, 3 };
+static const int oddOrder[4] = { 3, 2, 1, 0 };
+
+//!
+//! \param mesh Сетка
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//! \param heuristic Согласованная эвристика (как `Field::heuristic`)
+//! \param budget Бюджет памяти в байтах (0 -- без ограничения)
+//!
+FrontierSearch::FrontierSearch(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, const Heuristic& heuristic, qint64 budget)
+    : mesh(mesh), cols(cols), rows(rows), heuristic(heuristic), budget(budget) {
+}
+
+//!
+//! Учитывать размер агента: клетки, где агент радиуса radius не помещается, считаются стенами
+//!
+//! \param map Карта расстояний до стен (0 -- не учитывать)
+//! \param radius Радиус агента в клетках сетки
+//!
+void FrontierSearch::setClearance(const ClearanceMap* map, float radius) {
+    clearance = map;
+    this->radius = radius;
+}
+
+//!
+//! Найти путь
+//! Стоимость считается так же, как в `Field::aStarPath`: старт стоит 1, шаг -- 1 + непроходимость клетки
+//!
+//! \param start Начальная клетка (координаты на сетке)
+//! \param finish Конечная клетка (координаты на сетке)
+//! \param cells Вектор для сохранения клеток пути от старта к финишу
+//! \return Стоимость пути, если путь найден
+//! \return 0, если путь не найден
+//!
+double FrontierSearch::find(const QPoint& start, const QPoint& finish, QVector<QPoint>& cells) {
+    cells.clear();
+    exact = true;
+    peakBytes = 0;
+    expansions = 0;
+    int from = start.x() * rows + start.y();
+    int to = finish.x() * rows + finish.y();
+    if (walkness(from) >= 1. || walkness(to) >= 1.) return 0;
+
+    cells.append(start);
+    double cost = solve(from, to, cells);
+    qInfo() << "FrontierSearch::find" << "Expanded" << expansions << "Peak" << peakBytes << "bytes" << (exact ? "(optimal)" : "(pruned)");
+    if (cost < 0) {
+        cells.clear();
+        return 0;
+    }
+    return 1. + cost;
+}
+
+//!
+//! Путь кратчайший: открытый список ни разу не урезался
+//!
+bool FrontierSearch::optimal() const {
+    return exact;
+}
+
+//!
+//! Наибольший объём памяти поиска за последний запрос (оценка в байтах)
+//!
+qint64 FrontierSearch::peak() const {
+    return peakBytes;
+}
+
+//!
+//! Восстановить путь между клетками делением пополам по опорным клеткам
+//!
+//! \param from Начальная клетка
+//! \param to Конечная клетка
+//! \param cells Вектор, в который дописываются клетки после from до to включительно
+//! \return Стоимость участка (без стоимости from) или -1 если путь не найден
+//!
+double FrontierSearch::solve(int from, int to, QVector<QPoint>& cells) {
+    if (from == to) return 0.;
+    QPoint a = coord(from), b = coord(to);
+    if (qAbs(a.x() - b.x()) + qAbs(a.y() - b.y()) == 1) {
+        // Любой обход соседней клетки длиннее минимум на два шага
+        cells.append(b);
+        return 1. + walkness(to);
+    }
+
+    int relay = -1;
+    if (search(from, to, relay) < 0) return -1.;
+    if (relay == from || relay == to || relay == -1) return -1.;
+    double head = solve(from, relay, cells);
+    if (head < 0) return -1.;
+    double tail = solve(relay, to, cells);
+    if (tail < 0) return -1.;
+    return head + tail;
+}
+
+//!
+//! Фронтальный A* между двумя клетками
+//!
+//! \param from Начальная клетка
+//! \param to Конечная клетка
+//! \param relay Опорная клетка найденного пути (строго между from и to, если они не соседи)
+//! \return Стоимость пути (без стоимости from) или -1 если путь не найден
+//!
+double FrontierSearch::search(int from, int to, int& relay) {
+    QHash<int, Node> open;
+    PriorityQueue<int, double> queue;
+    QPoint target = coord(to);
+    open.insert(from, Node());
+    queue.put(from, heuristic(coord(from), target));
+    qint64 limit = 4LL * cols * rows;
+    qint64 expanded = 0;
+
+    while (!queue.empty()) {
+        int ci = queue.get();
+        auto it = open.find(ci);
+        // Устаревшая запись очереди: клетку уже раскрыли с меньшей стоимостью
+        if (it == open.end()) continue;
+        Node node = *it;
+        open.erase(it);
+
+        if (ci == to) {
+            relay = node.relay == -1 || node.relay == to ? node.parent : node.relay;
+            return node.g;
+        }
+        if (++expanded > limit) break;
+        expansions++;
+
+        QPoint current = coord(ci);
+        const int* order = (current.x() + current.y()) % 2 == 0 ? evenOrder : oddOrder;
+        for (int k = 0; k < 4; k++) {
+            int d = order[k];
+            if (node.used & (1 << d)) continue;
+            QPoint next = current + directions[d];
+            if (next.x() < 0 || next.y() < 0 || next.x() >= cols || next.y() >= rows) continue;
+            int ni = next.x() * rows + next.y();
+            double w = walkness(ni);
+            if (w >= 1.) continue;
+
+            double g = node.g + 1. + w;
+            double h = heuristic(next, target);
+            int nextRelay = node.relay != -1 ? node.relay : (g >= h ? ni : -1);
+            auto found = open.find(ni);
+            if (found == open.end()) {
+                Node child;
+                child.g = g;
+                child.parent = ci;
+                child.relay = nextRelay;
+                child.used = 1 << opposite[d];
+                open.insert(ni, child);
+                queue.put(ni, g + h);
+            } else {
+                found->used |= 1 << opposite[d];
+                if (g < found->g) {
+                    found->g = g;
+                    found->parent = ci;
+                    found->relay = nextRelay;
+                    queue.put(ni, g + h);
+                }
+            }
+        }
+
+        qint64 bytes = footprint(open) + footprint(queue);
+        peakBytes = qMax(peakBytes, bytes);
+        if (budget > 0 && bytes > budget) prune(open, queue, to);
+    }
+    return -1.;
+}
+
+//!
+//! Урезать открытый список вдвое, оставив клетки с наименьшей оценкой f
+//! Очередь перестраивается без устаревших записей
+//!
+void FrontierSearch::prune(QHash<int, Node>& open, PriorityQueue<int, double>& queue, int to) {
+    if (open.isEmpty()) return;
+    QPoint target = coord(to);
+    QVector<std::pair<double, int>> ranked;
+    ranked.reserve(open.size());
+    for (auto it = open.constBegin(); it != open.constEnd(); ++it) {
+        ranked.append(std::make_pair(it->g + heuristic(coord(it.key()), target), it.key()));
+    }
+    int keep = qMax(1, (int)ranked.size() / 2);
+    std::nth_element(ranked.begin(), ranked.begin() + keep - 1, ranked.end());
+    for (int i = keep; i < ranked.size(); i++) open.remove(ranked[i].second);
+
+    queue = PriorityQueue<int, double>();
+    for (int i = 0; i < keep; i++) queue.put(ranked[i].second, ranked[i].first);
+    exact = false;
+}
+
+double FrontierSearch::walkness(int cell) const {
+    if (clearance != 0 && !clearance->passable(cell, radius)) return 1.;
+    auto it = mesh.constFind(coord(cell));
+    return it == mesh.constEnd() ? 1. : it->walkness;
+}
+
+QPoint FrontierSearch::coord(int cell) const {
+    return QPoint(cell / rows, cell % rows);
+}
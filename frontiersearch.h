@@ -0,0 +1,59 @@
+#ifndef FRONTIERSEARCH_H
+#define FRONTIERSEARCH_H
+
+#include <functional>
+#include <QVector>
+#include <QHash>
+#include <QPoint>
+#include "meshpoint.h"
+#include "prioqueue.h"
+#include "clearance.h"
+
+class FrontierSearch {
+public:
+    typedef std::function<double(const QPoint&, const QPoint&)> Heuristic;
+
+    static constexpr qint64 hashEntryBytes = 8;
+
+    FrontierSearch(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, const Heuristic& heuristic, qint64 budget);
+    void setClearance(const ClearanceMap* map, float radius);
+    double find(const QPoint& start, const QPoint& finish, QVector<QPoint>& cells);
+    bool optimal() const;
+    qint64 peak() const;
+
+    template<typename Key, typename Value>
+    static qint64 footprint(const QHash<Key, Value>& table) {
+        return table.size() * (qint64)(sizeof(Key) + sizeof(Value) + hashEntryBytes);
+    }
+
+    template<typename Item, typename Priority>
+    static qint64 footprint(const PriorityQueue<Item, Priority>& queue) {
+        return queue.size() * (qint64)sizeof(typename PriorityQueue<Item, Priority>::element);
+    }
+
+protected:
+    struct Node {
+        double g = 0.;
+        int parent = -1;
+        int relay = -1;
+        quint8 used = 0;
+    };
+
+    const QHash<QPoint, MeshPoint>& mesh;
+    int cols, rows;
+    Heuristic heuristic;
+    const ClearanceMap* clearance = 0;
+    float radius = 0.f;
+    qint64 budget;
+    qint64 peakBytes = 0;
+    qint64 expansions = 0;
+    bool exact = true;
+
+    double solve(int from, int to, QVector<QPoint>& cells);
+    double search(int from, int to, int& relay);
+    void prune(QHash<int, Node>& open, PriorityQueue<int, double>& queue, int to);
+    double walkness(int cell) const;
+    QPoint coord(int cell) const;
+};
+
+#endif // FRONTIERSEARCH_H
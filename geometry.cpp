@@ -0,0 +1,274 @@
+//!
+//! Точные предикаты пересечения отрезков и полигонов.
+//! Рёбра полигона хранятся структурой массивов (отдельно начала и концы по осям),
+//! поэтому один отрезок проверяется сразу против 8 (SSE2) или 16 (AVX2) рёбер.
+//! Ориентация считается в целых числах без погрешностей: при координатах в пределах
+//! [-16384; 16383] разности умещаются в 16 бит, а векторное произведение -- в 32 бита (`madd_epi16`).
+//! Вне этого диапазона и без SIMD используется скалярная проверка `linesIntersect`
+//!
+
+#include "geometry.h"
+#include "utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GEOMETRY_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+static const int compactMin = -16384;
+static const int compactMax = 16383;
+
+static bool fitsCompact(const QPoint& point) {
+    return point.x() >= compactMin && point.x() <= compactMax && point.y() >= compactMin && point.y() <= compactMax;
+}
+
+//!
+//! Упаковать пару 16-битных чисел в одно 32-битное (младшее -- lo)
+//!
+static int pair16(int lo, int hi) {
+    return (int)((quint32)(quint16)lo | ((quint32)(quint16)hi << 16));
+}
+
+#ifdef GEOMETRY_SSE2
+//!
+//! Маски пересечения по четырём рёбрам
+//! o1, o2 -- ориентация концов ребра относительно отрезка, o3, o4 -- концов отрезка относительно ребра.
+//! hit -- знаки различаются в обеих парах, degenerate -- есть нулевая ориентация и нужна скалярная проверка
+//!
+static inline void orientLanes(__m128i o1, __m128i o2, __m128i o3, __m128i o4, int& hit, int& degenerate) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i d12 = _mm_or_si128(_mm_xor_si128(_mm_cmpgt_epi32(o1, zero), _mm_cmpgt_epi32(o2, zero)),
+                               _mm_xor_si128(_mm_cmplt_epi32(o1, zero), _mm_cmplt_epi32(o2, zero)));
+    __m128i d34 = _mm_or_si128(_mm_xor_si128(_mm_cmpgt_epi32(o3, zero), _mm_cmpgt_epi32(o4, zero)),
+                               _mm_xor_si128(_mm_cmplt_epi32(o3, zero), _mm_cmplt_epi32(o4, zero)));
+    __m128i zeros = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(o1, zero), _mm_cmpeq_epi32(o2, zero)),
+                                 _mm_or_si128(_mm_cmpeq_epi32(o3, zero), _mm_cmpeq_epi32(o4, zero)));
+    __m128i hits = _mm_and_si128(d12, d34);
+    hit = _mm_movemask_ps(_mm_castsi128_ps(hits));
+    degenerate = _mm_movemask_ps(_mm_castsi128_ps(_mm_andnot_si128(hits, zeros)));
+}
+#endif
+
+#ifdef __AVX2__
+static inline void orientLanes(__m256i o1, __m256i o2, __m256i o3, __m256i o4, int& hit, int& degenerate) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i d12 = _mm256_or_si256(_mm256_xor_si256(_mm256_cmpgt_epi32(o1, zero), _mm256_cmpgt_epi32(o2, zero)),
+                                  _mm256_xor_si256(_mm256_cmpgt_epi32(zero, o1), _mm256_cmpgt_epi32(zero, o2)));
+    __m256i d34 = _mm256_or_si256(_mm256_xor_si256(_mm256_cmpgt_epi32(o3, zero), _mm256_cmpgt_epi32(o4, zero)),
+                                  _mm256_xor_si256(_mm256_cmpgt_epi32(zero, o3), _mm256_cmpgt_epi32(zero, o4)));
+    __m256i zeros = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi32(o1, zero), _mm256_cmpeq_epi32(o2, zero)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi32(o3, zero), _mm256_cmpeq_epi32(o4, zero)));
+    __m256i hits = _mm256_and_si256(d12, d34);
+    hit = _mm256_movemask_ps(_mm256_castsi256_ps(hits));
+    degenerate = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(hits, zeros)));
+}
+#endif
+
+EdgeBatch::EdgeBatch(const QPolygon& poly) {
+    assign(poly);
+}
+
+//!
+//! Заполнить рёбра по полигону
+//! Полигон считается замкнутым: последнее ребро соединяет последнюю вершину с первой
+//!
+//! \param poly Полигон
+//!
+void EdgeBatch::assign(const QPolygon& poly) {
+    int n = poly.size();
+    ax.resize(n);
+    ay.resize(n);
+    bx.resize(n);
+    by.resize(n);
+    compact = true;
+    for (int i = 0; i < n; i++) {
+        const QPoint& a = poly[i];
+        const QPoint& b = poly[(i + 1) % n];
+        ax[i] = a.x();
+        ay[i] = a.y();
+        bx[i] = b.x();
+        by[i] = b.y();
+        compact = compact && fitsCompact(a);
+    }
+    box = n > 0 ? poly.boundingRect() : QRect();
+
+    ax16.resize(compact ? n : 0);
+    ay16.resize(compact ? n : 0);
+    bx16.resize(compact ? n : 0);
+    by16.resize(compact ? n : 0);
+    if (!compact) return;
+    for (int i = 0; i < n; i++) {
+        ax16[i] = ax[i];
+        ay16[i] = ay[i];
+        bx16[i] = bx[i];
+        by16[i] = by[i];
+    }
+}
+
+//!
+//! Проверка, что рёбра построены по этому полигону
+//!
+bool EdgeBatch::matches(const QPolygon& poly) const {
+    if (poly.size() != count()) return false;
+    for (int i = 0; i < poly.size(); i++) {
+        if (poly[i].x() != ax[i] || poly[i].y() != ay[i]) return false;
+    }
+    return true;
+}
+
+int EdgeBatch::count() const {
+    return ax.size();
+}
+
+const QRect& EdgeBatch::bounds() const {
+    return box;
+}
+
+//!
+//! Проверка на пересечение отрезка хотя бы с одним ребром
+//! Касание также считается пересечением
+//!
+//! \param line Отрезок
+//! \return Успех или нет
+//!
+bool EdgeBatch::crosses(const QLine& line) const {
+    int n = count();
+    int i = 0;
+    bool simd = compact && fitsCompact(line.p1()) && fitsCompact(line.p2());
+
+#ifdef __AVX2__
+    if (simd) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i px = _mm256_set1_epi16(line.x1()), py = _mm256_set1_epi16(line.y1());
+        const __m256i qx = _mm256_set1_epi16(line.x2()), qy = _mm256_set1_epi16(line.y2());
+        const __m256i dq = _mm256_set1_epi32(pair16(line.dx(), -line.dy()));
+        for (; i + 16 <= n; i += 16) {
+            __m256i eax = _mm256_loadu_si256((const __m256i*)(ax16.constData() + i));
+            __m256i eay = _mm256_loadu_si256((const __m256i*)(ay16.constData() + i));
+            __m256i ebx = _mm256_loadu_si256((const __m256i*)(bx16.constData() + i));
+            __m256i eby = _mm256_loadu_si256((const __m256i*)(by16.constData() + i));
+            __m256i apx = _mm256_sub_epi16(eax, px), apy = _mm256_sub_epi16(eay, py);
+            __m256i bpx = _mm256_sub_epi16(ebx, px), bpy = _mm256_sub_epi16(eby, py);
+            __m256i aqx = _mm256_sub_epi16(eax, qx), aqy = _mm256_sub_epi16(eay, qy);
+            __m256i ex = _mm256_sub_epi16(ebx, eax), ey = _mm256_sub_epi16(eby, eay);
+            __m256i napy = _mm256_sub_epi16(zero, apy), naqy = _mm256_sub_epi16(zero, aqy);
+
+            int hitLo, degLo, hitHi, degHi;
+            orientLanes(_mm256_madd_epi16(_mm256_unpacklo_epi16(apy, apx), dq),
+                        _mm256_madd_epi16(_mm256_unpacklo_epi16(bpy, bpx), dq),
+                        _mm256_madd_epi16(_mm256_unpacklo_epi16(ex, ey), _mm256_unpacklo_epi16(napy, apx)),
+                        _mm256_madd_epi16(_mm256_unpacklo_epi16(ex, ey), _mm256_unpacklo_epi16(naqy, aqx)),
+                        hitLo, degLo);
+            orientLanes(_mm256_madd_epi16(_mm256_unpackhi_epi16(apy, apx), dq),
+                        _mm256_madd_epi16(_mm256_unpackhi_epi16(bpy, bpx), dq),
+                        _mm256_madd_epi16(_mm256_unpackhi_epi16(ex, ey), _mm256_unpackhi_epi16(napy, apx)),
+                        _mm256_madd_epi16(_mm256_unpackhi_epi16(ex, ey), _mm256_unpackhi_epi16(naqy, aqx)),
+                        hitHi, degHi);
+            if (hitLo | hitHi) return true;
+            // unpack работает внутри 128-битных половин: lo -- рёбра 0-3 и 8-11, hi -- 4-7 и 12-15
+            for (int lane = 0; lane < 8; lane++) {
+                int offset = (lane & 3) + (lane & 4 ? 8 : 0);
+                if ((degLo >> lane & 1) && linesIntersect(line, edge(i + offset))) return true;
+                if ((degHi >> lane & 1) && linesIntersect(line, edge(i + offset + 4))) return true;
+            }
+        }
+    }
+#endif
+
+#ifdef GEOMETRY_SSE2
+    if (simd) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i px = _mm_set1_epi16(line.x1()), py = _mm_set1_epi16(line.y1());
+        const __m128i qx = _mm_set1_epi16(line.x2()), qy = _mm_set1_epi16(line.y2());
+        const __m128i dq = _mm_set1_epi32(pair16(line.dx(), -line.dy()));
+        for (; i + 8 <= n; i += 8) {
+            __m128i eax = _mm_loadu_si128((const __m128i*)(ax16.constData() + i));
+            __m128i eay = _mm_loadu_si128((const __m128i*)(ay16.constData() + i));
+            __m128i ebx = _mm_loadu_si128((const __m128i*)(bx16.constData() + i));
+            __m128i eby = _mm_loadu_si128((const __m128i*)(by16.constData() + i));
+            __m128i apx = _mm_sub_epi16(eax, px), apy = _mm_sub_epi16(eay, py);
+            __m128i bpx = _mm_sub_epi16(ebx, px), bpy = _mm_sub_epi16(eby, py);
+            __m128i aqx = _mm_sub_epi16(eax, qx), aqy = _mm_sub_epi16(eay, qy);
+            __m128i ex = _mm_sub_epi16(ebx, eax), ey = _mm_sub_epi16(eby, eay);
+            __m128i napy = _mm_sub_epi16(zero, apy), naqy = _mm_sub_epi16(zero, aqy);
+
+            int hitLo, degLo, hitHi, degHi;
+            orientLanes(_mm_madd_epi16(_mm_unpacklo_epi16(apy, apx), dq),
+                        _mm_madd_epi16(_mm_unpacklo_epi16(bpy, bpx), dq),
+                        _mm_madd_epi16(_mm_unpacklo_epi16(ex, ey), _mm_unpacklo_epi16(napy, apx)),
+                        _mm_madd_epi16(_mm_unpacklo_epi16(ex, ey), _mm_unpacklo_epi16(naqy, aqx)),
+                        hitLo, degLo);
+            orientLanes(_mm_madd_epi16(_mm_unpackhi_epi16(apy, apx), dq),
+                        _mm_madd_epi16(_mm_unpackhi_epi16(bpy, bpx), dq),
+                        _mm_madd_epi16(_mm_unpackhi_epi16(ex, ey), _mm_unpackhi_epi16(napy, apx)),
+                        _mm_madd_epi16(_mm_unpackhi_epi16(ex, ey), _mm_unpackhi_epi16(naqy, aqx)),
+                        hitHi, degHi);
+            if (hitLo | hitHi) return true;
+            for (int lane = 0; lane < 4; lane++) {
+                if ((degLo >> lane & 1) && linesIntersect(line, edge(i + lane))) return true;
+                if ((degHi >> lane & 1) && linesIntersect(line, edge(i + lane + 4))) return true;
+            }
+        }
+    }
+#endif
+
+    Q_UNUSED(simd);
+    for (; i < n; i++) {
+        if (linesIntersect(line, edge(i))) return true;
+    }
+    return false;
+}
+
+//!
+//! Проверка принадлежности точки полигону (правило чёт-нечет, граница считается внутренней)
+//!
+//! \param point Точка
+//! \return Принадлежность
+//!
+bool EdgeBatch::contains(const QPoint& point) const {
+    if (count() == 0 || !box.contains(point)) return false;
+    bool inside = false;
+    for (int i = 0; i < count(); i++) {
+        qint64 cross = (qint64)(bx[i] - ax[i]) * (point.y() - ay[i]) - (qint64)(by[i] - ay[i]) * (point.x() - ax[i]);
+        if (cross == 0
+            && qMin(ax[i], bx[i]) <= point.x() && point.x() <= qMax(ax[i], bx[i])
+            && qMin(ay[i], by[i]) <= point.y() && point.y() <= qMax(ay[i], by[i])) return true;
+        if ((ay[i] > point.y()) != (by[i] > point.y()) && (cross > 0) == (by[i] > ay[i])) inside = !inside;
+    }
+    return inside;
+}
+
+//!
+//! Проверка на пересечение отрезка и полигона как замкнутой области
+//!
+//! \param line Отрезок
+//! \return Успех или нет
+//!
+bool EdgeBatch::intersects(const QLine& line) const {
+    if (count() == 0) return false;
+    QRect lineBox = QRect(line.p1(), line.p2()).normalized();
+    if (!box.intersects(lineBox)) return false;
+    return crosses(line) || contains(line.p1());
+}
+
+//!
+//! Проверка на пересечение двух полигонов как замкнутых областей
+//!
+//! \param other Рёбра другого полигона
+//! \return Успех или нет
+//!
+bool EdgeBatch::intersects(const EdgeBatch& other) const {
+    if (count() == 0 || other.count() == 0) return false;
+    if (!box.intersects(other.box)) return false;
+    for (int i = 0; i < other.count(); i++) {
+        if (crosses(other.edge(i))) return true;
+    }
+    return contains(QPoint(other.ax[0], other.ay[0])) || other.contains(QPoint(ax[0], ay[0]));
+}
+
+QLine EdgeBatch::edge(int i) const {
+    return QLine(ax[i], ay[i], bx[i], by[i]);
+}
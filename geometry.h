@@ -0,0 +1,33 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <QVector>
+#include <QPolygon>
+#include <QLine>
+#include <QRect>
+
+class EdgeBatch {
+public:
+    EdgeBatch() = default;
+    explicit EdgeBatch(const QPolygon& poly);
+
+    void assign(const QPolygon& poly);
+    bool matches(const QPolygon& poly) const;
+    int count() const;
+    const QRect& bounds() const;
+
+    bool crosses(const QLine& line) const;
+    bool contains(const QPoint& point) const;
+    bool intersects(const QLine& line) const;
+    bool intersects(const EdgeBatch& other) const;
+
+protected:
+    QVector<int> ax, ay, bx, by;
+    QVector<qint16> ax16, ay16, bx16, by16;
+    QRect box;
+    bool compact = false;
+
+    QLine edge(int i) const;
+};
+
+#endif // GEOMETRY_H
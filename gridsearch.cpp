@@ -0,0 +1,186 @@
+//!
+//! Поиск пути A* по сетке.
+//! Общий для поля (`Field::aStarPath`) и снимков карты (`MapSnapshot::findPath`): сетка,
+//! карта расстояний до стен, эвристика и бюджет памяти передаются снаружи, сам поиск состояния не хранит,
+//! кроме таблиц текущего потока (`CellTables::local`). Если плотные таблицы не помещаются в бюджет, поиск идёт
+//! по хэш-таблицам затронутых клеток; если не помещаются и они, поиск останавливается и сообщает об этом
+//! (`GridSearch::exceeded`), а вызывающий переходит к `FrontierSearch`
+//!
+
+#include <algorithm>
+#include <QHash>
+#include <QDebug>
+#include "gridsearch.h"
+#include "prioqueue.h"
+#include "frontiersearch.h"
+
+static const QPoint evenOffsets[4] = { QPoint(0, 1), QPoint(0, -1), QPoint(-1, 0), QPoint(1, 0) };
+static const QPoint oddOffsets[4] = { QPoint(1, 0), QPoint(-1, 0), QPoint(0, -1), QPoint(0, 1) };
+
+//!
+//! \param cells Сетка непроходимости
+//! \param heuristic Согласованная эвристика (как `Field::heuristic`)
+//! \param budget Бюджет памяти в байтах (0 -- без ограничения)
+//!
+GridSearch::GridSearch(const CellGrid& cells, const Heuristic& heuristic, qint64 budget)
+    : cells(cells), heuristic(heuristic), budget(budget) {
+}
+
+//!
+//! Учитывать размер агента: клетки, где агент радиуса radius не помещается, считаются стенами
+//!
+//! \param map Карта расстояний до стен (0 -- не учитывать)
+//! \param radius Радиус агента в клетках сетки
+//!
+void GridSearch::setClearance(const ClearanceMap* map, float radius) {
+    clearance = map;
+    this->radius = radius;
+}
+
+//!
+//! Найти путь
+//! Стоимость шага -- 1 + непроходимость клетки, в которую выполняется шаг, старт стоит 1. Клетки с непроходимостью 1.0
+//! считаются стенами. Таблицы поиска плотные (`CellTables`) и индексируются номером клетки в раскладке сетки (`CellGrid`),
+//! очередь -- номером `i * rows + j`, поэтому порядок раскрытия от раскладки не зависит. Если плотные таблицы
+//! больше бюджета, поиск идёт по хэш-таблицам (`GridSearch::sparse`) и находит тот же путь
+//!
+//! \param start Начальная клетка (координаты на сетке)
+//! \param finish Конечная клетка (координаты на сетке)
+//! \param route Вектор для сохранения клеток пути от старта к финишу
+//! \return Стоимость пути, если путь найден
+//! \return 0, если путь не найден или таблицы не поместились в бюджет (см. `GridSearch::exceeded`)
+//!
+double GridSearch::find(const QPoint& start, const QPoint& finish, QVector<QPoint>& route) {
+    route.clear();
+    overflow = false;
+    expansions = 0;
+    if (budget > 0 && CellTables::footprint(cells.capacity()) > budget) return sparse(start, finish, route);
+
+    int rows = cells.rows();
+    int si = start.x() * rows + start.y();
+    int fi = finish.x() * rows + finish.y();
+    CellTables& tables = CellTables::local();
+    tables.prepare(cells.capacity());
+    PriorityQueue<int, double> queue;
+    tables.reach(cells.index(start), 1., si);
+    queue.put(si, 1.);
+
+    while (!queue.empty()) {
+        int ci = queue.get();
+        if (ci == fi) break;
+        QPoint current(ci / rows, ci % rows);
+        int c = cells.index(current);
+        // Повторно клетка раскрывается, только если после закрытия до неё нашёлся путь дешевле
+        if (tables.closed[c]) continue;
+        tables.closed[c] = true;
+        expansions++;
+
+        if (budget > 0 && tables.footprint() + FrontierSearch::footprint(queue) > budget) {
+            overflow = true;
+            return 0;
+        }
+
+        double base = tables.costs[c];
+        const QPoint* offsets = (current.x() + current.y()) % 2 == 0 ? evenOffsets : oddOffsets;
+        for (int k = 0; k < 4; k++) {
+            QPoint next = current + offsets[k];
+            if (!cells.contains(next)) continue;
+            int n = cells.index(next);
+            double walkness = cells.walkness(n);
+            if (walkness >= 1.) continue;
+            int ni = next.x() * rows + next.y();
+            if (clearance != 0 && !clearance->passable(ni, radius)) continue;
+            double cost = base + 1. + walkness;
+            if (cost < tables.costs[n]) {
+                tables.reach(n, cost, ci);
+                queue.put(ni, cost + heuristic(next, finish));
+            }
+        }
+    }
+
+    qInfo() << "GridSearch::find" << "Expanded" << expansions;
+    int f = cells.index(finish);
+    if (tables.origins[f] < 0) return 0;
+    for (int ci = fi; ; ci = tables.origins[cells.index(ci / rows, ci % rows)]) {
+        route.append(QPoint(ci / rows, ci % rows));
+        if (ci == si) break;
+    }
+    std::reverse(route.begin(), route.end());
+    return tables.costs[f];
+}
+
+//!
+//! Поиск по хэш-таблицам затронутых клеток (как до `CellGrid`), когда плотные таблицы больше бюджета памяти
+//! Память растёт с числом затронутых клеток, а не с размером сетки, поэтому короткие пути укладываются и в малый бюджет.
+//! Закрытых клеток не хранит: устаревший элемент очереди раскрывает клетку повторно, но ни одного соседа не улучшает
+//!
+//! \param start Начальная клетка (координаты на сетке)
+//! \param finish Конечная клетка (координаты на сетке)
+//! \param route Вектор для сохранения клеток пути от старта к финишу
+//! \return Стоимость пути, если путь найден
+//! \return 0, если путь не найден или таблицы не поместились в бюджет
+//!
+double GridSearch::sparse(const QPoint& start, const QPoint& finish, QVector<QPoint>& route) {
+    int rows = cells.rows();
+    int si = start.x() * rows + start.y();
+    int fi = finish.x() * rows + finish.y();
+    QHash<int, double> costs;
+    QHash<int, int> origins;
+    PriorityQueue<int, double> queue;
+    costs[si] = 1.;
+    origins[si] = si;
+    queue.put(si, 1.);
+
+    while (!queue.empty()) {
+        int ci = queue.get();
+        if (ci == fi) break;
+        expansions++;
+
+        if (FrontierSearch::footprint(costs) + FrontierSearch::footprint(origins) + FrontierSearch::footprint(queue) > budget) {
+            overflow = true;
+            return 0;
+        }
+
+        QPoint current(ci / rows, ci % rows);
+        double base = costs[ci];
+        const QPoint* offsets = (current.x() + current.y()) % 2 == 0 ? evenOffsets : oddOffsets;
+        for (int k = 0; k < 4; k++) {
+            QPoint next = current + offsets[k];
+            if (!cells.contains(next)) continue;
+            double walkness = cells.walkness(cells.index(next));
+            if (walkness >= 1.) continue;
+            int ni = next.x() * rows + next.y();
+            if (clearance != 0 && !clearance->passable(ni, radius)) continue;
+            double cost = base + 1. + walkness;
+            auto known = costs.constFind(ni);
+            if (known == costs.constEnd() || cost < *known) {
+                costs[ni] = cost;
+                origins[ni] = ci;
+                queue.put(ni, cost + heuristic(next, finish));
+            }
+        }
+    }
+
+    qInfo() << "GridSearch::sparse" << "Expanded" << expansions;
+    if (!origins.contains(fi)) return 0;
+    for (int ci = fi; ; ci = origins[ci]) {
+        route.append(QPoint(ci / rows, ci % rows));
+        if (ci == si) break;
+    }
+    std::reverse(route.begin(), route.end());
+    return costs[fi];
+}
+
+//!
+//! Поиск остановлен: таблицы не поместились в бюджет памяти
+//!
+bool GridSearch::exceeded() const {
+    return overflow;
+}
+
+//!
+//! Количество раскрытых клеток в последнем поиске
+//!
+unsigned GridSearch::expanded() const {
+    return expansions;
+}
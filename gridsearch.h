@@ -0,0 +1,32 @@
+#ifndef GRIDSEARCH_H
+#define GRIDSEARCH_H
+
+#include <functional>
+#include <QVector>
+#include <QPoint>
+#include "cellgrid.h"
+#include "clearance.h"
+
+class GridSearch {
+public:
+    typedef std::function<double(const QPoint&, const QPoint&)> Heuristic;
+
+    GridSearch(const CellGrid& cells, const Heuristic& heuristic, qint64 budget);
+    void setClearance(const ClearanceMap* map, float radius);
+    double find(const QPoint& start, const QPoint& finish, QVector<QPoint>& route);
+    bool exceeded() const;
+    unsigned expanded() const;
+
+protected:
+    const CellGrid& cells;
+    Heuristic heuristic;
+    const ClearanceMap* clearance = 0;
+    float radius = 0.f;
+    qint64 budget;
+    bool overflow = false;
+    unsigned expansions = 0;
+
+    double sparse(const QPoint& start, const QPoint& finish, QVector<QPoint>& route);
+};
+
+#endif // GRIDSEARCH_H
@@ -0,0 +1,526 @@
+//!
+//! Иерархия сжатия (contraction hierarchies) для повторяющихся запросов по неизменной карте.
+//! Предобработка по очереди удаляет ("сжимает") клетки сетки от наименее важных к наиболее важным.
+//! Кратчайшие пути через удаляемую клетку сохраняются рёбрами-сокращениями между её соседями,
+//! если между ними нет другого пути не длиннее (свидетеля). Номер клетки в этом порядке -- её ранг.
+//! Запрос -- двунаправленный Дейкстра, обе половины которого идут только вверх по рангу,
+//! поэтому просматриваются сотни клеток вместо всей карты. Сокращение помнит клетку, через которую
+//! проходит, и путь по клеткам сетки восстанавливается рекурсивной распаковкой сокращений.
+//! Граф ориентированный, стоимость шага та же, что и в `Field::aStarPath`: 1 + непроходимость клетки, в которую идём
+//!
+
+#include <algorithm>
+#include <limits>
+#include <QFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "hierarchy.h"
+#include "prioqueue.h"
+
+static const float infinity = std::numeric_limits<float>::infinity();
+static const int offsets[4][2] = { { 0, 1 }, { 0, -1 }, { -1, 0 }, { 1, 0 } };
+
+namespace {
+
+struct Edge {
+    int other;
+    float cost;
+    int middle;
+};
+
+//!
+//! Рабочие массивы запроса размером с сетку. После запроса сбрасываются только затронутые клетки,
+//! поэтому запрос не выделяет память и не очищает массивы целиком.
+//! Запросы идут из нескольких потоков одновременно, поэтому у каждого потока свои массивы
+//!
+struct Workspace {
+    QVector<float> dist[2];
+    QVector<int> parent[2], middle[2];
+    QVector<int> touched;
+    PriorityQueue<int, float> queues[2];
+
+    void prepare(int n) {
+        if (dist[0].size() == n) return;
+        for (int side = 0; side < 2; side++) {
+            dist[side].fill(infinity, n);
+            parent[side].fill(-1, n);
+            middle[side].fill(-1, n);
+        }
+        touched.clear();
+    }
+
+    void label(int side, int cell, float d, int from, int via) {
+        if (dist[0][cell] == infinity && dist[1][cell] == infinity) touched.append(cell);
+        dist[side][cell] = d;
+        parent[side][cell] = from;
+        middle[side][cell] = via;
+        queues[side].put(cell, d);
+    }
+
+    void reset() {
+        for (int cell : touched) dist[0][cell] = dist[1][cell] = infinity;
+        touched.clear();
+        for (int side = 0; side < 2; side++) {
+            while (!queues[side].empty()) queues[side].get();
+        }
+    }
+};
+
+static thread_local Workspace workspace;
+
+//!
+//! Граф на время предобработки: входящие и исходящие рёбра ещё не сжатых клеток вместе с сокращениями.
+//! Рёбра сжатой клетки переносятся в `upward` и `downward` и удаляются у соседей
+//!
+struct Contraction {
+    QVector<QVector<Edge>> out, in;
+    QVector<QVector<Edge>> upward, downward;
+    QVector<bool> contracted;
+    QVector<int> removed, level;
+    QVector<float> dist;
+    QVector<int> touched;
+    QVector<int> marks;
+    int stamp = 0;
+    PriorityQueue<int, float> queue;
+
+    void witness(int source, int skip, float limit, int targets);
+    int contract(int node, bool simulate);
+    void shortcut(int from, int to, float cost, int middle);
+    void remove(int node);
+    int priority(int node);
+    QVector<int> alive(int node) const;
+};
+
+//!
+//! Поиск свидетелей: Дейкстра из клетки в оставшемся графе без сжимаемой клетки
+//! Поиск останавливается, когда найдены все отмеченные цели. Кроме того, он ограничен стоимостью
+//! и количеством просмотренных клеток, поэтому свидетель может не найтись, и тогда добавится
+//! лишнее сокращение -- на правильность запросов это не влияет
+//!
+//! \param source Клетка-источник
+//! \param skip Сжимаемая клетка
+//! \param limit Наибольшая стоимость, которую нужно проверить
+//! \param targets Количество целей (клеток с отметкой `stamp`)
+//!
+void Contraction::witness(int source, int skip, float limit, int targets) {
+    for (int node : touched) dist[node] = infinity;
+    touched.clear();
+    while (!queue.empty()) queue.get();
+    dist[source] = 0.f;
+    touched.append(source);
+    queue.put(source, 0.f);
+
+    int settled = 0;
+    while (!queue.empty()) {
+        float d = queue.top().first;
+        int node = queue.get();
+        if (d > dist[node]) continue;
+        if (d > limit || ++settled > ContractionHierarchy::witnessSettled) break;
+        if (marks[node] == stamp && --targets == 0) break;
+        for (const Edge& edge : out[node]) {
+            if (edge.other == skip) continue;
+            float next = d + edge.cost;
+            if (next < dist[edge.other]) {
+                if (dist[edge.other] == infinity) touched.append(edge.other);
+                dist[edge.other] = next;
+                queue.put(edge.other, next);
+            }
+        }
+    }
+}
+
+//!
+//! Сжать клетку или посчитать, сколько сокращений для этого понадобится
+//!
+//! \param node Клетка
+//! \param simulate true -- только посчитать сокращения, не добавляя их
+//! \return Количество сокращений
+//!
+int Contraction::contract(int node, bool simulate) {
+    int added = 0;
+    for (int k = 0; k < in[node].size(); k++) {
+        Edge incoming = in[node][k];
+        float limit = 0.f;
+        int targets = 0;
+        stamp++;
+        for (const Edge& outgoing : out[node]) {
+            if (outgoing.other == incoming.other) continue;
+            limit = qMax(limit, incoming.cost + outgoing.cost);
+            marks[outgoing.other] = stamp;
+            targets++;
+        }
+        if (targets == 0) continue;
+
+        witness(incoming.other, node, limit, targets);
+        for (int m = 0; m < out[node].size(); m++) {
+            Edge outgoing = out[node][m];
+            if (outgoing.other == incoming.other) continue;
+            float cost = incoming.cost + outgoing.cost;
+            if (dist[outgoing.other] <= cost) continue;
+            added++;
+            if (!simulate) shortcut(incoming.other, outgoing.other, cost, node);
+        }
+    }
+    return added;
+}
+
+//!
+//! Добавить сокращение или удешевить существующее ребро
+//!
+void Contraction::shortcut(int from, int to, float cost, int middle) {
+    for (Edge& edge : out[from]) {
+        if (edge.other != to) continue;
+        if (cost < edge.cost) {
+            edge.cost = cost;
+            edge.middle = middle;
+            for (Edge& back : in[to]) {
+                if (back.other == from) back = { from, cost, middle };
+            }
+        }
+        return;
+    }
+    out[from].append({ to, cost, middle });
+    in[to].append({ from, cost, middle });
+}
+
+//!
+//! Убрать сжатую клетку из графа: её рёбра становятся рёбрами иерархии
+//!
+void Contraction::remove(int node) {
+    for (const Edge& edge : out[node]) {
+        QVector<Edge>& back = in[edge.other];
+        back.erase(std::remove_if(back.begin(), back.end(), [node](const Edge& e) { return e.other == node; }), back.end());
+    }
+    for (const Edge& edge : in[node]) {
+        QVector<Edge>& back = out[edge.other];
+        back.erase(std::remove_if(back.begin(), back.end(), [node](const Edge& e) { return e.other == node; }), back.end());
+    }
+    upward[node].swap(out[node]);
+    downward[node].swap(in[node]);
+    contracted[node] = true;
+}
+
+//!
+//! Важность клетки: удвоенная разность добавляемых сокращений и удаляемых рёбер плюс количество уже
+//! сжатых соседей и глубина клетки в иерархии (чтобы сжатие шло по карте равномерно, а не выедало одну область)
+//!
+int Contraction::priority(int node) {
+    return 2 * (contract(node, true) - in[node].size() - out[node].size()) + removed[node] + level[node];
+}
+
+//!
+//! Несжатые соседи клетки без повторов
+//!
+QVector<int> Contraction::alive(int node) const {
+    QVector<int> result;
+    for (const Edge& edge : in[node]) {
+        if (!result.contains(edge.other)) result.append(edge.other);
+    }
+    for (const Edge& edge : out[node]) {
+        if (!result.contains(edge.other)) result.append(edge.other);
+    }
+    return result;
+}
+
+}
+
+static QDataStream& operator<<(QDataStream& stream, const ContractionHierarchy::Arc& arc) {
+    return stream << (qint32)arc.target << arc.cost << (qint32)arc.middle;
+}
+
+static QDataStream& operator>>(QDataStream& stream, ContractionHierarchy::Arc& arc) {
+    qint32 target, middle;
+    stream >> target >> arc.cost >> middle;
+    arc.target = target;
+    arc.middle = middle;
+    return stream;
+}
+
+//!
+//! Отпечаток непроходимости сетки: иерархия подходит только к сетке с тем же отпечатком
+//!
+//! \param factors Непроходимость узлов (индекс `i * rows + j`)
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//!
+QByteArray ContractionHierarchy::fingerprintOf(const QVector<double>& factors, int cols, int rows) {
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    qint32 dims[2] = { cols, rows };
+    hash.addData(QByteArray::fromRawData((const char*)dims, sizeof(dims)));
+    hash.addData(QByteArray::fromRawData((const char*)factors.constData(), factors.size() * sizeof(double)));
+    return hash.result();
+}
+
+//!
+//! Построить иерархию
+//! Клетки сжимаются в порядке важности (`Contraction::priority`). Важность меняется по мере сжатия соседей,
+//! поэтому она пересчитывается лениво: у клетки, которую достали из очереди, и если клетка стала
+//! менее срочной, чем следующая в очереди, она возвращается в очередь
+//!
+//! \param factors Непроходимость узлов (индекс `i * rows + j`)
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//! \return Иерархия
+//!
+QSharedPointer<const ContractionHierarchy> ContractionHierarchy::build(const QVector<double>& factors, int cols, int rows) {
+    QElapsedTimer timer;
+    timer.start();
+    int n = cols * rows;
+    Contraction graph;
+    graph.out.resize(n);
+    graph.in.resize(n);
+    graph.upward.resize(n);
+    graph.downward.resize(n);
+    graph.contracted.fill(false, n);
+    graph.removed.fill(0, n);
+    graph.level.fill(0, n);
+    graph.dist.fill(infinity, n);
+    graph.marks.fill(0, n);
+
+    for (int i = 0; i < cols; i++) {
+        for (int j = 0; j < rows; j++) {
+            int cell = i * rows + j;
+            if (factors[cell] >= 1.) {
+                graph.contracted[cell] = true;
+                continue;
+            }
+            for (const auto& offset : offsets) {
+                int ni = i + offset[0], nj = j + offset[1];
+                if (ni < 0 || nj < 0 || ni >= cols || nj >= rows) continue;
+                int next = ni * rows + nj;
+                if (factors[next] >= 1.) continue;
+                float cost = 1.f + (float)factors[next];
+                graph.out[cell].append({ next, cost, -1 });
+                graph.in[next].append({ cell, cost, -1 });
+            }
+        }
+    }
+
+    QVector<int> priority(n, 0);
+    PriorityQueue<int, int> queue;
+    for (int cell = 0; cell < n; cell++) {
+        if (graph.contracted[cell]) continue;
+        priority[cell] = graph.priority(cell);
+        queue.put(cell, priority[cell]);
+    }
+
+    QSharedPointer<ContractionHierarchy> result(new ContractionHierarchy());
+    result->cols = cols;
+    result->rows = rows;
+    result->fingerprint = fingerprintOf(factors, cols, rows);
+    result->rank.fill(-1, n);
+    int order = 0;
+    while (!queue.empty()) {
+        int value = queue.top().first;
+        int node = queue.get();
+        if (graph.contracted[node] || value != priority[node]) continue;
+        int current = graph.priority(node);
+        if (current != value) {
+            priority[node] = current;
+            if (!queue.empty() && current > queue.top().first) {
+                queue.put(node, current);
+                continue;
+            }
+        }
+
+        QVector<int> around = graph.alive(node);
+        graph.contract(node, false);
+        graph.remove(node);
+        result->rank[node] = order++;
+        for (int other : around) {
+            graph.removed[other]++;
+            graph.level[other] = qMax(graph.level[other], graph.level[node] + 1);
+        }
+    }
+
+    // Рёбра сжатой клетки ведут к клеткам выше по рангу: исходящие -- для прямого поиска, входящие -- для обратного
+    result->upFirst.fill(0, n + 1);
+    result->downFirst.fill(0, n + 1);
+    for (int node = 0; node < n; node++) {
+        result->upFirst[node + 1] = result->upFirst[node] + graph.upward[node].size();
+        result->downFirst[node + 1] = result->downFirst[node] + graph.downward[node].size();
+    }
+    result->up.reserve(result->upFirst[n]);
+    result->down.reserve(result->downFirst[n]);
+    for (int node = 0; node < n; node++) {
+        for (const Edge& edge : graph.upward[node]) result->up.append({ edge.other, edge.cost, edge.middle });
+        for (const Edge& edge : graph.downward[node]) result->down.append({ edge.other, edge.cost, edge.middle });
+    }
+
+    qInfo() << "ContractionHierarchy::build" << "Cells" << order << "Arcs" << result->up.size() + result->down.size() << "in" << timer.elapsed() << "ms";
+    return result;
+}
+
+//!
+//! Найти кратчайший путь между клетками
+//! Прямой поиск идёт от старта по рёбрам вверх, обратный -- от финиша по рёбрам, входящим сверху.
+//! Клетка, до которой есть более короткий путь сверху, не раскрывается (stall-on-demand):
+//! через неё кратчайший путь не проходит
+//!
+//! \param source Индекс клетки старта (`i * rows + j`)
+//! \param target Индекс клетки финиша
+//! \param cells Вектор для сохранения клеток пути от старта к финишу
+//! \return Стоимость пути
+//! \return -1 если пути нет
+//!
+float ContractionHierarchy::query(int source, int target, QVector<int>& cells) const {
+    cells.clear();
+    if (source < 0 || target < 0 || source >= rank.size() || target >= rank.size()) return -1.f;
+    if (rank[source] == -1 || rank[target] == -1) return -1.f;
+    if (source == target) {
+        cells.append(source);
+        return 0.f;
+    }
+
+    Workspace& work = workspace;
+    work.prepare(rank.size());
+    float* dist[2] = { work.dist[0].data(), work.dist[1].data() };
+    work.label(0, source, 0.f, -1, -1);
+    work.label(1, target, 0.f, -1, -1);
+
+    float best = infinity;
+    int meeting = -1;
+    while (true) {
+        int side = -1;
+        for (int s = 0; s < 2; s++) {
+            if (work.queues[s].empty() || work.queues[s].top().first >= best) continue;
+            if (side == -1 || work.queues[s].top().first < work.queues[side].top().first) side = s;
+        }
+        if (side == -1) break;
+
+        float d = work.queues[side].top().first;
+        int node = work.queues[side].get();
+        if (d > dist[side][node]) continue;
+        if (d + dist[1 - side][node] < best) {
+            best = d + dist[1 - side][node];
+            meeting = node;
+        }
+
+        const QVector<int>& first = side == 0 ? upFirst : downFirst;
+        const QVector<Arc>& arcs = side == 0 ? up : down;
+        const QVector<int>& stallFirst = side == 0 ? downFirst : upFirst;
+        const QVector<Arc>& stallArcs = side == 0 ? down : up;
+        bool stalled = false;
+        for (int k = stallFirst[node]; k < stallFirst[node + 1] && !stalled; k++) {
+            stalled = dist[side][stallArcs[k].target] + stallArcs[k].cost < d;
+        }
+        if (stalled) continue;
+
+        for (int k = first[node]; k < first[node + 1]; k++) {
+            const Arc& arc = arcs[k];
+            float next = d + arc.cost;
+            if (next < dist[side][arc.target]) work.label(side, arc.target, next, node, arc.middle);
+        }
+    }
+
+    if (meeting != -1) {
+        const int* parent[2] = { work.parent[0].constData(), work.parent[1].constData() };
+        const int* middle[2] = { work.middle[0].constData(), work.middle[1].constData() };
+        QVector<int> forward;
+        for (int node = meeting; node != source; node = parent[0][node]) forward.append(node);
+        cells.append(source);
+        for (int k = forward.size() - 1, from = source; k >= 0; from = forward[k--]) {
+            unpack(from, forward[k], middle[0][forward[k]], cells);
+        }
+        for (int node = meeting; node != target; node = parent[1][node]) {
+            unpack(node, parent[1][node], middle[1][node], cells);
+        }
+    }
+    work.reset();
+    return meeting == -1 ? -1.f : best;
+}
+
+//!
+//! Ребро из клетки в списке рёбер
+//!
+const ContractionHierarchy::Arc* ContractionHierarchy::arc(const QVector<int>& first, const QVector<Arc>& arcs, int from, int target) const {
+    for (int k = first[from]; k < first[from + 1]; k++) {
+        if (arcs[k].target == target) return &arcs[k];
+    }
+    return 0;
+}
+
+//!
+//! Распаковать ребро в клетки сетки
+//! Сокращение from -> to через middle состоит из рёбер from -> middle и middle -> to,
+//! middle ниже обеих клеток по рангу, поэтому оба ребра хранятся у неё
+//!
+//! \param from Начало ребра
+//! \param to Конец ребра
+//! \param middle Клетка сокращения (-1 для ребра сетки)
+//! \param cells Вектор, в который добавляются клетки после from до to включительно
+//!
+void ContractionHierarchy::unpack(int from, int to, int middle, QVector<int>& cells) const {
+    if (middle == -1) {
+        cells.append(to);
+        return;
+    }
+    const Arc* head = arc(downFirst, down, middle, from);
+    const Arc* tail = arc(upFirst, up, middle, to);
+    if (head == 0 || tail == 0 || rank[middle] >= rank[from] || rank[middle] >= rank[to]) return;
+    unpack(from, middle, head->middle, cells);
+    unpack(middle, to, tail->middle, cells);
+}
+
+//!
+//! Сохранить иерархию в файл
+//!
+//! \param path Путь до файла
+//! \return 0 в случае успеха
+//! \return -1 если произошла ошибка
+//!
+int ContractionHierarchy::save(const QString& path) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return -1;
+    QDataStream stream(&file);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream << fileMagic << fileVersion << (qint32)cols << (qint32)rows << fingerprint;
+    stream << rank << upFirst << downFirst << up << down;
+    return stream.status() == QDataStream::Ok ? 0 : -1;
+}
+
+//!
+//! Загрузить иерархию из файла
+//!
+//! \param path Путь до файла
+//! \param fingerprint Отпечаток текущей сетки (`ContractionHierarchy::fingerprintOf`)
+//! \return Иерархия или nullptr, если файла нет, он повреждён или построен для другой сетки
+//!
+QSharedPointer<const ContractionHierarchy> ContractionHierarchy::load(const QString& path, const QByteArray& fingerprint) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return QSharedPointer<const ContractionHierarchy>();
+    QDataStream stream(&file);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    quint32 magic = 0, version = 0;
+    qint32 cols = 0, rows = 0;
+    stream >> magic >> version;
+    if (magic != fileMagic || version != fileVersion) return QSharedPointer<const ContractionHierarchy>();
+
+    QSharedPointer<ContractionHierarchy> result(new ContractionHierarchy());
+    stream >> cols >> rows >> result->fingerprint;
+    if (stream.status() != QDataStream::Ok || result->fingerprint != fingerprint) return QSharedPointer<const ContractionHierarchy>();
+    stream >> result->rank >> result->upFirst >> result->downFirst >> result->up >> result->down;
+    if (stream.status() != QDataStream::Ok) return QSharedPointer<const ContractionHierarchy>();
+
+    // Повреждённый файл не должен приводить к выходу за границы при запросах
+    int n = cols * rows;
+    bool valid = cols > 0 && rows > 0 && result->rank.size() == n
+        && result->upFirst.size() == n + 1 && result->downFirst.size() == n + 1
+        && result->upFirst.first() == 0 && result->upFirst.last() == result->up.size()
+        && result->downFirst.first() == 0 && result->downFirst.last() == result->down.size();
+    for (int k = 0; valid && k < n; k++) {
+        valid = result->upFirst[k] <= result->upFirst[k + 1] && result->downFirst[k] <= result->downFirst[k + 1];
+    }
+    for (int k = 0; valid && k < result->up.size(); k++) {
+        valid = result->up[k].target >= 0 && result->up[k].target < n && result->up[k].middle >= -1 && result->up[k].middle < n;
+    }
+    for (int k = 0; valid && k < result->down.size(); k++) {
+        valid = result->down[k].target >= 0 && result->down[k].target < n && result->down[k].middle >= -1 && result->down[k].middle < n;
+    }
+    if (!valid) return QSharedPointer<const ContractionHierarchy>();
+    result->cols = cols;
+    result->rows = rows;
+    return result;
+}
@@ -0,0 +1,40 @@
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+#include <QSharedPointer>
+
+class ContractionHierarchy {
+public:
+    static constexpr quint32 fileMagic = 0x43485046; // "CHPF"
+    static constexpr quint32 fileVersion = 1;
+    static constexpr const char* fileSuffix = ".ch";
+    static constexpr int witnessSettled = 500;
+
+    struct Arc {
+        int target;
+        float cost;
+        int middle;
+    };
+
+    int cols = 0, rows = 0;
+    QByteArray fingerprint;
+    QVector<int> rank;
+    QVector<int> upFirst, downFirst;
+    QVector<Arc> up, down;
+
+    float query(int source, int target, QVector<int>& cells) const;
+    int save(const QString& path) const;
+
+    static QByteArray fingerprintOf(const QVector<double>& factors, int cols, int rows);
+    static QSharedPointer<const ContractionHierarchy> build(const QVector<double>& factors, int cols, int rows);
+    static QSharedPointer<const ContractionHierarchy> load(const QString& path, const QByteArray& fingerprint);
+
+protected:
+    const Arc* arc(const QVector<int>& first, const QVector<Arc>& arcs, int from, int target) const;
+    void unpack(int from, int to, int middle, QVector<int>& cells) const;
+};
+
+#endif // HIERARCHY_H
@@ -0,0 +1,182 @@
+//!
+//! Ориентиры (landmarks) для эвристики ALT.
+//! Для K выбранных клеток хранятся точные стоимости путей от ориентира до каждой клетки и обратно,
+//! а по неравенству треугольника из них получается нижняя оценка стоимости пути между любыми двумя клетками
+//!
+
+#include <QtConcurrent>
+#include "landmarks.h"
+#include "prioqueue.h"
+
+static const QPoint offsets[4] = { QPoint(0, 1), QPoint(0, -1), QPoint(-1, 0), QPoint(1, 0) };
+
+//!
+//! Алгоритм Дейкстры по компактной сетке
+//! Стоимость шага как в `Field::aStarPath`: 1 + непроходимость клетки, в которую выполняется шаг
+//!
+//! \param walkness Непроходимость клеток
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//! \param source Клетка-источник
+//! \param reverse false -- стоимости от источника до клеток, true -- от клеток до источника
+//! \param dist Вектор для сохранения стоимостей (-1 для недостижимых клеток)
+//!
+static void dijkstra(const QVector<float>& walkness, int cols, int rows, int source, bool reverse, QVector<float>& dist) {
+    dist.fill(-1.f, cols * rows);
+    PriorityQueue<int, float> queue;
+    dist[source] = 0.f;
+    queue.put(source, 0.f);
+
+    while (!queue.empty()) {
+        int current = queue.get();
+        QPoint c(current / rows, current % rows);
+        for (const QPoint& offset : offsets) {
+            QPoint n = c + offset;
+            if (n.x() < 0 || n.y() < 0 || n.x() >= cols || n.y() >= rows) continue;
+            int next = n.x() * rows + n.y();
+            if (walkness[next] >= 1.f) continue;
+            float cost = dist[current] + 1.f + (reverse ? walkness[current] : walkness[next]);
+            if (dist[next] < 0 || cost < dist[next]) {
+                dist[next] = cost;
+                queue.put(next, cost);
+            }
+        }
+    }
+}
+
+//!
+//! Нижняя оценка стоимости пути из клетки до цели
+//! max по ориентирам L от d(L, цель) - d(L, клетка) и d(клетка, L) - d(цель, L)
+//!
+//! \param cell Индекс клетки
+//! \param target Индекс цели
+//! \return Оценка (0 если ориентиры не покрывают клетки)
+//!
+float LandmarkTables::bound(int cell, int target) const {
+    float best = 0.f;
+    const float* fc = from.constData() + cell * Landmarks::count;
+    const float* ft = from.constData() + target * Landmarks::count;
+    const float* tc = to.constData() + cell * Landmarks::count;
+    const float* tt = to.constData() + target * Landmarks::count;
+    for (int k = 0; k < points.size(); k++) {
+        if (fc[k] >= 0 && ft[k] >= 0) best = qMax(best, ft[k] - fc[k]);
+        if (tc[k] >= 0 && tt[k] >= 0) best = qMax(best, tc[k] - tt[k]);
+    }
+    return best;
+}
+
+Landmarks::~Landmarks() {
+    if (building) {
+        cancelled->storeRelaxed(1);
+        pending.waitForFinished();
+    }
+}
+
+//!
+//! Запустить перестроение таблиц ориентиров в фоновом потоке
+//! Непроходимость копируется из сетки сразу, поэтому сетку можно менять, пока идёт перестроение.
+//! Незавершённое предыдущее перестроение отменяется
+//!
+//! \param mesh Сетка
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//! \param revision Ревизия сетки
+//!
+void Landmarks::rebuild(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, unsigned revision) {
+    if (building) cancelled->storeRelaxed(1);
+
+    QVector<float> walkness(cols * rows, 1.f);
+    for (auto it = mesh.constBegin(); it != mesh.constEnd(); ++it) {
+        const QPoint& p = it.key();
+        if (p.x() < cols && p.y() < rows) walkness[p.x() * rows + p.y()] = it.value().walkness;
+    }
+
+    cancelled = QSharedPointer<QAtomicInt>::create(0);
+    pending = QtConcurrent::run(&Landmarks::compute, walkness, cols, rows, revision, cancelled);
+    building = true;
+}
+
+//!
+//! Дождаться окончания фонового построения таблиц
+//!
+void Landmarks::wait() {
+    if (building) pending.waitForFinished();
+}
+
+//!
+//! Получить таблицы ориентиров для ревизии сетки
+//!
+//! \param revision Ревизия сетки
+//! \return Таблицы или nullptr, если они ещё строятся или устарели
+//!
+QSharedPointer<const LandmarkTables> Landmarks::tables(unsigned revision) {
+    if (building && pending.isFinished()) {
+        QSharedPointer<const LandmarkTables> result = pending.result();
+        if (!result.isNull()) current = result;
+        building = false;
+    }
+    if (!current.isNull() && current->revision == revision) return current;
+    return QSharedPointer<const LandmarkTables>();
+}
+
+//!
+//! Фоновое построение таблиц, запущенное последним `Landmarks::rebuild`
+//! Снимки карты держат его и берут таблицы, как только построение закончится (см. `MapSnapshot::landmarkTables`)
+//!
+QFuture<QSharedPointer<const LandmarkTables>> Landmarks::future() const {
+    return pending;
+}
+
+//!
+//! Построить таблицы ориентиров
+//! Ориентиры выбираются жадно: первый -- самая дальняя клетка от произвольной проходимой,
+//! каждый следующий -- клетка, наиболее удалённая от уже выбранных
+//!
+//! \param walkness Непроходимость клеток
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//! \param revision Ревизия сетки
+//! \param cancelled Флаг отмены
+//! \return Таблицы или nullptr если построение отменено
+//!
+QSharedPointer<const LandmarkTables> Landmarks::compute(QVector<float> walkness, int cols, int rows, unsigned revision, QSharedPointer<QAtomicInt> cancelled) {
+    QSharedPointer<LandmarkTables> tables = QSharedPointer<LandmarkTables>::create();
+    tables->revision = revision;
+    tables->cols = cols;
+    tables->rows = rows;
+    int n = cols * rows;
+    tables->from.fill(-1.f, n * count);
+    tables->to.fill(-1.f, n * count);
+
+    int seed = -1;
+    for (int i = 0; i < n && seed == -1; i++) {
+        if (walkness[i] < 1.f) seed = i;
+    }
+    if (seed == -1) return tables;
+
+    QVector<float> dist;
+    QVector<float> nearest;
+    dijkstra(walkness, cols, rows, seed, false, nearest);
+
+    for (int k = 0; k < count; k++) {
+        if (cancelled->loadRelaxed()) return QSharedPointer<const LandmarkTables>();
+
+        int landmark = -1;
+        for (int i = 0; i < n; i++) {
+            if (nearest[i] > 0 && (landmark == -1 || nearest[i] > nearest[landmark])) landmark = i;
+        }
+        if (landmark == -1) break;
+        tables->points.append(QPoint(landmark / rows, landmark % rows));
+
+        dijkstra(walkness, cols, rows, landmark, false, dist);
+        for (int i = 0; i < n; i++) {
+            tables->from[i * count + k] = dist[i];
+            if (k == 0 || (dist[i] >= 0 && dist[i] < nearest[i])) nearest[i] = dist[i];
+        }
+
+        dijkstra(walkness, cols, rows, landmark, true, dist);
+        for (int i = 0; i < n; i++) tables->to[i * count + k] = dist[i];
+    }
+
+    return tables;
+}
@@ -0,0 +1,42 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <QVector>
+#include <QHash>
+#include <QPoint>
+#include <QFuture>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include "meshpoint.h"
+
+struct LandmarkTables {
+    unsigned revision = 0;
+    int cols = 0, rows = 0;
+    QVector<QPoint> points;
+    QVector<float> from;
+    QVector<float> to;
+
+    float bound(int cell, int target) const;
+};
+
+class Landmarks {
+public:
+    static constexpr int count = 8;
+
+    ~Landmarks();
+
+    void rebuild(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, unsigned revision);
+    QSharedPointer<const LandmarkTables> tables(unsigned revision);
+    QFuture<QSharedPointer<const LandmarkTables>> future() const;
+    void wait();
+
+    static QSharedPointer<const LandmarkTables> compute(QVector<float> walkness, int cols, int rows, unsigned revision, QSharedPointer<QAtomicInt> cancelled);
+
+protected:
+    QSharedPointer<const LandmarkTables> current;
+    QFuture<QSharedPointer<const LandmarkTables>> pending;
+    QSharedPointer<QAtomicInt> cancelled;
+    bool building = false;
+};
+
+#endif // LANDMARKS_H
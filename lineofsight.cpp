@@ -0,0 +1,348 @@
+//!
+//! Проверка прямой видимости по растру сетки.
+//! Отрезок проходится по клеткам сетки методом DDA (Amanatides-Woo) с захватом обеих клеток
+//! при проходе через угол, поэтому время ответа пропорционально длине отрезка, а не количеству препятствий.
+//! Клетка растра с индексом (i, j) -- это область карты, ближайшая к узлу сетки (i * cellSize, j * cellSize),
+//! как и в `Field::nearestMesh`
+//!
+
+#include <limits>
+#include "lineofsight.h"
+#include "utils.h"
+
+//!
+//! Буферы вытягивания пути: коридор клеток и две цепочки воронки (свои у каждого потока, см. `LineOfSight::pull`)
+//!
+struct Funnel {
+    QVector<QPoint> corridor;
+    QVector<QPointF> entries, left, right;
+};
+
+static thread_local Funnel funnel;
+
+//!
+//! Построить растр непроходимости по сетке
+//!
+//! \param mesh Сетка
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//! \param cellSize Размер ячейки сетки
+//!
+void LineOfSight::build(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, int cellSize) {
+    this->cols = cols;
+    this->rows = rows;
+    this->cellSize = cellSize;
+    walkness.fill(1.f, cols * rows);
+    for (auto it = mesh.constBegin(); it != mesh.constEnd(); ++it) {
+        const QPoint& p = it.key();
+        if (p.x() < cols && p.y() < rows) walkness[p.x() * rows + p.y()] = it.value().walkness;
+    }
+}
+
+//!
+//! Сбросить растр
+//!
+void LineOfSight::clear() {
+    cols = rows = 0;
+    walkness.clear();
+    clearance.clear();
+}
+
+//!
+//! Задать расстояния до стен для проверок с радиусом агента (см. `ClearanceMap`)
+//!
+//! \param distances Расстояния в клетках (индекс `i * rows + j`)
+//!
+void LineOfSight::setClearance(const QVector<float>& distances) {
+    clearance = distances;
+}
+
+//!
+//! Проход отрезка по клеткам растра
+//! Для каждой клетки вызывается visit(индекс клетки, t входа, t выхода), где t -- параметр на отрезке [0; 1].
+//! Если visit возвращает false, проход прекращается
+//!
+//! \param line Отрезок (в координатах карты)
+//! \param visit Функция обработки клетки
+//!
+template<typename Visit>
+void LineOfSight::traverse(const QLine& line, Visit visit) const {
+    if (walkness.isEmpty()) return;
+    const double inf = std::numeric_limits<double>::infinity();
+    const double epsilon = 1e-9;
+
+    double x0 = (double)line.x1() / cellSize + 0.5;
+    double y0 = (double)line.y1() / cellSize + 0.5;
+    double dx = (double)line.x2() / cellSize + 0.5 - x0;
+    double dy = (double)line.y2() / cellSize + 0.5 - y0;
+
+    int i = qFloor(x0);
+    int j = qFloor(y0);
+    int iEnd = qFloor(x0 + dx);
+    int jEnd = qFloor(y0 + dy);
+    int stepX = dx > 0 ? 1 : (dx < 0 ? -1 : 0);
+    int stepY = dy > 0 ? 1 : (dy < 0 ? -1 : 0);
+    double tDeltaX = stepX != 0 ? 1. / qAbs(dx) : inf;
+    double tDeltaY = stepY != 0 ? 1. / qAbs(dy) : inf;
+    double tMaxX = stepX > 0 ? (i + 1 - x0) / dx : (stepX < 0 ? (x0 - i) / -dx : inf);
+    double tMaxY = stepY > 0 ? (j + 1 - y0) / dy : (stepY < 0 ? (y0 - j) / -dy : inf);
+
+    double t = 0.;
+    while (true) {
+        double tNext = qMin(qMin(tMaxX, tMaxY), 1.);
+        if (!visit(cellIndex(i, j), t, tNext)) return;
+        if (tNext >= 1.) {
+            if (i != iEnd || j != jEnd) visit(cellIndex(iEnd, jEnd), 1., 1.);
+            return;
+        }
+
+        if (tMaxX < tMaxY - epsilon) {
+            i += stepX;
+            t = tMaxX;
+            tMaxX += tDeltaX;
+        } else if (tMaxY < tMaxX - epsilon) {
+            j += stepY;
+            t = tMaxY;
+            tMaxY += tDeltaY;
+        } else {
+            if (!visit(cellIndex(i + stepX, j), tMaxX, tMaxX)) return;
+            if (!visit(cellIndex(i, j + stepY), tMaxX, tMaxX)) return;
+            i += stepX;
+            j += stepY;
+            t = tMaxX;
+            tMaxX += tDeltaX;
+            tMaxY += tDeltaY;
+        }
+    }
+}
+
+//!
+//! Проверка, что отрезок не выходит из одного класса непроходимости
+//! Все клетки, которые задевает отрезок, должны иметь ту же непроходимость, что и клетка начала отрезка, и не быть стенами
+//! (отрезок из угла клетки, как вершины `LineOfSight::pull`, может начинаться в клетке стены).
+//! Если задан радиус агента, в каждой клетке расстояние до стены должно быть больше радиуса
+//!
+//! \param line Отрезок
+//! \param radius Радиус агента в клетках сетки (0 -- точечный агент)
+//! \return Отрезок лежит в одном классе непроходимости или нет
+//!
+bool LineOfSight::uniform(const QLine& line, float radius) const {
+    bool result = true;
+    float reference = -1.f;
+    bool sized = radius > 0.f && clearance.size() == walkness.size();
+    traverse(line, [&](int cell, double, double) {
+        if (reference < 0) reference = walkness[cell];
+        else if (walkness[cell] != reference) result = false;
+        if (walkness[cell] >= 1.f) result = false;
+        if (sized && clearance[cell] <= radius) result = false;
+        return result;
+    });
+    return result;
+}
+
+//!
+//! Стоимость прохода по отрезку
+//! Считается в тех же единицах, что и стоимость пути в `Field::aStarPath`:
+//! длина в ячейках сетки, умноженная на (1 + непроходимость) каждой пройденной клетки
+//!
+//! \param line Отрезок
+//! \return Стоимость или -1 если отрезок проходит через стену
+//!
+double LineOfSight::cost(const QLine& line) const {
+    double length = euclideanDistance(line.p1(), line.p2()) / cellSize;
+    double total = 0.;
+    traverse(line, [&](int cell, double t0, double t1) {
+        if (walkness[cell] >= 1.f) {
+            total = -1.;
+            return false;
+        }
+        total += (t1 - t0) * length * (1. + walkness[cell]);
+        return true;
+    });
+    return total;
+}
+
+//!
+//! Сглаживание пути на месте
+//! Линейный проход: точка остаётся в пути, только если из последней оставленной точки не видна следующая за ней
+//! (`LineOfSight::uniform`). Оставленные точки записываются поверх исходного вектора, без выделения памяти
+//!
+//! \param vec Путь, который необходимо сгладить.
+//! \param radius Радиус агента в клетках сетки (см. `LineOfSight::uniform`)
+//!
+void LineOfSight::smooth(QVector<MeshPoint>& vec, float radius) const {
+    int n = vec.length();
+    if (n < 3) return;
+    int kept = 1;
+    int curr = 0;
+    QPoint anchor = vec[0].realCoord;
+    for (int i = 1; i < n; ++i) {
+        if (i - 1 != curr && !uniform(QLine(anchor, vec[i].realCoord), radius)) {
+            curr = i - 1;
+            anchor = vec[curr].realCoord;
+            vec[kept++] = vec[curr];
+        }
+    }
+    vec[kept++] = vec[n - 1];
+    vec.resize(kept);
+}
+
+//!
+//! Вытягивание пути (funnel algorithm)
+//! Клетки растра, которые задевают отрезки пути, образуют коридор; после `LineOfSight::smooth` каждый отрезок
+//! лежит в одном классе непроходимости, поэтому коридор проходим целиком. Порталы коридора -- общие стороны
+//! соседних клеток; путь натягивается от старта через все порталы по порядку, вершинами результата становятся
+//! только углы клеток, которые он огибает. Там, где соседние клетки коридора разной непроходимости, путь проходит
+//! через ту же точку, что и исходный, чтобы каждый отрезок оставался в одном классе. Воронка хранит две вогнутые цепочки от текущей вершины (левую и правую),
+//! каждый угол входит в цепочку и покидает её не больше одного раза, поэтому время линейно по длине пути в клетках.
+//! Натянутый путь лежит в том же коридоре, что и исходный, и не длиннее его
+//!
+//! \param vec Путь (соседние точки соединены отрезками прямой видимости)
+//! \param result Вектор для сохранения пути (очищается, ёмкость сохраняется)
+//!
+void LineOfSight::pull(const QVector<MeshPoint>& vec, QVector<MeshPoint>& result) const {
+    result.clear();
+    if (vec.length() < 3 || walkness.isEmpty()) {
+        result.append(vec);
+        return;
+    }
+
+    QVector<QPoint>& corridor = funnel.corridor;
+    QVector<QPointF>& entries = funnel.entries;
+    corridor.clear();
+    entries.clear();
+    auto extend = [&](const QPoint& cell, const QPointF& entry) {
+        int n = corridor.size();
+        if (n > 0 && corridor[n - 1] == cell) return;
+        // Возврат в предпоследнюю клетку (острый угол пути) -- петля, коридор её не содержит
+        if (n > 1 && corridor[n - 2] == cell) {
+            corridor.removeLast();
+            entries.removeLast();
+            return;
+        }
+        // Порталы -- стороны клеток, поэтому переход по диагонали идёт через общего соседа, который не стена
+        // (отрезок, проходящий через угол между двумя стенами, `LineOfSight::uniform` не пропускает)
+        if (n > 0 && corridor[n - 1].x() != cell.x() && corridor[n - 1].y() != cell.y()) {
+            QPoint across(cell.x(), corridor[n - 1].y());
+            QPoint along(corridor[n - 1].x(), cell.y());
+            bool open = walkness[across.x() * rows + across.y()] <= walkness[along.x() * rows + along.y()];
+            corridor.append(open ? across : along);
+            entries.append(entry);
+        }
+        corridor.append(cell);
+        entries.append(entry);
+    };
+    auto border = [this](int coord) {
+        double v = (double)coord / cellSize + 0.5;
+        return v == qFloor(v);
+    };
+    for (int k = 1; k < vec.length(); k++) {
+        const QPoint& a = vec[k-1].realCoord;
+        const QPoint& b = vec[k].realCoord;
+        // Отрезок вдоль стороны клеток (вершины вытянутого пути -- углы клеток) `LineOfSight::traverse` относит
+        // к клеткам с большей координатой; если там стена, отрезок идёт по клеткам с другой стороны
+        QPoint shift;
+        if (a.y() == b.y() && border(a.y())) shift = QPoint(0, 1);
+        else if (a.x() == b.x() && border(a.x())) shift = QPoint(1, 0);
+        traverse(QLine(a, b), [&](int index, double t0, double t1) {
+            // Клетки, которых отрезок касается только углом, в коридор не входят
+            if (t0 < t1) {
+                QPointF entry = a + QPointF(b - a) * t0;
+                extend(QPoint(index / rows, index % rows) - (walkness[index] >= 1.f ? shift : QPoint()), entry);
+            }
+            return true;
+        });
+    }
+
+    auto cross = [](const QPointF& a, const QPointF& b, const QPointF& c) {
+        return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+    };
+    QVector<QPointF>& left = funnel.left;
+    QVector<QPointF>& right = funnel.right;
+    left.clear();
+    right.clear();
+    left.append(vec[0].realCoord);
+    right.append(vec[0].realCoord);
+    int leftApex = 0, rightApex = 0;
+    result.append(vec[0]);
+
+    // Новая точка левой стороны: если она зашла за правую цепочку, вершина пути сдвигается по правой цепочке,
+    // иначе с конца левой цепочки снимаются точки, которые перестали быть углами
+    auto addLeft = [&](const QPointF& point) {
+        if (left.last() == point) return;
+        int apex = rightApex;
+        while (right.size() - rightApex > 1 && cross(right[rightApex], right[rightApex + 1], point) < 0) {
+            rightApex++;
+            result.append(MeshPoint(QPoint(-1, -1), right[rightApex].toPoint(), 0));
+        }
+        if (rightApex != apex) {
+            left.clear();
+            left.append(right[rightApex]);
+            leftApex = 0;
+        }
+        while (left.size() - leftApex > 1 && cross(left[left.size() - 2], left.last(), point) <= 0) left.removeLast();
+        left.append(point);
+    };
+    auto addRight = [&](const QPointF& point) {
+        if (right.last() == point) return;
+        int apex = leftApex;
+        while (left.size() - leftApex > 1 && cross(left[leftApex], left[leftApex + 1], point) > 0) {
+            leftApex++;
+            result.append(MeshPoint(QPoint(-1, -1), left[leftApex].toPoint(), 0));
+        }
+        if (leftApex != apex) {
+            right.clear();
+            right.append(left[leftApex]);
+            rightApex = 0;
+        }
+        while (right.size() - rightApex > 1 && cross(right[right.size() - 2], right.last(), point) >= 0) right.removeLast();
+        right.append(point);
+    };
+
+    // Воронка стягивается в точку, путь проходит через неё, и натягивание начинается заново
+    auto close = [&](const QPointF& point) {
+        addLeft(point);
+        addRight(point);
+        left.clear();
+        right.clear();
+        left.append(point);
+        right.append(point);
+        leftApex = rightApex = 0;
+    };
+
+    for (int k = 1; k < corridor.size(); k++) {
+        const QPoint& from = corridor[k - 1];
+        const QPoint& to = corridor[k];
+        // Срезая угол, путь прошёл бы по клеткам другой непроходимости, поэтому на границе классов
+        // он проходит там же, где исходный
+        if (walkness[from.x() * rows + from.y()] != walkness[to.x() * rows + to.y()]) {
+            QPointF entry = entries[k];
+            close(entry);
+            if (result.last().realCoord != entry.toPoint()) result.append(MeshPoint(QPoint(-1, -1), entry.toPoint(), 0));
+            continue;
+        }
+        QPointF middle((from.x() + to.x()) * cellSize / 2., (from.y() + to.y()) * cellSize / 2.);
+        QPointF side((from.y() - to.y()) * cellSize / 2., (to.x() - from.x()) * cellSize / 2.);
+        addLeft(middle + side);
+        addRight(middle - side);
+    }
+    close(vec.last().realCoord);
+    result.append(vec.last());
+}
+
+//!
+//! Непроходимость растра в точке карты
+//!
+double LineOfSight::walknessAt(const QPoint& point) const {
+    if (walkness.isEmpty()) return 1.;
+    return walkness[cellIndex(qFloor((double)point.x() / cellSize + 0.5), qFloor((double)point.y() / cellSize + 0.5))];
+}
+
+//!
+//! Индекс клетки растра; координаты за пределами сетки прижимаются к её краю
+//!
+int LineOfSight::cellIndex(int i, int j) const {
+    i = qBound(0, i, cols - 1);
+    j = qBound(0, j, rows - 1);
+    return i * rows + j;
+}
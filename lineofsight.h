@@ -0,0 +1,36 @@
+#ifndef LINEOFSIGHT_H
+#define LINEOFSIGHT_H
+
+#include <QVector>
+#include <QHash>
+#include <QLine>
+#include "meshpoint.h"
+
+class LineOfSight {
+public:
+    //! Сколько раз путь вытягивается при обработке (`Field::refinePath`, `MapSnapshot::refine`)
+    static constexpr int pullPasses = 3;
+
+    void build(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, int cellSize);
+    void clear();
+    void setClearance(const QVector<float>& distances);
+
+    bool uniform(const QLine& line, float radius = 0.f) const;
+    double cost(const QLine& line) const;
+    double walknessAt(const QPoint& point) const;
+
+    void smooth(QVector<MeshPoint>& vec, float radius = 0.f) const;
+    void pull(const QVector<MeshPoint>& vec, QVector<MeshPoint>& result) const;
+
+protected:
+    int cols = 0, rows = 0;
+    int cellSize = 1;
+    QVector<float> walkness;
+    QVector<float> clearance;
+
+    template<typename Visit>
+    void traverse(const QLine& line, Visit visit) const;
+    int cellIndex(int i, int j) const;
+};
+
+#endif // LINEOFSIGHT_H
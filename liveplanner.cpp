@@ -0,0 +1,246 @@
+//!
+//! Предпросмотр пути при перетаскивании вершины препятствия.
+//! Инкрементальный поиск LPA* (Lifelong Planning A*): между запросами сохраняются стоимости g и их
+//! одношаговые оценки rhs, поэтому после изменения нескольких клеток пересчитываются только клетки,
+//! чья стоимость от этого поменялась, а не вся карта.
+//! Изменения приходят из потока интерфейса (`LivePlanner::patch`), поиск идёт в фоновом потоке
+//! порциями ограниченного времени (`LivePlanner::step`) и может прерываться и продолжаться
+//! между кадрами -- LPA* останавливается в любом состоянии очереди.
+//! Стоимость шага та же, что и в `Field::aStarPath`: 1 + непроходимость клетки, в которую идём
+//!
+
+#include <algorithm>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "liveplanner.h"
+
+static const double infinity = std::numeric_limits<double>::infinity();
+
+//!
+//! Начать поиск заново
+//! Вызывается из потока интерфейса, сам сброс выполнится в следующем `LivePlanner::step`
+//!
+//! \param factors Непроходимость всех клеток сетки (индекс `i * rows + j`)
+//! \param dims Размеры сетки
+//! \param start Начальная клетка
+//! \param goal Конечная клетка
+//! \param revision Ревизия препятствий, которой соответствует непроходимость
+//!
+void LivePlanner::reset(const QVector<double>& factors, const QSize& dims, const QPoint& start, const QPoint& goal, unsigned revision) {
+    QMutexLocker locker(&mutex);
+    this->dims = dims;
+    this->start = start;
+    this->goal = goal;
+    this->revision = revision;
+    configured = true;
+    resetPending = true;
+    nextFactors = factors;
+    patches.clear();
+}
+
+//!
+//! Состояние поиска построено для той же сетки, тех же точек и той же ревизии препятствий,
+//! и его можно продолжать изменениями вместо полного сброса
+//!
+bool LivePlanner::matches(const QSize& dims, const QPoint& start, const QPoint& goal, unsigned revision) const {
+    return configured && this->dims == dims && this->start == start && this->goal == goal && this->revision == revision;
+}
+
+//!
+//! Забыть состояние поиска: следующий `LivePlanner::matches` вернёт false
+//! Используется при замене поля, у нового поля ревизии препятствий начинаются заново
+//!
+void LivePlanner::invalidate() {
+    configured = false;
+}
+
+//!
+//! Передать изменение непроходимости прямоугольника клеток
+//! Вызывается из потока интерфейса
+//!
+//! \param cells Прямоугольник клеток сетки
+//! \param factors Новая непроходимость клеток (индекс `(i - left) * height + (j - top)`)
+//!
+void LivePlanner::patch(const QRect& cells, const QVector<double>& factors) {
+    QMutexLocker locker(&mutex);
+    patches.append({ cells, factors });
+}
+
+//!
+//! Порция поиска в фоновом потоке
+//! Применяет накопленные изменения и продолжает поиск, пока не кончится время.
+//! Если поиск сошёлся, путь публикуется для `LivePlanner::result`
+//!
+//! \param budget Время на порцию в миллисекундах
+//! \return Поиск сошёлся и новых изменений не поступило
+//!
+bool LivePlanner::step(int budget) {
+    QElapsedTimer timer;
+    timer.start();
+
+    bool fresh;
+    QVector<double> factors;
+    QVector<Patch> changes;
+    QSize size;
+    QPoint from, to;
+    {
+        QMutexLocker locker(&mutex);
+        fresh = resetPending;
+        resetPending = false;
+        factors.swap(nextFactors);
+        changes.swap(patches);
+        size = dims;
+        from = start;
+        to = goal;
+    }
+
+    if (fresh && factors.size() == size.width() * size.height()) {
+        cols = size.width();
+        rows = size.height();
+        walkness = factors;
+        g.fill(infinity, cols * rows);
+        rhs.fill(infinity, cols * rows);
+        queue = PriorityQueue<int, Key>();
+        startIndex = from.x() * rows + from.y();
+        goalIndex = to.x() * rows + to.y();
+        updateVertex(startIndex);
+    }
+    if (startIndex == -1) return true;
+    for (const Patch& change : changes) apply(change);
+
+    int count = 0;
+    bool converged = false;
+    int around[4];
+    while (true) {
+        // Устаревшие записи очереди (клетка уже согласована или ключ изменился) пропускаются
+        while (!queue.empty()) {
+            int top = queue.top().second;
+            if (g[top] != rhs[top] && key(top) == queue.top().first) break;
+            queue.get();
+        }
+        if (queue.empty() || (!(queue.top().first < key(goalIndex)) && rhs[goalIndex] == g[goalIndex])) {
+            converged = true;
+            break;
+        }
+        if (++count % deadlineCheck == 0 && timer.elapsed() >= budget) break;
+
+        int u = queue.get();
+        int n = neighbours(u, around);
+        if (g[u] > rhs[u]) {
+            g[u] = rhs[u];
+            for (int k = 0; k < n; k++) updateVertex(around[k]);
+        } else {
+            g[u] = infinity;
+            updateVertex(u);
+            for (int k = 0; k < n; k++) updateVertex(around[k]);
+        }
+    }
+    if (!converged) return false;
+
+    QVector<QPoint> cells = extract();
+    QMutexLocker locker(&mutex);
+    path.swap(cells);
+    sequence++;
+    qInfo() << "LivePlanner::step" << "Converged in" << timer.elapsed() << "ms" << "Path" << path.size();
+    return !resetPending && patches.isEmpty();
+}
+
+//!
+//! Последний найденный путь
+//!
+//! \param cells Вектор для сохранения клеток пути от старта к финишу (пустой, если пути нет)
+//! \return Номер результата, растёт с каждым новым путём (0 -- путь ещё не найден)
+//!
+quint64 LivePlanner::result(QVector<QPoint>& cells) const {
+    QMutexLocker locker(&mutex);
+    cells = path;
+    return sequence;
+}
+
+//!
+//! Применить изменение непроходимости
+//! Меняется стоимость входа в клетку, поэтому пересчитывается только rhs самой клетки,
+//! соседи пересчитаются, когда до клетки дойдёт очередь
+//!
+void LivePlanner::apply(const Patch& change) {
+    int height = change.cells.height();
+    for (int i = qMax(0, change.cells.left()); i <= qMin(cols - 1, change.cells.right()); i++) {
+        for (int j = qMax(0, change.cells.top()); j <= qMin(rows - 1, change.cells.bottom()); j++) {
+            int cell = i * rows + j;
+            double w = change.factors[(i - change.cells.left()) * height + (j - change.cells.top())];
+            if (walkness[cell] == w) continue;
+            walkness[cell] = w;
+            updateVertex(cell);
+        }
+    }
+}
+
+void LivePlanner::updateVertex(int cell) {
+    if (cell == startIndex) {
+        rhs[cell] = walkness[cell] < 1. ? 0. : infinity;
+    } else {
+        double best = infinity;
+        double step = cost(cell);
+        if (step < infinity) {
+            int around[4];
+            int n = neighbours(cell, around);
+            for (int k = 0; k < n; k++) best = qMin(best, g[around[k]] + step);
+        }
+        rhs[cell] = best;
+    }
+    if (g[cell] != rhs[cell]) queue.put(cell, key(cell));
+}
+
+LivePlanner::Key LivePlanner::key(int cell) const {
+    double m = qMin(g[cell], rhs[cell]);
+    return Key(m + heuristic(cell), m);
+}
+
+//!
+//! Манхэттенское расстояние до финиша, согласованная эвристика: каждый шаг стоит не меньше 1
+//!
+double LivePlanner::heuristic(int cell) const {
+    return qAbs(cell / rows - goalIndex / rows) + qAbs(cell % rows - goalIndex % rows);
+}
+
+double LivePlanner::cost(int cell) const {
+    return walkness[cell] < 1. ? 1. + walkness[cell] : infinity;
+}
+
+int LivePlanner::neighbours(int cell, int* result) const {
+    int i = cell / rows, j = cell % rows, n = 0;
+    if (j + 1 < rows) result[n++] = cell + 1;
+    if (j > 0) result[n++] = cell - 1;
+    if (i > 0) result[n++] = cell - rows;
+    if (i + 1 < cols) result[n++] = cell + rows;
+    return n;
+}
+
+//!
+//! Восстановить путь от финиша к старту по наименьшим g соседей
+//!
+QVector<QPoint> LivePlanner::extract() const {
+    QVector<QPoint> cells;
+    if (g[goalIndex] == infinity) return cells;
+    int around[4];
+    for (int cell = goalIndex; ; ) {
+        cells.append(QPoint(cell / rows, cell % rows));
+        if (cell == startIndex) break;
+        if (cells.size() > cols * rows) {
+            cells.clear();
+            break;
+        }
+        int n = neighbours(cell, around);
+        int next = -1;
+        for (int k = 0; k < n; k++) {
+            if (next == -1 || g[around[k]] < g[next]) next = around[k];
+        }
+        if (next == -1 || g[next] == infinity) {
+            cells.clear();
+            break;
+        }
+        cell = next;
+    }
+    std::reverse(cells.begin(), cells.end());
+    return cells;
+}
@@ -0,0 +1,61 @@
+#ifndef LIVEPLANNER_H
+#define LIVEPLANNER_H
+
+#include <limits>
+#include <QVector>
+#include <QPoint>
+#include <QRect>
+#include <QSize>
+#include <QMutex>
+#include "prioqueue.h"
+
+class LivePlanner {
+public:
+    static constexpr int deadlineCheck = 256;
+
+    void reset(const QVector<double>& factors, const QSize& dims, const QPoint& start, const QPoint& goal, unsigned revision);
+    bool matches(const QSize& dims, const QPoint& start, const QPoint& goal, unsigned revision) const;
+    void invalidate();
+    void patch(const QRect& cells, const QVector<double>& factors);
+    bool step(int budget);
+    quint64 result(QVector<QPoint>& cells) const;
+
+protected:
+    typedef std::pair<double, double> Key;
+
+    struct Patch {
+        QRect cells;
+        QVector<double> factors;
+    };
+
+    // Состояние, которое задаёт поток интерфейса
+    QSize dims;
+    QPoint start, goal;
+    unsigned revision = 0;
+    bool configured = false;
+
+    // Передача данных между потоками
+    mutable QMutex mutex;
+    bool resetPending = false;
+    QVector<double> nextFactors;
+    QVector<Patch> patches;
+    QVector<QPoint> path;
+    quint64 sequence = 0;
+
+    // Состояние LPA*, с которым работает только поток поиска
+    int cols = 0, rows = 0;
+    int startIndex = -1, goalIndex = -1;
+    QVector<double> walkness;
+    QVector<double> g, rhs;
+    PriorityQueue<int, Key> queue;
+
+    void apply(const Patch& change);
+    void updateVertex(int cell);
+    Key key(int cell) const;
+    double heuristic(int cell) const;
+    double cost(int cell) const;
+    int neighbours(int cell, int* result) const;
+    QVector<QPoint> extract() const;
+};
+
+#endif // LIVEPLANNER_H
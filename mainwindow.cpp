@@ -3,6 +3,8 @@
 //!
 
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QDateTime>
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
@@ -21,6 +23,7 @@ MainWindow::MainWindow(QWidget *parent)
 
     connect(ui->btnStart, &QPushButton::clicked, this, &MainWindow::actionStart);
     connect(ui->btnFinish, &QPushButton::clicked, this, &MainWindow::actionEnd);
+    connect(ui->btnStops, &QPushButton::clicked, this, &MainWindow::actionStops);
     connect(ui->btnAdd, &QPushButton::clicked, this, &MainWindow::actionCreate);
     connect(ui->btnDelete, &QPushButton::clicked, this, &MainWindow::actionDelete);
     connect(ui->btnEdit, &QPushButton::clicked, this, &MainWindow::actionEdit);
@@ -42,11 +45,15 @@ void MainWindow::keyPressEvent(QKeyEvent* event) {
         debugKey = true;
         break;
     }
-    update();
 }
 
 void MainWindow::keyReleaseEvent(QKeyEvent* event) {
     Field* field = ui->widgetGraph->getField();
+    // Пока карта загружается, поле занято потоком загрузки: работает только отмена
+    if (ui->widgetGraph->isLoading() && event->key() != Qt::Key_D) {
+        if (event->key() == Qt::Key_Escape) ui->widgetGraph->cancelLoad();
+        return;
+    }
     switch (event->key()) {
         case Qt::Key_D:
             debugKey = false;
@@ -60,18 +67,18 @@ void MainWindow::keyReleaseEvent(QKeyEvent* event) {
                 field->dGridOutline = !field->dGridOutline;
                 statusUpdated(QString("Отладка: переключение границ сетки"));
             }
-            update();
+            ui->widgetGraph->update();
             break;
         case Qt::Key_O: // [O]bstacles
             if (!debugKey) break;
             field->dNoObstacles = !field->dNoObstacles;
-            update();
+            ui->widgetGraph->update();
             statusUpdated(QString("Отладка: переключение видимости препятствий"));
             break;
         case Qt::Key_P: // [P]ath
             if (!debugKey) break;
             field->dNoPath = !field->dNoPath;
-            update();
+            ui->widgetGraph->update();
             statusUpdated(QString("Отладка: переключение видимости путей"));
             break;
         case Qt::Key_Up: // Raise grid size
@@ -79,7 +86,7 @@ void MainWindow::keyReleaseEvent(QKeyEvent* event) {
             field->cellSize *= 2;
             if (!QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier)) {
                 field->regenMesh();
-                update();
+                ui->widgetGraph->update();
                 statusUpdated(QString("Отладка: увеличить разрешение сетки до %1").arg(field->cellSize));
             } else {
                 statusUpdated(QString("Отладка: увеличить разрешение сетки до %1 (без регенерации)").arg(field->cellSize));
@@ -90,7 +97,7 @@ void MainWindow::keyReleaseEvent(QKeyEvent* event) {
             if (field->cellSize != 2) field->cellSize /= 2;
             if (!QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier)) {
                 field->regenMesh();
-                update();
+                ui->widgetGraph->update();
                 statusUpdated(QString("Отладка: снизить разрешение сетки до %1").arg(field->cellSize));
             } else {
                 statusUpdated(QString("Отладка: снизить разрешение сетки до %1 (без регенерации)").arg(field->cellSize));
@@ -99,9 +106,94 @@ void MainWindow::keyReleaseEvent(QKeyEvent* event) {
         case Qt::Key_M: // [M]esh regen
             if (!debugKey) break;
             field->regenMesh();
-            update();
+            ui->widgetGraph->update();
             statusUpdated(QString("Отладка: переключение видимости путей"));
             break;
+        case Qt::Key_A: // [A]daptive mesh
+            if (!debugKey) break;
+            field->adaptiveMesh = !field->adaptiveMesh;
+            field->regenMesh();
+            ui->widgetGraph->update();
+            statusUpdated(QString("Отладка: адаптивная сетка %1").arg(field->adaptiveMesh ? "включена" : "выключена"));
+            break;
+        case Qt::Key_C: // [C]ooperative agents
+            if (!debugKey) break;
+            {
+                bool independent = QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier);
+                qint64 elapsed = independent ? field->routeAgents() : field->planAgents();
+                int solved = 0;
+                for (const Agent& agent : field->getAgents()) {
+                    if (agent.solved) solved++;
+                }
+                ui->widgetGraph->update();
+                statusUpdated(QString("Отладка: агенты%1 %2 из %3 за %4 мс").arg(independent ? " (без учёта столкновений)" : "")
+                              .arg(solved).arg(field->getAgents().size()).arg(elapsed));
+            }
+            break;
+        case Qt::Key_H: // Contraction [h]ierarchy
+            if (!debugKey) break;
+            {
+                qint64 elapsed = field->buildHierarchy();
+                statusUpdated(QString("Отладка: иерархия сжатия построена за %1 мс").arg(elapsed));
+            }
+            break;
+        case Qt::Key_R: // [R]ecord trace
+            if (!debugKey) break;
+            if (ui->widgetGraph->isTracing()) {
+                ui->widgetGraph->stopTrace();
+                statusUpdated(QString("Отладка: запись трассы остановлена"));
+            } else {
+                QString path = QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".trace";
+                if (ui->widgetGraph->startTrace(path)) statusUpdated(QString("Отладка: запись трассы в %1").arg(path));
+                else statusUpdated(QString("Отладка: не удалось открыть %1").arg(path));
+            }
+            break;
+        case Qt::Key_B: // Memory [b]udget
+            if (!debugKey) break;
+            {
+                bool ok;
+                int kib = QInputDialog::getInt(this, "Бюджет памяти", "Бюджет памяти поиска пути, КиБ (0 -- без ограничения):", field->searchBudget / 1024, 0, 1 << 20, 64, &ok);
+                if (!ok) break;
+                field->searchBudget = (qint64)kib * 1024;
+                statusUpdated(kib > 0 ? QString("Отладка: бюджет памяти поиска %1 КиБ").arg(kib) : QString("Отладка: бюджет памяти поиска снят"));
+            }
+            break;
+        case Qt::Key_T: // [T]ime limit
+            if (!debugKey) break;
+            {
+                bool ok;
+                int ms = QInputDialog::getInt(this, "Время поиска", "Время на поиск пути, мс (0 -- без ограничения):", field->searchDeadline, 0, 60000, 10, &ok);
+                if (!ok) break;
+                field->searchDeadline = ms;
+                statusUpdated(ms > 0 ? QString("Отладка: поиск пути за %1 мс (ARA*)").arg(ms) : QString("Отладка: ограничение времени поиска снято"));
+            }
+            break;
+        case Qt::Key_S: // Agent [s]ize
+            if (!debugKey) break;
+            {
+                bool ok;
+                int px = QInputDialog::getInt(this, "Размер агента", "Радиус агента, пикселей (0 -- точечный агент):", qRound(field->agentRadius), 0, 1000, 1, &ok);
+                if (!ok) break;
+                field->agentRadius = px;
+                statusUpdated(px > 0 ? QString("Отладка: радиус агента %1 пикс.").arg(px) : QString("Отладка: точечный агент"));
+            }
+            break;
+        case Qt::Key_K: // [K] alternatives
+            if (!debugKey) break;
+            {
+                bool ok;
+                int count = QInputDialog::getInt(this, "Альтернативные пути", "Сколько путей показывать (1 -- только кратчайший):", field->alternativeCount, 1, AlternativeRoutes::maxRoutes, 1, &ok);
+                if (!ok) break;
+                double diversity = field->alternativeDiversity;
+                if (count > 1) {
+                    diversity = QInputDialog::getDouble(this, "Альтернативные пути", "Доля пути, которая должна идти в стороне от остальных (0..1):", diversity, 0., 1., 2, &ok);
+                    if (!ok) break;
+                }
+                field->alternativeCount = count;
+                field->alternativeDiversity = diversity;
+                statusUpdated(count > 1 ? QString("Отладка: до %1 путей, непохожих на %2%").arg(count).arg(qRound(diversity * 100)) : QString("Отладка: только кратчайший путь"));
+            }
+            break;
         case Qt::Key_1: // [1] Walkness
             actionWalk();
             break;
@@ -120,8 +212,10 @@ void MainWindow::keyReleaseEvent(QKeyEvent* event) {
         case Qt::Key_6: // [6] End point
             actionEnd();
             break;
+        case Qt::Key_7: // [7] Route stops
+            actionStops();
+            break;
     }
-    ui->widgetGraph->update();
 }
 
 //!
@@ -237,6 +331,14 @@ void MainWindow::actionEnd() {
     ui->widgetGraph->setAction(CanvasAction::END);
 }
 
+//!
+//! Функция смены действия на установку промежуточных остановок маршрута.
+//! Вызывается кнопкой на форме или клавишей [7]
+//!
+void MainWindow::actionStops() {
+    ui->widgetGraph->setAction(CanvasAction::STOPS);
+}
+
 //!
 //! Функция изменения размеров карты.
 //! Вызывается кнопкой на форме справа снизу
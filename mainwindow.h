@@ -21,6 +21,7 @@ private slots:
     void actionWalk();
     void actionStart();
     void actionEnd();
+    void actionStops();
     void actionCreate();
     void actionDelete();
     void actionEdit();
@@ -0,0 +1,146 @@
+//!
+//! Журнал правок карты.
+//! Рядом с XML-файлом карты (`<карта>.journal`) дописываются правки, сделанные после его последней
+//! полной записи, поэтому частое сохранение стоит пропорционально изменениям, а не размеру карты.
+//! Правки пишутся в формате операций трассы (см. `tracerecorder.cpp`) без времени, по одной в строке.
+//! Первая строка -- заголовок с MD5 XML-файла, на который наложен журнал: если XML перезаписан
+//! в обход журнала, журнал не применяется. Когда правок набирается `MapJournal::compactEdits`,
+//! карта при сохранении снова пишется в XML целиком, а журнал начинается заново
+//!
+
+#include <QFile>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QDebug>
+#include "mapjournal.h"
+
+//!
+//! Запомнить операцию, если это правка карты
+//! Перетаскивание вершины пишет операцию на каждое движение мыши, поэтому подряд идущие перемещения
+//! одной и той же вершины схлопываются в последнее
+//!
+//! \param operation Операция с аргументами (как для `TraceRecorder::record`)
+//!
+void MapJournal::record(const QString& operation) {
+    if (base.isEmpty() || !isEdit(operation)) return;
+    if (operation.startsWith("move ") && !edits.isEmpty() && edits.last().startsWith("move ")) {
+        QStringList next = operation.split(' ');
+        QStringList last = edits.last().split(' ');
+        if (next.value(1) == last.value(1) && next.value(2) == last.value(2)) {
+            edits.last() = operation;
+            return;
+        }
+    }
+    edits.append(operation);
+}
+
+//!
+//! Привязать журнал к файлу карты
+//!
+//! \param path Путь до XML-файла карты
+//! \param edits Сколько правок уже записано в журнал этого файла
+//!
+void MapJournal::attach(const QString& path, int edits) {
+    base = QFileInfo(path).absoluteFilePath();
+    this->edits.clear();
+    written = edits;
+}
+
+//!
+//! Отвязать журнал: правки больше не запоминаются до следующей привязки
+//!
+void MapJournal::detach() {
+    base.clear();
+    edits.clear();
+    written = 0;
+}
+
+//!
+//! Журнал привязан к этому файлу карты
+//!
+bool MapJournal::attached(const QString& path) const {
+    return !base.isEmpty() && QFileInfo(path).absoluteFilePath() == base;
+}
+
+//!
+//! Пора записать карту целиком
+//!
+bool MapJournal::needsCompaction() const {
+    return written + edits.size() > compactEdits;
+}
+
+//!
+//! Дописать накопленные правки в журнал
+//!
+//! \return 0 в случае успеха
+//! \return -1 если журнал не привязан или его файл не открывается
+//!
+int MapJournal::flush() {
+    if (base.isEmpty()) return -1;
+    QFile file(base + fileSuffix);
+    if (!file.exists() || !file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) return -1;
+    if (edits.isEmpty()) return 0;
+    QByteArray chunk;
+    for (const QString& edit : edits) chunk += edit.toUtf8() + '\n';
+    if (file.write(chunk) != chunk.size()) return -1;
+    file.close();
+    qInfo() << "MapJournal::flush" << edits.size() << "edits," << chunk.size() << "bytes";
+    written += edits.size();
+    edits.clear();
+    return 0;
+}
+
+//!
+//! Операция -- правка карты (а не генерация сетки или поиск пути)
+//!
+bool MapJournal::isEdit(const QString& operation) {
+    static const QStringList kinds = { "resize", "add", "remove", "insert", "erase", "move", "start", "end", "stop", "unstop" };
+    return kinds.contains(operation.section(' ', 0, 0));
+}
+
+//!
+//! MD5 содержимого XML-файла карты
+//!
+QByteArray MapJournal::digestOf(const QByteArray& document) {
+    return QCryptographicHash::hash(document, QCryptographicHash::Md5).toHex();
+}
+
+//!
+//! Прочитать журнал карты
+//!
+//! \param path Путь до XML-файла карты
+//! \param digest MD5 XML-файла
+//! \param edits Вектор для сохранения правок
+//! \return 0 в случае успеха (в том числе если журнала нет)
+//! \return -1 если журнал наложен на другое содержимое XML-файла
+//!
+int MapJournal::read(const QString& path, const QByteArray& digest, QStringList& edits) {
+    edits.clear();
+    QFile file(path + fileSuffix);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return 0;
+    QString first = QString::fromUtf8(file.readLine()).trimmed();
+    if (first != QString("%1 %2").arg(header).arg(QString::fromLatin1(digest))) {
+        qWarning() << "MapJournal::read" << "Stale journal" << file.fileName();
+        return -1;
+    }
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (!line.isEmpty() && !line.startsWith('#')) edits.append(line);
+    }
+    return 0;
+}
+
+//!
+//! Начать пустой журнал для только что записанного XML-файла
+//!
+//! \param path Путь до XML-файла карты
+//! \param digest MD5 XML-файла
+//! \return 0 в случае успеха
+//! \return -1 если файл журнала не открывается
+//!
+int MapJournal::create(const QString& path, const QByteArray& digest) {
+    QFile file(path + fileSuffix);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) return -1;
+    file.write(QString("%1 %2\n").arg(header).arg(QString::fromLatin1(digest)).toUtf8());
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef MAPJOURNAL_H
+#define MAPJOURNAL_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+class MapJournal {
+public:
+    static constexpr const char* header = "# c2-practice journal 1";
+    static constexpr const char* fileSuffix = ".journal";
+    static constexpr int compactEdits = 2048;
+
+    void record(const QString& operation);
+    void attach(const QString& path, int edits);
+    void detach();
+    bool attached(const QString& path) const;
+    bool needsCompaction() const;
+    int flush();
+
+    static bool isEdit(const QString& operation);
+    static QByteArray digestOf(const QByteArray& document);
+    static int read(const QString& path, const QByteArray& digest, QStringList& edits);
+    static int create(const QString& path, const QByteArray& digest);
+
+protected:
+    QString base;
+    QStringList edits;
+    int written = 0;
+};
+
+#endif // MAPJOURNAL_H
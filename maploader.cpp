@@ -0,0 +1,362 @@
+//!
+//! Поэтапная загрузка карты в фоновых потоках.
+//! Стадии идут конвейером в собственном пуле из `MapLoader::stageThreads` потоков: разбор XML отдаёт
+//! препятствия по одному, как только они прочитаны, а индексация (рёбра для проверок пересечения,
+//! в конце -- поиск пересечений заметающей прямой) и растеризация в узлы сетки забирают их параллельно
+//! с разбором. Растеризация идёт по препятствиям: узел получает непроходимость первого содержащего его
+//! препятствия, как и в `Field::rasterizeCells`, поэтому результат не зависит от того, сколько
+//! препятствий уже прочитано. Поле при этом не трогается: готовый `MapDocument` ставится в поле
+//! `Field::installMap`, а отмена на любой стадии оставляет старую карту как есть
+//!
+
+#include <QFile>
+#include <QtConcurrent>
+#include <QDebug>
+#include <QElapsedTimer>
+#include "maploader.h"
+#include "field.h"
+
+MapLoader::MapLoader() {
+    pool.setMaxThreadCount(stageThreads);
+}
+
+MapLoader::~MapLoader() {
+    cancel();
+    pool.waitForDone();
+}
+
+//!
+//! Начать загрузку карты
+//! Загрузчик одноразовый: для следующей карты нужен новый
+//!
+//! \param path Путь до XML-файла
+//! \param cellSize Шаг сетки, для которой считается непроходимость узлов
+//! \return Результат загрузки: 0 в случае успеха, -1..-3 как у `Field::loadMap`, -4 если загрузка отменена
+//!
+QFuture<int> MapLoader::start(const QString& path, int cellSize) {
+    this->path = path;
+    doc.cellSize = cellSize;
+    return QtConcurrent::run(&pool, [this]() { return run(); });
+}
+
+//!
+//! Отменить загрузку
+//! Стадии замечают отмену в течение `MapLoader::checkInterval` элементов XML или одного препятствия
+//!
+void MapLoader::cancel() {
+    cancelled.storeRelaxed(1);
+    QMutexLocker locker(&mutex);
+    arrived.wakeAll();
+}
+
+bool MapLoader::isCancelled() const {
+    return cancelled.loadRelaxed() != 0;
+}
+
+//!
+//! Текущая стадия загрузки
+//! Индексация и растеризация идут одновременно, стадией считается первая незаконченная
+//!
+MapLoader::Progress MapLoader::progress() const {
+    Progress result;
+    QMutexLocker locker(&mutex);
+    int count = doc.obstacles.size();
+    result.obstacles = count;
+    result.size = QSize(doc.width, doc.height);
+    if (!parsed) {
+        qint64 total = bytesTotal.loadRelaxed();
+        result.stage = PARSING;
+        result.percent = total > 0 ? (int)(100 * bytesRead.loadRelaxed() / total) : 0;
+    } else if (!indexDone.loadRelaxed()) {
+        result.stage = INDEXING;
+        result.percent = count > 0 ? 100 * indexed.loadRelaxed() / count : 100;
+    } else if (!rasterDone.loadRelaxed()) {
+        result.stage = RASTERIZING;
+        result.percent = count > 0 ? 100 * rasterized.loadRelaxed() / count : 100;
+    } else {
+        result.stage = DONE;
+        result.percent = 100;
+    }
+    return result;
+}
+
+//!
+//! Забрать препятствия, прочитанные с прошлого вызова
+//!
+//! \param result Уже забранные препятствия, новые дописываются в конец
+//! \return Количество новых препятствий
+//!
+int MapLoader::take(QVector<Obstacle>& result) {
+    QMutexLocker locker(&mutex);
+    int from = result.size();
+    for (int k = from; k < doc.obstacles.size(); k++) result.append(doc.obstacles[k]);
+    return result.size() - from;
+}
+
+//!
+//! Загруженная карта. Полна только после успешного окончания загрузки
+//!
+MapDocument& MapLoader::document() {
+    return doc;
+}
+
+//!
+//! Весь конвейер: разбор в текущем потоке, индексация и растеризация -- в соседних
+//!
+int MapLoader::run() {
+    QElapsedTimer timer;
+    timer.start();
+    QFuture<void> indexing = QtConcurrent::run(&pool, [this]() { index(); });
+    QFuture<void> raster = QtConcurrent::run(&pool, [this]() { rasterize(); });
+    int code = parse();
+    finishParse(code);
+    indexing.waitForFinished();
+    raster.waitForFinished();
+    if (code == 0 && isCancelled()) code = -4;
+    qInfo() << "MapLoader::run" << "Code" << code << "," << doc.obstacles.size() << "obstacles in" << timer.elapsed() << "ms";
+    return code;
+}
+
+//!
+//! Разбор XML-файла
+//! Проверяется также MD5 файла для журнала правок (`MapJournal`)
+//!
+//! \return 0 в случае успеха, коды ошибок как у `MapLoader::start`
+//!
+int MapLoader::parse() {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return -1;
+    QByteArray document = file.readAll();
+    file.close();
+    bytesTotal.storeRelaxed(document.size());
+    doc.digest = MapJournal::digestOf(document);
+
+    QXmlStreamReader xml(document);
+    unsigned width = 0, height = 0;
+    bool ok;
+    while (!halted(xml) && !xml.atEnd()) {
+        if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == QString("map")) {
+            QXmlStreamAttributes mapAttrs = xml.attributes();
+            if (!mapAttrs.hasAttribute("width") || !mapAttrs.hasAttribute("height")) return -2;
+            int wid = mapAttrs.value("width").toInt(&ok);
+            if (!ok || wid < Field::minWidth || wid > Field::maxWidth) return -3;
+            int hei = mapAttrs.value("height").toInt(&ok);
+            if (!ok || hei < Field::minHeight || hei > Field::maxHeight) return -3;
+            width = wid;
+            height = hei;
+            {
+                QMutexLocker locker(&mutex);
+                doc.width = width;
+                doc.height = height;
+            }
+            while (!halted(xml) && !(xml.tokenType() == QXmlStreamReader::EndElement && xml.name() == QString("map"))) {
+                QXmlStreamReader::TokenType token = xml.readNext();
+                if (token == QXmlStreamReader::StartElement) {
+                    if (xml.name() == QString("polygons")) {
+                        while (!halted(xml) && !(xml.tokenType() == QXmlStreamReader::EndElement && xml.name() == QString("polygons"))) {
+                            if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == QString("poly")) {
+                                QXmlStreamAttributes polyAttrs = xml.attributes();
+                                if (!polyAttrs.hasAttribute("walkness")) return -2;
+                                QPolygon poly;
+                                double w = polyAttrs.value("walkness").toDouble(&ok);
+                                if (!ok || w < 0. || w > 1.) return -3;
+                                while (!halted(xml) && !(xml.tokenType() == QXmlStreamReader::EndElement && xml.name() == QString("poly"))) {
+                                    if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == QString("point")) {
+                                        QXmlStreamAttributes pointAttrs = xml.attributes();
+                                        if (!pointAttrs.hasAttribute("x") || !pointAttrs.hasAttribute("y")) return -2;
+                                        unsigned x = pointAttrs.value("x").toInt(&ok);
+                                        if (!ok || x > width) return -3;
+                                        unsigned y = pointAttrs.value("y").toInt(&ok);
+                                        if (!ok || y > height) return -3;
+                                        poly << QPoint(x, y);
+                                    }
+                                }
+                                if (halted(xml)) break;
+                                publish(Obstacle(poly, w));
+                            }
+                        }
+                    }
+                    if (xml.name() == QString("path")) {
+                        while (!halted(xml) && !(xml.tokenType() == QXmlStreamReader::EndElement && xml.name() == QString("path"))) {
+                            if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == QString("point")) {
+                                QXmlStreamAttributes pointAttrs = xml.attributes();
+                                if (!pointAttrs.hasAttribute("x") || !pointAttrs.hasAttribute("y")) return -2;
+                                unsigned x = pointAttrs.value("x").toInt(&ok);
+                                if (!ok || x > width) return -3;
+                                unsigned y = pointAttrs.value("y").toInt(&ok);
+                                if (!ok || y > height) return -3;
+                                doc.path.append(QPoint(x, y));
+                            }
+                        }
+                    }
+                    if (xml.name() == QString("agent")) {
+                        QXmlStreamAttributes agentAttrs = xml.attributes();
+                        if (!agentAttrs.hasAttribute("sx") || !agentAttrs.hasAttribute("sy")) return -2;
+                        if (!agentAttrs.hasAttribute("ex") || !agentAttrs.hasAttribute("ey")) return -2;
+                        unsigned sx = agentAttrs.value("sx").toInt(&ok);
+                        if (!ok || sx > width) return -3;
+                        unsigned sy = agentAttrs.value("sy").toInt(&ok);
+                        if (!ok || sy > height) return -3;
+                        unsigned ex = agentAttrs.value("ex").toInt(&ok);
+                        if (!ok || ex > width) return -3;
+                        unsigned ey = agentAttrs.value("ey").toInt(&ok);
+                        if (!ok || ey > height) return -3;
+                        doc.agents.append(Agent(QPoint(sx, sy), QPoint(ex, ey)));
+                    }
+                    if (xml.name() == QString("start")) {
+                        QXmlStreamAttributes startAttrs = xml.attributes();
+                        if (!startAttrs.hasAttribute("x") || !startAttrs.hasAttribute("y")) return -2;
+                        unsigned x = startAttrs.value("x").toInt(&ok);
+                        if (!ok || x > width) return -3;
+                        unsigned y = startAttrs.value("y").toInt(&ok);
+                        if (!ok || y > height) return -3;
+                        doc.start.emplace(QPoint(x, y));
+                    }
+                    if (xml.name() == QString("end")) {
+                        QXmlStreamAttributes finishAttrs = xml.attributes();
+                        if (!finishAttrs.hasAttribute("x") || !finishAttrs.hasAttribute("y")) return -2;
+                        unsigned x = finishAttrs.value("x").toInt(&ok);
+                        if (!ok || x > width) return -3;
+                        unsigned y = finishAttrs.value("y").toInt(&ok);
+                        if (!ok || y > height) return -3;
+                        doc.end.emplace(QPoint(x, y));
+                    }
+                    if (xml.name() == QString("stop")) {
+                        QXmlStreamAttributes stopAttrs = xml.attributes();
+                        if (!stopAttrs.hasAttribute("x") || !stopAttrs.hasAttribute("y")) return -2;
+                        unsigned x = stopAttrs.value("x").toInt(&ok);
+                        if (!ok || x > width) return -3;
+                        unsigned y = stopAttrs.value("y").toInt(&ok);
+                        if (!ok || y > height) return -3;
+                        doc.stops.append(QPoint(x, y));
+                    }
+                }
+            }
+        }
+    }
+    if (isCancelled()) return -4;
+    // Незакрытый элемент или испорченный XML -- нарушение структуры
+    if (xml.hasError() || width == 0) return -2;
+    bytesRead.storeRelaxed(document.size());
+    return 0;
+}
+
+//!
+//! Разбор пора прервать: загрузку отменили или XML испорчен
+//! Раз в `MapLoader::checkInterval` вызовов обновляется прогресс разбора
+//!
+bool MapLoader::halted(QXmlStreamReader& xml) {
+    if (++tokens % checkInterval == 0) bytesRead.storeRelaxed(xml.characterOffset());
+    return xml.hasError() || isCancelled();
+}
+
+//!
+//! Отдать прочитанное препятствие следующим стадиям
+//!
+void MapLoader::publish(const Obstacle& obst) {
+    QMutexLocker locker(&mutex);
+    doc.obstacles.append(obst);
+    arrived.wakeAll();
+}
+
+//!
+//! Разбор закончен: больше препятствий не будет
+//!
+//! \param code Результат разбора
+//!
+void MapLoader::finishParse(int code) {
+    QMutexLocker locker(&mutex);
+    parsed = true;
+    parseCode = code;
+    arrived.wakeAll();
+}
+
+//!
+//! Дождаться препятствий, прочитанных после next
+//!
+//! \param next Сколько препятствий стадия уже забрала
+//! \param batch Вектор для сохранения новых препятствий
+//! \return false, если новых препятствий не будет: разбор закончен, не удался или загрузка отменена
+//!
+bool MapLoader::wait(int next, QVector<Obstacle>& batch) {
+    batch.clear();
+    QMutexLocker locker(&mutex);
+    while (!isCancelled() && !parsed && next >= doc.obstacles.size()) arrived.wait(&mutex);
+    if (isCancelled() || parseCode < 0) return false;
+    for (int k = next; k < doc.obstacles.size(); k++) batch.append(doc.obstacles[k]);
+    return !batch.isEmpty();
+}
+
+//!
+//! Разбор удался, и загрузку не отменили
+//!
+bool MapLoader::succeeded() const {
+    QMutexLocker locker(&mutex);
+    return parsed && parseCode == 0 && !isCancelled();
+}
+
+//!
+//! Стадия индексации: рёбра препятствий и пересечения между ними
+//!
+void MapLoader::index() {
+    QVector<EdgeBatch> edges;
+    QVector<QPolygon> polygons;
+    QVector<Obstacle> batch;
+    while (wait(edges.size(), batch)) {
+        for (const Obstacle& obst : batch) {
+            if (isCancelled()) return;
+            edges.append(EdgeBatch(obst.poly));
+            polygons.append(obst.poly);
+            indexed.fetchAndAddRelaxed(1);
+        }
+    }
+    if (!succeeded()) return;
+    // Пересечения ищутся по всем препятствиям сразу, поэтому только после разбора
+    doc.crossings = SweepLine().find(polygons);
+    doc.edges = edges;
+    indexDone.storeRelaxed(1);
+}
+
+//!
+//! Стадия растеризации: непроходимость узлов сетки (индекс `i * rows + j`)
+//! Пока узел не накрыт ни одним препятствием, в нём -1
+//!
+void MapLoader::rasterize() {
+    int size = doc.cellSize;
+    QVector<double> factors;
+    int cols = 0, rows = 0;
+    auto allocate = [&]() {
+        QMutexLocker locker(&mutex);
+        cols = (doc.width + size - 1) / size;
+        rows = (doc.height + size - 1) / size;
+        factors.fill(-1., cols * rows);
+    };
+
+    QVector<Obstacle> batch;
+    int next = 0;
+    while (wait(next, batch)) {
+        if (factors.isEmpty()) allocate();
+        for (const Obstacle& obst : batch) {
+            if (isCancelled()) return;
+            QRect box = obst.poly.boundingRect();
+            int left = qMax(0, (box.left() + size - 1) / size), right = qMin(cols - 1, box.right() / size);
+            int top = qMax(0, (box.top() + size - 1) / size), bottom = qMin(rows - 1, box.bottom() / size);
+            for (int i = left; i <= right; i++) {
+                double* column = factors.data() + i * rows;
+                for (int j = top; j <= bottom; j++) {
+                    if (column[j] >= 0.) continue;
+                    if (obst.poly.containsPoint(QPoint(i * size, j * size), Qt::FillRule::OddEvenFill)) column[j] = obst.walkness;
+                }
+            }
+            rasterized.fetchAndAddRelaxed(1);
+        }
+        next += batch.size();
+    }
+    if (!succeeded()) return;
+    if (factors.isEmpty()) allocate();
+    for (double& factor : factors) {
+        if (factor < 0.) factor = 0.;
+    }
+    doc.factors = factors;
+    rasterDone.storeRelaxed(1);
+}
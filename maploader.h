@@ -0,0 +1,91 @@
+#ifndef MAPLOADER_H
+#define MAPLOADER_H
+
+#include <optional>
+#include <QVector>
+#include <QPoint>
+#include <QSize>
+#include <QString>
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QThreadPool>
+#include <QFuture>
+#include <QXmlStreamReader>
+#include "obstacle.h"
+#include "geometry.h"
+#include "sweepline.h"
+#include "multiagent.h"
+
+struct MapDocument {
+    unsigned width = 0, height = 0;
+    QVector<Obstacle> obstacles;
+    QVector<EdgeBatch> edges;
+    QVector<EdgeCrossing> crossings;
+    QVector<QPoint> path;
+    QVector<Agent> agents;
+    std::optional<QPoint> start, end;
+    QVector<QPoint> stops;
+    QByteArray digest;
+    int cellSize = 0;
+    QVector<double> factors;
+};
+
+class MapLoader {
+public:
+    enum Stage {
+        PARSING = 0,
+        INDEXING = 1,
+        RASTERIZING = 2,
+        DONE = 3
+    };
+
+    struct Progress {
+        Stage stage = PARSING;
+        int percent = 0;
+        int obstacles = 0;
+        QSize size;
+    };
+
+    static constexpr int stageThreads = 3;
+    static constexpr int checkInterval = 256;
+
+    MapLoader();
+    ~MapLoader();
+    QFuture<int> start(const QString& path, int cellSize);
+    void cancel();
+    bool isCancelled() const;
+    Progress progress() const;
+    int take(QVector<Obstacle>& result);
+    MapDocument& document();
+
+protected:
+    QThreadPool pool;
+    QString path;
+    MapDocument doc;
+
+    // Передача препятствий от разбора остальным стадиям
+    mutable QMutex mutex;
+    QWaitCondition arrived;
+    bool parsed = false;
+    int parseCode = 0;
+    quint64 tokens = 0;
+
+    QAtomicInt cancelled;
+    QAtomicInteger<qint64> bytesRead, bytesTotal;
+    QAtomicInt indexed, rasterized;
+    QAtomicInt indexDone, rasterDone;
+
+    int run();
+    int parse();
+    bool halted(QXmlStreamReader& xml);
+    void publish(const Obstacle& obst);
+    void finishParse(int code);
+    bool wait(int next, QVector<Obstacle>& batch);
+    bool succeeded() const;
+    void index();
+    void rasterize();
+};
+
+#endif // MAPLOADER_H
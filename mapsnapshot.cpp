@@ -0,0 +1,193 @@
+//!
+//! Неизменяемые снимки карты.
+//! Снимок хранит препятствия, их рёбра, сетку и построенные по ней структуры. Контейнеры Qt
+//! разделяются неявно, поэтому снимок не копирует данные поля: копия создаётся только у той части,
+//! которую поле изменит после публикации. Планировщики в других потоках берут снимок из `MapStore`
+//! и работают с ним до конца запроса, не мешая редактированию
+//!
+
+#include <algorithm>
+#include "mapsnapshot.h"
+#include "gridsearch.h"
+#include "frontiersearch.h"
+#include "anytimesearch.h"
+#include "utils.h"
+
+QSize MapSnapshot::meshSize() const {
+    return QSize((width + cellSize - 1) / cellSize, (height + cellSize - 1) / cellSize);
+}
+
+//!
+//! Получение непроходимости в точке карты
+//!
+//! \param point Точка
+//! \return Фактор непроходимости в этой точке
+//!
+double MapSnapshot::getFactorMap(const QPoint& point) const {
+    for (int i = 0; i < edges.size(); i++) {
+        if (edges[i].contains(point)) return obstacles[i].walkness;
+    }
+    return 0.;
+}
+
+//!
+//! Получить ближайшую к точке карты точку сетки (как `Field::nearestMesh`)
+//!
+const MeshPoint* MapSnapshot::nearestMesh(const QPoint& point) const {
+    QSize dims = meshSize();
+    if (dims.isEmpty()) return 0;
+    int i = qBound(0, qRound((double)point.x() / cellSize), dims.width() - 1);
+    int j = qBound(0, qRound((double)point.y() / cellSize), dims.height() - 1);
+    auto it = mesh.constFind(QPoint(i, j));
+    return it == mesh.constEnd() ? 0 : &it.value();
+}
+
+//!
+//! Таблицы ориентиров сетки снимка
+//! Снимок публикуется сразу после генерации сетки, а ориентиры строятся в фоне, поэтому таблицы
+//! берутся из фонового построения в момент запроса
+//!
+//! \return Таблицы или nullptr, если они ещё строятся или построение отменено
+//!
+QSharedPointer<const LandmarkTables> MapSnapshot::landmarkTables() const {
+    if (landmarks.isCanceled() || !landmarks.isFinished()) return QSharedPointer<const LandmarkTables>();
+    QSharedPointer<const LandmarkTables> tables = landmarks.result();
+    if (tables.isNull() || tables->revision != revision) return QSharedPointer<const LandmarkTables>();
+    return tables;
+}
+
+//!
+//! Эвристика A* (как `Field::heuristic`)
+//!
+//! \param from Клетка (координаты на сетке)
+//! \param to Цель (координаты на сетке)
+//! \param tables Таблицы ориентиров (см. `MapSnapshot::landmarkTables`) или 0
+//!
+double MapSnapshot::heuristic(const QPoint& from, const QPoint& to, const LandmarkTables* tables) const {
+    double h = simpleDistance(from, to);
+    if (tables != 0) {
+        int rows = tables->rows;
+        h = qMax(h, (double)tables->bound(from.x() * rows + from.y(), to.x() * rows + to.y()));
+    }
+    return h;
+}
+
+//!
+//! Найти путь по снимку
+//! Тот же A* (`GridSearch`), что и в `Field::aStarPath`, с той же обработкой пути, что и в `Field::refinePath`.
+//! Если к снимку приложена иерархия сжатия, путь точечного агента ищется по ней (см. `Field::hierarchyPath`).
+//! Не изменяет снимок, поэтому может вызываться из нескольких потоков одновременно
+//!
+//! \param start Точка старта
+//! \param finish Точка финиша
+//! \param way Вектор для сохранения пути (от финиша к старту, как `Field::findPath`)
+//! \param limits Ограничения поиска: бюджет памяти в байтах (см. `Field::aStarPath`)
+//! и время в миллисекундах (см. `Field::anytimePath`), 0 -- без ограничения; радиус агента в пикселях (см. `Field::agentRadius`)
+//! \param quality Если задано, сюда записывается, кратчайший ли путь и во сколько раз он может быть длиннее кратчайшего
+//! \return >0 если путь найден
+//! \return ==0 если не получилось проложить путь от старта до финиша
+//! \return -1 если сетка пуста
+//!
+double MapSnapshot::findPath(const QPoint& start, const QPoint& finish, QVector<MeshPoint>& way, const SearchLimits& limits, SearchQuality* quality) const {
+    way.clear();
+    if (quality != 0) *quality = SearchQuality();
+    const MeshPoint* mstart = nearestMesh(start);
+    const MeshPoint* mend = nearestMesh(finish);
+    if (mstart == 0 || mend == 0) return -1;
+    if (mstart->walkness >= 1. || mend->walkness >= 1.) return 0;
+    if (!connectivity.connected(mstart->meshCoord, mend->meshCoord)) return 0;
+    float radius = limits.radius / cellSize;
+    if (!clearance.passable(mstart->meshCoord, radius) || !clearance.passable(mend->meshCoord, radius)) return 0;
+
+    int rows = meshSize().height();
+    int si = mstart->meshCoord.x() * rows + mstart->meshCoord.y();
+    int fi = mend->meshCoord.x() * rows + mend->meshCoord.y();
+    // Иерархия сжатия даёт кратчайший путь быстрее любого из поисков ниже, но только для точечного агента
+    if (!hierarchy.isNull() && radius <= 0.f) {
+        QVector<int> route;
+        if (hierarchy->query(si, fi, route) < 0) return 0;
+        for (int cell : route) way.append(mesh[QPoint(cell / rows, cell % rows)]);
+        return refine(way, radius);
+    }
+
+    QSharedPointer<const LandmarkTables> alt = landmarkTables();
+    auto estimate = [this, alt](const QPoint& from, const QPoint& to) { return heuristic(from, to, alt.data()); };
+    if (limits.deadline > 0) {
+        AnytimeSearch search(mesh, meshSize().width(), rows, estimate);
+        search.setClearance(&clearance, radius);
+        QVector<QPoint> route;
+        if (search.find(mstart->meshCoord, mend->meshCoord, limits.deadline, route) <= 0) return 0;
+        if (quality != 0) {
+            quality->bound = search.bound();
+            quality->optimal = search.bound() <= 1.;
+        }
+        for (const QPoint& cell : route) way.append(mesh[cell]);
+        return refine(way, radius);
+    }
+
+    GridSearch search(cells, estimate, limits.budget);
+    search.setClearance(&clearance, radius);
+    QVector<QPoint> route;
+    search.find(mstart->meshCoord, mend->meshCoord, route);
+    if (search.exceeded()) {
+        FrontierSearch bounded(mesh, meshSize().width(), rows, estimate, limits.budget);
+        bounded.setClearance(&clearance, radius);
+        if (bounded.find(mstart->meshCoord, mend->meshCoord, route) <= 0) return 0;
+        if (quality != 0) quality->optimal = bounded.optimal();
+    }
+    if (route.isEmpty()) return 0;
+    for (const QPoint& cell : route) way.append(mesh[cell]);
+
+    return refine(way, radius);
+}
+
+//!
+//! Сгладить и вытянуть путь (как `Field::refinePath`)
+//!
+//! \param way Путь от старта к финишу; на выходе -- от финиша к старту
+//! \param radius Радиус агента в клетках сетки
+//! \return Длина пути
+//!
+double MapSnapshot::refine(QVector<MeshPoint>& way, float radius) const {
+    QVector<MeshPoint> pulled;
+    sight.smooth(way, radius);
+    std::reverse(way.begin(), way.end());
+    for (int pass = 0; pass < LineOfSight::pullPasses; pass++) {
+        if (pass > 0) sight.smooth(way, radius);
+        sight.pull(way, pulled);
+        way.swap(pulled);
+    }
+
+    double length = 0;
+    for (int i = 1; i < way.length(); i++) {
+        length += euclideanDistance(way[i-1].realCoord, way[i].realCoord);
+    }
+    return length;
+}
+
+//!
+//! Получить текущий снимок карты
+//! Снимок неизменяем и остаётся живым, пока на него есть ссылки, даже после публикации нового
+//!
+QSharedPointer<const MapSnapshot> MapStore::snapshot() const {
+    QMutexLocker locker(&mutex);
+    return current;
+}
+
+//!
+//! Опубликовать новый снимок карты
+//!
+//! \param next Снимок
+//!
+void MapStore::publish(const QSharedPointer<const MapSnapshot>& next) {
+    QMutexLocker locker(&mutex);
+    current = next;
+}
+
+//!
+//! Ревизия сетки текущего снимка (0 -- снимок ещё не опубликован)
+//!
+unsigned MapStore::revision() const {
+    QMutexLocker locker(&mutex);
+    return current.isNull() ? 0 : current->revision;
+}
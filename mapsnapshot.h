@@ -0,0 +1,66 @@
+#ifndef MAPSNAPSHOT_H
+#define MAPSNAPSHOT_H
+
+#include <QVector>
+#include <QHash>
+#include <QSize>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QFuture>
+#include "obstacle.h"
+#include "meshpoint.h"
+#include "geometry.h"
+#include "connectivity.h"
+#include "lineofsight.h"
+#include "landmarks.h"
+#include "clearance.h"
+#include "hierarchy.h"
+#include "cellgrid.h"
+
+struct SearchLimits {
+    qint64 budget = 0;
+    int deadline = 0;
+    double radius = 0.;
+};
+
+struct SearchQuality {
+    bool optimal = true;
+    double bound = 1.;
+};
+
+struct MapSnapshot {
+    unsigned revision = 0;
+    unsigned width = 0, height = 0;
+    int cellSize = 1;
+
+    QVector<Obstacle> obstacles;
+    QVector<EdgeBatch> edges;
+    QHash<QPoint, MeshPoint> mesh;
+    CellGrid cells;
+    Connectivity connectivity;
+    LineOfSight sight;
+    ClearanceMap clearance;
+    QFuture<QSharedPointer<const LandmarkTables>> landmarks;
+    QSharedPointer<const ContractionHierarchy> hierarchy;
+
+    QSize meshSize() const;
+    double getFactorMap(const QPoint& point) const;
+    const MeshPoint* nearestMesh(const QPoint& point) const;
+    QSharedPointer<const LandmarkTables> landmarkTables() const;
+    double heuristic(const QPoint& from, const QPoint& to, const LandmarkTables* tables) const;
+    double refine(QVector<MeshPoint>& way, float radius = 0.f) const;
+    double findPath(const QPoint& start, const QPoint& finish, QVector<MeshPoint>& way, const SearchLimits& limits = SearchLimits(), SearchQuality* quality = 0) const;
+};
+
+class MapStore {
+public:
+    QSharedPointer<const MapSnapshot> snapshot() const;
+    void publish(const QSharedPointer<const MapSnapshot>& next);
+    unsigned revision() const;
+
+protected:
+    mutable QMutex mutex;
+    QSharedPointer<const MapSnapshot> current;
+};
+
+#endif // MAPSNAPSHOT_H
@@ -0,0 +1,217 @@
+//!
+//! Кооперативное планирование путей для нескольких агентов.
+//! Агенты планируются по очереди алгоритмом A* по сетке, развёрнутой во времени;
+//! занятые клетки записываются в общую таблицу резервирования, чтобы агенты не сталкивались
+//!
+
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <QDebug>
+#include "multiagent.h"
+#include "prioqueue.h"
+#include "frontiersearch.h"
+
+static const QPoint moves[5] = { QPoint(0, 0), QPoint(0, 1), QPoint(0, -1), QPoint(-1, 0), QPoint(1, 0) };
+
+//!
+//! Ключ таблицы резервирования: клетка в момент времени
+//!
+static inline quint64 slot(int cell, int time) {
+    return ((quint64)time << 32) | (quint32)cell;
+}
+
+CooperativePlanner::CooperativePlanner(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, int cellSize)
+    : mesh(mesh), cols(cols), rows(rows), cellSize(cellSize) {
+    walkness.fill(1., cols * rows);
+    for (auto it = mesh.constBegin(); it != mesh.constEnd(); ++it) {
+        walkness[index(it.key())] = it.value().walkness;
+    }
+}
+
+//!
+//! Спланировать пути для всех агентов
+//! Эвристики (поля стоимостей до целей) считаются параллельно, по одной на каждую различную цель.
+//! Сами агенты планируются последовательно в порядке следования, так как каждый следующий
+//! учитывает резервирования предыдущих
+//!
+//! \param agents Агенты. Для каждого заполняются путь (по точке на шаг времени), стоимость и флаг успеха
+//! \param horizon Максимальное количество шагов времени (0 -- подобрать по размерам сетки)
+//! \param budget Бюджет памяти поиска одного агента в байтах (0 -- без ограничения, см. `Field::searchBudget`)
+//! \return Общее время планирования в миллисекундах
+//!
+qint64 CooperativePlanner::plan(QVector<Agent>& agents, int horizon, qint64 budget) {
+    QElapsedTimer timer;
+    timer.start();
+    this->budget = budget;
+
+    reservations.clear();
+    parked.clear();
+    lastReserved.clear();
+    if (horizon <= 0) horizon = 2 * (cols + rows) + agents.size();
+
+    QVector<int> goals;
+    QHash<int, int> goalField;
+    for (const Agent& agent : agents) {
+        int goal = snap(agent.goal);
+        if (!goalField.contains(goal)) {
+            goalField[goal] = goals.size();
+            goals.append(goal);
+        }
+    }
+
+    QVector<FlowField> fields(goals.size());
+    QVector<int> jobs;
+    for (int i = 0; i < goals.size(); i++) jobs.append(i);
+    QtConcurrent::blockingMap(jobs, [&](int i) {
+        fields[i].build(mesh, cols, rows, cellSize, coord(goals[i]), 0);
+    });
+
+    for (int i = 0; i < agents.size(); i++) {
+        const FlowField& heuristic = fields[goalField[snap(agents[i].goal)]];
+        agents[i].solved = planAgent(i, agents[i], heuristic, horizon);
+    }
+
+    return timer.elapsed();
+}
+
+//!
+//! Спланировать путь одного агента с учётом уже сделанных резервирований
+//! Состояние поиска -- клетка и момент времени; из каждого состояния можно подождать на месте
+//! или шагнуть в соседнюю клетку. Стоимость шага как в `Field::aStarPath`, ожидание стоит 1.
+//! Если цель заперта припаркованными агентами, поиск перебирал бы всё пространство до горизонта, поэтому
+//! память поиска (состояния, лучшие стоимости и очередь) ограничена бюджетом: при его превышении агент остаётся без пути
+//!
+//! \param id Номер агента
+//! \param agent Агент
+//! \param heuristic Поле стоимостей до цели агента
+//! \param horizon Максимальное количество шагов времени
+//! \return Найден путь или нет
+//!
+bool CooperativePlanner::planAgent(int id, Agent& agent, const FlowField& heuristic, int horizon) {
+    struct Node {
+        int cell;
+        int time;
+        double cost;
+        int parent;
+    };
+
+    agent.way.clear();
+    agent.cost = 0;
+    int start = snap(agent.start);
+    int goal = snap(agent.goal);
+    if (walkness[start] >= 1. || walkness[goal] >= 1.) return false;
+    if (heuristic.cost(coord(start)) < 0) return false;
+    if (!available(id, start, start, -1)) return false;
+
+    QVector<Node> nodes;
+    QHash<quint64, double> best;
+    PriorityQueue<int, double> queue;
+    nodes.append({ start, 0, 0., -1 });
+    best[slot(start, 0)] = 0.;
+    queue.put(0, heuristic.cost(coord(start)) - 1.);
+
+    int found = -1;
+    unsigned expanded = 0;
+    while (!queue.empty()) {
+        int current = queue.get();
+        Node node = nodes[current];
+        if (best.value(slot(node.cell, node.time)) < node.cost) continue;
+        if (node.cell == goal && node.time > lastReserved.value(goal, -1)) {
+            found = current;
+            break;
+        }
+        if (node.time >= horizon) continue;
+        expanded++;
+
+        if (budget > 0 && nodes.size() * (qint64)sizeof(Node) + FrontierSearch::footprint(best) + FrontierSearch::footprint(queue) > budget) {
+            qInfo() << "CooperativePlanner::planAgent" << "Agent" << id << "budget exceeded after" << expanded << "expansions";
+            return false;
+        }
+
+        QPoint from = coord(node.cell);
+        for (const QPoint& move : moves) {
+            QPoint to = from + move;
+            if (to.x() < 0 || to.y() < 0 || to.x() >= cols || to.y() >= rows) continue;
+            int next = index(to);
+            if (walkness[next] >= 1.) continue;
+            double h = heuristic.cost(to);
+            if (h < 0) continue;
+            if (!available(id, node.cell, next, node.time)) continue;
+
+            double cost = node.cost + (next == node.cell ? 1. : 1. + walkness[next]);
+            quint64 key = slot(next, node.time + 1);
+            if (best.contains(key) && best[key] <= cost) continue;
+            best[key] = cost;
+            nodes.append({ next, node.time + 1, cost, current });
+            queue.put(nodes.size() - 1, cost + h - 1.);
+        }
+    }
+
+    if (found == -1) return false;
+
+    QVector<int> cells;
+    for (int i = found; i != -1; i = nodes[i].parent) cells.append(nodes[i].cell);
+    std::reverse(cells.begin(), cells.end());
+    reserve(id, cells);
+
+    for (int cell : cells) {
+        QPoint meshCoord = coord(cell);
+        agent.way.append(MeshPoint(meshCoord, meshCoord * cellSize, walkness[cell]));
+    }
+    agent.cost = nodes[found].cost;
+    return true;
+}
+
+//!
+//! Зарезервировать путь агента
+//! После прибытия агент остаётся в своей цели навсегда
+//!
+//! \param id Номер агента
+//! \param cells Клетки пути, по одной на каждый шаг времени
+//!
+void CooperativePlanner::reserve(int id, const QVector<int>& cells) {
+    for (int t = 0; t < cells.size(); t++) {
+        reservations[slot(cells[t], t)] = id;
+        lastReserved[cells[t]] = qMax(lastReserved.value(cells[t], -1), t);
+    }
+    parked[cells.last()] = cells.size() - 1;
+}
+
+//!
+//! Проверка возможности перехода агента между клетками за один шаг времени
+//! Запрещены: занятая в следующий момент клетка, клетка с припаркованным агентом
+//! и обмен местами с другим агентом
+//!
+//! \param id Номер агента
+//! \param from Текущая клетка
+//! \param to Следующая клетка
+//! \param time Текущий момент времени
+//! \return Свободен переход или нет
+//!
+bool CooperativePlanner::available(int id, int from, int to, int time) const {
+    int other = reservations.value(slot(to, time + 1), id);
+    if (other != id) return false;
+    if (parked.contains(to) && parked[to] <= time + 1) return false;
+    if (from != to) {
+        int swap = reservations.value(slot(to, time), id);
+        if (swap != id && reservations.value(slot(from, time + 1), id) == swap) return false;
+    }
+    return true;
+}
+
+int CooperativePlanner::index(const QPoint& meshCoord) const {
+    return meshCoord.x() * rows + meshCoord.y();
+}
+
+QPoint CooperativePlanner::coord(int idx) const {
+    return QPoint(idx / rows, idx % rows);
+}
+
+//!
+//! Ближайшая клетка сетки к точке карты
+//!
+int CooperativePlanner::snap(const QPoint& point) const {
+    int i = qBound(0, qRound((double)point.x() / cellSize), cols - 1);
+    int j = qBound(0, qRound((double)point.y() / cellSize), rows - 1);
+    return index(QPoint(i, j));
+}
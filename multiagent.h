@@ -0,0 +1,49 @@
+#ifndef MULTIAGENT_H
+#define MULTIAGENT_H
+
+#include <QVector>
+#include <QHash>
+#include <QPoint>
+#include "meshpoint.h"
+#include "flowfield.h"
+
+struct Agent {
+    QPoint start;
+    QPoint goal;
+    QVector<MeshPoint> way;
+    double cost = 0;
+    bool solved = false;
+
+    Agent() = default;
+
+    Agent(QPoint s, QPoint g) {
+        this->start = s;
+        this->goal = g;
+    }
+};
+
+class CooperativePlanner {
+public:
+    CooperativePlanner(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows, int cellSize);
+    qint64 plan(QVector<Agent>& agents, int horizon = 0, qint64 budget = 0);
+
+protected:
+    const QHash<QPoint, MeshPoint>& mesh;
+    int cols, rows, cellSize;
+
+    QVector<double> walkness;
+    QHash<quint64, int> reservations;
+    QHash<int, int> parked;
+    QHash<int, int> lastReserved;
+    qint64 budget = 0;
+
+    bool planAgent(int id, Agent& agent, const FlowField& heuristic, int horizon);
+    void reserve(int id, const QVector<int>& cells);
+    bool available(int id, int from, int to, int time) const;
+
+    int index(const QPoint& meshCoord) const;
+    QPoint coord(int idx) const;
+    int snap(const QPoint& point) const;
+};
+
+#endif // MULTIAGENT_H
@@ -12,10 +12,18 @@ struct PriorityQueue {
         return elements.empty();
     }
 
+    inline size_t size() const {
+        return elements.size();
+    }
+
     inline void put(T item, priority_t priority) {
         elements.emplace(priority, item);
     }
 
+    inline const element& top() const {
+        return elements.top();
+    }
+
     T get() {
         T best_item = elements.top().second;
         elements.pop();
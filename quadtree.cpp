@@ -0,0 +1,191 @@
+//!
+//! Адаптивная сетка (квадродерево).
+//! Ячейки остаются крупными там, где область целиком свободна или целиком лежит в одном препятствии,
+//! и делятся до минимального размера только вдоль границ полигонов
+//!
+
+#include "quadtree.h"
+#include "utils.h"
+
+//!
+//! Построить квадродерево по препятствиям карты
+//!
+//! \param obstacles Препятствия
+//! \param width Ширина карты
+//! \param height Высота карты
+//! \param minSize Минимальный размер ячейки (как `Field::cellSize`)
+//!
+void QuadTree::build(const QVector<Obstacle>& obstacles, int width, int height, int minSize) {
+    clear();
+    this->obstacles = &obstacles;
+    this->width = width;
+    this->height = height;
+    this->minSize = minSize;
+    cols = (width + minSize - 1) / minSize;
+    rows = (height + minSize - 1) / minSize;
+    lookup.fill(-1, cols * rows);
+
+    int rootSize = minSize;
+    while (rootSize < width || rootSize < height) rootSize *= 2;
+
+    QVector<int> candidates;
+    for (int i = 0; i < obstacles.size(); i++) candidates.append(i);
+    subdivide(0, 0, rootSize, candidates);
+    linkNeighbors();
+    this->obstacles = 0;
+}
+
+//!
+//! Очистить квадродерево
+//!
+void QuadTree::clear() {
+    leaves.clear();
+    lookup.clear();
+    cols = rows = 0;
+}
+
+//!
+//! Рекурсивное деление области.
+//! Область становится листом, если ни одно ребро препятствий её не пересекает
+//!
+//! \param x Левая граница области
+//! \param y Верхняя граница области
+//! \param size Размер стороны области
+//! \param candidates Индексы препятствий, чьи границы могут пересекать область
+//!
+void QuadTree::subdivide(int x, int y, int size, const QVector<int>& candidates) {
+    if (x >= width || y >= height) return;
+    QRect region(x, y, qMin(size, width - x), qMin(size, height - y));
+
+    if (size <= minSize) {
+        double walkness = 0.;
+        for (int idx : candidates) {
+            const Obstacle& obst = (*obstacles)[idx];
+            if (obst.poly.containsPoint(region.topLeft(), Qt::FillRule::OddEvenFill)) {
+                walkness = obst.walkness;
+                break;
+            }
+        }
+        addLeaf(region, walkness);
+        return;
+    }
+
+    QVector<int> touching;
+    bool uniform = true;
+    double walkness = 0.;
+    QRect bounds = region.adjusted(0, 0, 1, 1);
+    for (int idx : candidates) {
+        const Obstacle& obst = (*obstacles)[idx];
+        if (!obst.poly.boundingRect().intersects(bounds)) continue;
+        touching.append(idx);
+        if (!uniform) continue;
+
+        for (int i = 0; i < obst.poly.size(); i++) {
+            QLine edge(obst.poly[i], obst.poly[(i + 1) % obst.poly.size()]);
+            if (lineIntersectsRect(edge, region)) {
+                uniform = false;
+                break;
+            }
+        }
+        if (uniform && obst.poly.containsPoint(region.center(), Qt::FillRule::OddEvenFill)) {
+            walkness = obst.walkness;
+        }
+    }
+
+    if (uniform) {
+        addLeaf(region, walkness);
+        return;
+    }
+
+    int half = size / 2;
+    subdivide(x, y, half, touching);
+    subdivide(x + half, y, half, touching);
+    subdivide(x, y + half, half, touching);
+    subdivide(x + half, y + half, half, touching);
+}
+
+//!
+//! Добавить лист и отметить его в таблице минимальных ячеек
+//!
+//! \param rect Область листа
+//! \param walkness Непроходимость листа
+//!
+void QuadTree::addLeaf(const QRect& rect, double walkness) {
+    int idx = leaves.size();
+    leaves.append(QuadCell(rect, walkness));
+
+    int cx = rect.left() / minSize;
+    int cy = rect.top() / minSize;
+    int cw = (rect.width() + minSize - 1) / minSize;
+    int ch = (rect.height() + minSize - 1) / minSize;
+    for (int i = cx; i < cx + cw; i++) {
+        for (int j = cy; j < cy + ch; j++) {
+            lookup[i * rows + j] = idx;
+        }
+    }
+}
+
+//!
+//! Связать два листа как соседей
+//!
+void QuadTree::link(int a, int b) {
+    if (leaves[a].neighbors.contains(b)) return;
+    leaves[a].neighbors.append(b);
+    leaves[b].neighbors.append(a);
+}
+
+//!
+//! Построить граф смежности листьев.
+//! Для каждого листа просматриваются минимальные ячейки справа и снизу от него
+//!
+void QuadTree::linkNeighbors() {
+    for (int idx = 0; idx < leaves.size(); idx++) {
+        const QRect& rect = leaves[idx].rect;
+        int cx = rect.left() / minSize;
+        int cy = rect.top() / minSize;
+        int cw = (rect.width() + minSize - 1) / minSize;
+        int ch = (rect.height() + minSize - 1) / minSize;
+
+        if (cx + cw < cols) {
+            for (int j = cy; j < cy + ch; j++) link(idx, lookup[(cx + cw) * rows + j]);
+        }
+        if (cy + ch < rows) {
+            for (int i = cx; i < cx + cw; i++) link(idx, lookup[i * rows + cy + ch]);
+        }
+    }
+}
+
+//!
+//! Найти лист по точке карты
+//!
+//! \param point Точка
+//! \return Индекс листа или -1 если точка вне карты
+//!
+int QuadTree::cellAt(const QPoint& point) const {
+    if (point.x() < 0 || point.y() < 0) return -1;
+    int i = point.x() / minSize;
+    int j = point.y() / minSize;
+    if (i >= cols || j >= rows) return -1;
+    return lookup[i * rows + j];
+}
+
+//!
+//! Получить лист по индексу
+//!
+const QuadCell& QuadTree::cell(int idx) const {
+    return leaves[idx];
+}
+
+//!
+//! Получить все листья
+//!
+const QVector<QuadCell>& QuadTree::cells() const {
+    return leaves;
+}
+
+//!
+//! Количество листьев
+//!
+int QuadTree::count() const {
+    return leaves.size();
+}
@@ -0,0 +1,46 @@
+#ifndef QUADTREE_H
+#define QUADTREE_H
+
+#include <QVector>
+#include <QRect>
+#include "obstacle.h"
+
+struct QuadCell {
+    QRect rect;
+    double walkness;
+    QVector<int> neighbors;
+
+    QuadCell() = default;
+
+    QuadCell(QRect r, double w) {
+        this->rect = r;
+        this->walkness = w;
+    }
+};
+
+class QuadTree {
+public:
+    void build(const QVector<Obstacle>& obstacles, int width, int height, int minSize);
+    void clear();
+
+    int cellAt(const QPoint& point) const;
+    const QuadCell& cell(int idx) const;
+    const QVector<QuadCell>& cells() const;
+    int count() const;
+
+protected:
+    const QVector<Obstacle>* obstacles = 0;
+    int width = 0, height = 0;
+    int minSize = 1;
+    int cols = 0, rows = 0;
+
+    QVector<QuadCell> leaves;
+    QVector<int> lookup;
+
+    void subdivide(int x, int y, int size, const QVector<int>& candidates);
+    void addLeaf(const QRect& rect, double walkness);
+    void link(int a, int b);
+    void linkNeighbors();
+};
+
+#endif // QUADTREE_H
@@ -0,0 +1,224 @@
+//!
+//! Поиск пересечений рёбер препятствий заметающей прямой (Bentley-Ottmann).
+//! Прямая идёт слева направо по событиям: концы рёбер и найденные точки пересечения.
+//! В статусе хранятся рёбра, пересекающие прямую, упорядоченные снизу вверх; проверяются только
+//! соседние в статусе рёбра, поэтому время работы O((n + k) log n), где k -- количество пересечений.
+//! Наличие пересечения проверяется точно в целых числах (`linesIntersect`), координаты в double
+//! используются только для порядка событий и статуса.
+//! Соседние рёбра одного полигона касаются в общей вершине -- это не считается пересечением,
+//! если только они не накладываются друг на друга
+//!
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <limits>
+#include <QDebug>
+#include "sweepline.h"
+#include "utils.h"
+
+static const double epsilon = 1e-9;
+
+static int orient(const QPoint& a, const QPoint& b, const QPoint& c) {
+    qint64 v = (qint64)(b.x() - a.x()) * (c.y() - a.y()) - (qint64)(b.y() - a.y()) * (c.x() - a.x());
+    return (v > 0) - (v < 0);
+}
+
+static bool onSegment(const QPoint& a, const QPoint& b, const QPoint& c) {
+    return orient(a, b, c) == 0
+        && qMin(a.x(), b.x()) <= c.x() && c.x() <= qMax(a.x(), b.x())
+        && qMin(a.y(), b.y()) <= c.y() && c.y() <= qMax(a.y(), b.y());
+}
+
+static bool lexLess(const QPoint& a, const QPoint& b) {
+    return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+}
+
+//!
+//! Найти все пересечения рёбер полигонов, в том числе самопересечения
+//!
+//! \param polygons Полигоны (замкнутые: последняя вершина соединяется с первой)
+//! \return Пересечения, упорядоченные по номерам полигонов и рёбер
+//!
+QVector<EdgeCrossing> SweepLine::find(const QVector<QPolygon>& polygons) {
+    segments.clear();
+    reported.clear();
+    result.clear();
+
+    typedef std::pair<double, double> Event;
+    std::map<Event, QVector<int>> events;
+    for (int i = 0; i < polygons.size(); i++) {
+        const QPolygon& poly = polygons[i];
+        int first = segments.size();
+        for (int k = 0; k < poly.size(); k++) {
+            QPoint a = poly[k], b = poly[(k + 1) % poly.size()];
+            if (a == b) continue;
+            if (lexLess(b, a)) std::swap(a, b);
+            segments.append({ a, b, i, k, -1 });
+        }
+        for (int s = first; s < segments.size(); s++) {
+            segments[s].next = s + 1 < segments.size() ? s + 1 : first;
+        }
+    }
+    for (int s = 0; s < segments.size(); s++) {
+        events[Event(segments[s].p.x(), segments[s].p.y())].append(s);
+        events[Event(segments[s].q.x(), segments[s].q.y())];
+    }
+
+    struct Order {
+        typedef void is_transparent;
+        const SweepLine* sweep;
+        bool operator()(int a, int b) const { return sweep->below(a, b); }
+        bool operator()(int a, double y) const { return sweep->yAt(a) < y; }
+        bool operator()(double y, int a) const { return y < sweep->yAt(a); }
+    };
+    std::set<int, Order> status(Order{ this });
+
+    auto schedule = [&](std::set<int, Order>::iterator a, std::set<int, Order>::iterator b) {
+        if (a == status.end() || b == status.end()) return;
+        QPointF point;
+        if (!check(*a, *b, point)) return;
+        report(*a, *b, point);
+        Event key(point.x(), point.y());
+        if (key > Event(sx, sy)) events[key];
+    };
+
+    while (!events.empty()) {
+        auto event = events.begin();
+        sx = event->first.first;
+        sy = event->first.second;
+        QVector<int> upper = event->second;
+        events.erase(event);
+
+        // Рёбра, проходящие через точку события или заканчивающиеся в ней, идут в статусе подряд
+        QVector<int> through = upper;
+        auto from = status.lower_bound(sy - epsilon);
+        auto to = status.upper_bound(sy + epsilon);
+        for (auto it = from; it != to; ++it) through.append(*it);
+        for (int i = 0; i < through.size(); i++) {
+            for (int j = i + 1; j < through.size(); j++) {
+                QPointF point;
+                if (check(through[i], through[j], point)) report(through[i], through[j], QPointF(sx, sy));
+            }
+        }
+
+        // Рёбра, продолжающиеся правее события, вставляются заново в порядке сразу после него
+        QVector<int> reinsert = upper;
+        for (auto it = from; it != to; ++it) {
+            const Segment& s = segments[*it];
+            if (s.q.x() != sx || s.q.y() != sy) reinsert.append(*it);
+        }
+        status.erase(from, to);
+        for (int s : reinsert) status.insert(s);
+
+        from = status.lower_bound(sy - epsilon);
+        to = status.upper_bound(sy + epsilon);
+        auto before = from == status.begin() ? status.end() : std::prev(from);
+        if (from == to) {
+            schedule(before, to);
+        } else {
+            schedule(before, from);
+            schedule(std::prev(to), to);
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const EdgeCrossing& a, const EdgeCrossing& b) {
+        if (a.first != b.first) return a.first < b.first;
+        if (a.firstEdge != b.firstEdge) return a.firstEdge < b.firstEdge;
+        if (a.second != b.second) return a.second < b.second;
+        return a.secondEdge < b.secondEdge;
+    });
+    qInfo() << "SweepLine::find" << "Segments" << segments.size() << "Crossings" << result.size();
+    return result;
+}
+
+//!
+//! Координата y ребра на заметающей прямой
+//! Вертикальное ребро пересекает прямую отрезком, его положением считается точка события
+//!
+double SweepLine::yAt(int s) const {
+    const Segment& seg = segments[s];
+    if (seg.p.x() == seg.q.x()) return qBound((double)seg.p.y(), sy, (double)seg.q.y());
+    return seg.p.y() + (sx - seg.p.x()) * (seg.q.y() - seg.p.y()) / (seg.q.x() - seg.p.x());
+}
+
+double SweepLine::slope(int s) const {
+    const Segment& seg = segments[s];
+    if (seg.p.x() == seg.q.x()) return std::numeric_limits<double>::infinity();
+    return (double)(seg.q.y() - seg.p.y()) / (seg.q.x() - seg.p.x());
+}
+
+//!
+//! Порядок статуса: снизу вверх на заметающей прямой, при равенстве -- сразу правее неё
+//!
+bool SweepLine::below(int a, int b) const {
+    double ya = yAt(a), yb = yAt(b);
+    if (qAbs(ya - yb) > epsilon) return ya < yb;
+    double sa = slope(a), sb = slope(b);
+    if (sa != sb) return sa < sb;
+    return a < b;
+}
+
+//!
+//! Рёбра идут в полигоне подряд и имеют общую вершину
+//!
+bool SweepLine::adjacent(int a, int b) const {
+    return segments[a].poly == segments[b].poly && (segments[a].next == b || segments[b].next == a);
+}
+
+//!
+//! Проверка пары рёбер на пересечение
+//!
+//! \param a Ребро
+//! \param b Ребро
+//! \param point Точка пересечения (при наложении -- одна из точек наложения)
+//! \return Рёбра пересекаются, и это не касание соседних рёбер в общей вершине
+//!
+bool SweepLine::check(int a, int b, QPointF& point) const {
+    const Segment& sa = segments[a];
+    const Segment& sb = segments[b];
+    if (!linesIntersect(QLine(sa.p, sa.q), QLine(sb.p, sb.q))) return false;
+
+    QPoint touch;
+    if (onSegment(sb.p, sb.q, sa.p)) touch = sa.p;
+    else if (onSegment(sb.p, sb.q, sa.q)) touch = sa.q;
+    else if (onSegment(sa.p, sa.q, sb.p)) touch = sb.p;
+    else if (onSegment(sa.p, sa.q, sb.q)) touch = sb.q;
+    else {
+        double d = (double)(sa.q.x() - sa.p.x()) * (sb.q.y() - sb.p.y()) - (double)(sa.q.y() - sa.p.y()) * (sb.q.x() - sb.p.x());
+        double t = ((double)(sb.p.x() - sa.p.x()) * (sb.q.y() - sb.p.y()) - (double)(sb.p.y() - sa.p.y()) * (sb.q.x() - sb.p.x())) / d;
+        point = QPointF(sa.p.x() + t * (sa.q.x() - sa.p.x()), sa.p.y() + t * (sa.q.y() - sa.p.y()));
+        return true;
+    }
+    point = touch;
+
+    if (adjacent(a, b)) {
+        // Общая вершина не в счёт, но наложение рёбер (разворот на 180°) -- пересечение
+        bool shared = touch == sa.p || touch == sa.q;
+        QPoint otherA = touch == sa.p ? sa.q : sa.p;
+        QPoint otherB = touch == sb.p ? sb.q : sb.p;
+        return !shared || onSegment(sa.p, sa.q, otherB) || onSegment(sb.p, sb.q, otherA);
+    }
+    return true;
+}
+
+//!
+//! Записать пересечение пары рёбер (каждая пара записывается один раз)
+//!
+void SweepLine::report(int a, int b, const QPointF& point) {
+    if (a > b) std::swap(a, b);
+    quint64 key = ((quint64)a << 32) | (quint32)b;
+    if (reported.contains(key)) return;
+    reported.insert(key);
+
+    EdgeCrossing crossing;
+    const Segment& sa = segments[a];
+    const Segment& sb = segments[b];
+    bool swap = sa.poly > sb.poly || (sa.poly == sb.poly && sa.edge > sb.edge);
+    crossing.first = swap ? sb.poly : sa.poly;
+    crossing.firstEdge = swap ? sb.edge : sa.edge;
+    crossing.second = swap ? sa.poly : sb.poly;
+    crossing.secondEdge = swap ? sa.edge : sb.edge;
+    crossing.point = point;
+    result.append(crossing);
+}
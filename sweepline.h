@@ -0,0 +1,41 @@
+#ifndef SWEEPLINE_H
+#define SWEEPLINE_H
+
+#include <QVector>
+#include <QPolygon>
+#include <QPointF>
+#include <QSet>
+
+struct EdgeCrossing {
+    int first = -1, firstEdge = -1;
+    int second = -1, secondEdge = -1;
+    QPointF point;
+
+    bool self() const { return first == second; }
+};
+
+class SweepLine {
+public:
+    QVector<EdgeCrossing> find(const QVector<QPolygon>& polygons);
+
+protected:
+    struct Segment {
+        QPoint p, q;
+        int poly, edge;
+        int next;
+    };
+
+    QVector<Segment> segments;
+    QSet<quint64> reported;
+    QVector<EdgeCrossing> result;
+    double sx = 0., sy = 0.;
+
+    double yAt(int s) const;
+    double slope(int s) const;
+    bool below(int a, int b) const;
+    bool adjacent(int a, int b) const;
+    bool check(int a, int b, QPointF& point) const;
+    void report(int a, int b, const QPointF& point);
+};
+
+#endif // SWEEPLINE_H
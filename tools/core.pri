@@ -0,0 +1,56 @@
+# Исходники поля и алгоритмов поиска пути без интерфейса (Qt Widgets не требуется)
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    $$PWD/../alternatives.cpp \
+    $$PWD/../anytimesearch.cpp \
+    $$PWD/../cellgrid.cpp \
+    $$PWD/../clearance.cpp \
+    $$PWD/../connectivity.cpp \
+    $$PWD/../field.cpp \
+    $$PWD/../flowfield.cpp \
+    $$PWD/../frontiersearch.cpp \
+    $$PWD/../geometry.cpp \
+    $$PWD/../gridsearch.cpp \
+    $$PWD/../hierarchy.cpp \
+    $$PWD/../landmarks.cpp \
+    $$PWD/../lineofsight.cpp \
+    $$PWD/../liveplanner.cpp \
+    $$PWD/../mapjournal.cpp \
+    $$PWD/../maploader.cpp \
+    $$PWD/../mapsnapshot.cpp \
+    $$PWD/../multiagent.cpp \
+    $$PWD/../quadtree.cpp \
+    $$PWD/../sweepline.cpp \
+    $$PWD/../tourplanner.cpp \
+    $$PWD/../tracerecorder.cpp \
+    $$PWD/../utils.cpp
+
+HEADERS += \
+    $$PWD/../alternatives.h \
+    $$PWD/../anytimesearch.h \
+    $$PWD/../cellgrid.h \
+    $$PWD/../clearance.h \
+    $$PWD/../connectivity.h \
+    $$PWD/../field.h \
+    $$PWD/../flowfield.h \
+    $$PWD/../frontiersearch.h \
+    $$PWD/../geometry.h \
+    $$PWD/../gridsearch.h \
+    $$PWD/../hierarchy.h \
+    $$PWD/../landmarks.h \
+    $$PWD/../lineofsight.h \
+    $$PWD/../liveplanner.h \
+    $$PWD/../mapjournal.h \
+    $$PWD/../maploader.h \
+    $$PWD/../mapsnapshot.h \
+    $$PWD/../meshpoint.h \
+    $$PWD/../multiagent.h \
+    $$PWD/../obstacle.h \
+    $$PWD/../prioqueue.h \
+    $$PWD/../quadtree.h \
+    $$PWD/../sweepline.h \
+    $$PWD/../tourplanner.h \
+    $$PWD/../tracerecorder.h \
+    $$PWD/../utils.h
@@ -0,0 +1,127 @@
+//!
+//! Генератор нагрузки для сервера путей.
+//! Открывает несколько подключений, держит в каждом до `window` неотвеченных запросов
+//! со случайными стартом и финишем и по окончании выводит пропускную способность и распределение задержек
+//!
+
+#include <algorithm>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QLocalSocket>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QHash>
+#include "pathprotocol.h"
+
+struct Connection {
+    QLocalSocket* socket = 0;
+    QByteArray buffer;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Генератор нагрузки для сервера путей");
+    parser.addHelpOption();
+    QCommandLineOption nameOption(QStringList() << "n" << "name", "Имя локального сокета", "name", pathServerName);
+    QCommandLineOption requestsOption(QStringList() << "r" << "requests", "Количество запросов", "count", "10000");
+    QCommandLineOption connectionsOption(QStringList() << "c" << "connections", "Количество подключений", "count", "4");
+    QCommandLineOption windowOption(QStringList() << "w" << "window", "Неотвеченных запросов на подключение", "count", "32");
+    QCommandLineOption seedOption(QStringList() << "s" << "seed", "Начальное значение генератора", "seed", "1");
+    parser.addOption(nameOption);
+    parser.addOption(requestsOption);
+    parser.addOption(connectionsOption);
+    parser.addOption(windowOption);
+    parser.addOption(seedOption);
+    parser.process(a);
+
+    QTextStream out(stdout);
+    const quint32 total = qMax(1, parser.value(requestsOption).toInt());
+    const int window = qMax(1, parser.value(windowOption).toInt());
+    QRandomGenerator random(parser.value(seedOption).toUInt());
+
+    QVector<Connection> connections(qMax(1, parser.value(connectionsOption).toInt()));
+    QHash<quint32, qint64> sent;
+    QVector<quint32> latencies;
+    quint32 nextId = 1;
+    quint32 received = 0, found = 0, suboptimal = 0;
+    double worstBound = 1.;
+    QSize mapSize;
+    QElapsedTimer clock;
+
+    auto sendQuery = [&](Connection& connection) {
+        if (nextId > total) return;
+        PathQuery query;
+        query.id = nextId++;
+        query.start = QPoint(random.bounded(mapSize.width()), random.bounded(mapSize.height()));
+        query.finish = QPoint(random.bounded(mapSize.width()), random.bounded(mapSize.height()));
+        sent[query.id] = clock.nsecsElapsed();
+        connection.socket->write(encodePathQuery(query));
+    };
+
+    auto summary = [&]() {
+        double seconds = clock.nsecsElapsed() / 1e9;
+        std::sort(latencies.begin(), latencies.end());
+        auto at = [&latencies](double q) { return latencies[qMin((int)latencies.size() - 1, (int)(q * latencies.size()))]; };
+        out << "Requests: " << received << " (paths found: " << found << ", not shortest: " << suboptimal << ", worst bound: " << worstBound << ")\n";
+        out << "Time: " << seconds << " s, throughput: " << received / seconds << " req/s\n";
+        out << "Latency (us): p50 " << at(0.5) << ", p90 " << at(0.9) << ", p99 " << at(0.99) << ", max " << latencies.last() << "\n";
+        out.flush();
+    };
+
+    for (int i = 0; i < connections.size(); i++) {
+        Connection& connection = connections[i];
+        connection.socket = new QLocalSocket(&a);
+        QObject::connect(connection.socket, &QLocalSocket::errorOccurred, [&a, &out, &connection]() {
+            out << "Connection error: " << connection.socket->errorString() << "\n";
+            out.flush();
+            a.exit(1);
+        });
+        QObject::connect(connection.socket, &QLocalSocket::readyRead, [&, i]() {
+            Connection& connection = connections[i];
+            connection.buffer.append(connection.socket->readAll());
+            QByteArray frame;
+            while (takeFrame(connection.buffer, frame)) {
+                if (frameType(frame) == STATS_REPLY) {
+                    PathStats stats = decodeStatsReply(frame);
+                    if (mapSize.isEmpty()) {
+                        mapSize = QSize(stats.width, stats.height);
+                        out << "Map: " << stats.width << " x " << stats.height << "\n";
+                        clock.start();
+                        for (Connection& c : connections) {
+                            for (int k = 0; k < window; k++) sendQuery(c);
+                        }
+                    } else {
+                        out << "Server: served " << stats.served << ", p50 " << stats.p50 << ", p99 " << stats.p99 << " (us)\n";
+                        out.flush();
+                        a.quit();
+                    }
+                } else if (frameType(frame) == PATH_REPLY) {
+                    PathReply reply = decodePathReply(frame);
+                    latencies.append((clock.nsecsElapsed() - sent.take(reply.id)) / 1000);
+                    received++;
+                    if (reply.length > 0) found++;
+                    if (reply.length > 0 && !reply.optimal) suboptimal++;
+                    if (reply.length > 0) worstBound = qMax(worstBound, reply.bound);
+                    if (received == total) {
+                        summary();
+                        connection.socket->write(encodeStatsQuery(0));
+                    } else {
+                        sendQuery(connection);
+                    }
+                }
+            }
+        });
+        connection.socket->connectToServer(parser.value(nameOption));
+        if (!connection.socket->waitForConnected(3000)) {
+            out << "Cannot connect to " << parser.value(nameOption) << ": " << connection.socket->errorString() << "\n";
+            return 1;
+        }
+    }
+
+    connections[0].socket->write(encodeStatsQuery(0));
+    return a.exec();
+}
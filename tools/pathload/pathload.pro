@@ -0,0 +1,16 @@
+QT       += core network
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = pathload
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    ../pathprotocol.cpp \
+    main.cpp
+
+HEADERS += \
+    ../pathprotocol.h
@@ -0,0 +1,123 @@
+//!
+//! Двоичный протокол сервера путей.
+//! Каждое сообщение -- кадр: длина (quint32) и тело, которое начинается с типа сообщения (`PathMessage`).
+//! Числа записываются в порядке байт QDataStream (big-endian), координаты -- 16-битные
+//! (размер карты не превышает `Field::maxWidth` x `Field::maxHeight`).
+//!
+//! PATH_QUERY:  id (quint32), старт (2 x qint16), финиш (2 x qint16)
+//! PATH_REPLY:  id (quint32), длина (double, как у `Field::findPath`), кратчайший ли путь (quint8) и во сколько раз
+//!              он может быть длиннее кратчайшего (double, см. `SearchQuality`), количество точек (quint32), точки от старта к финишу
+//! STATS_QUERY: id (quint32)
+//! STATS_REPLY: id, ширина и высота карты, количество ответов (quint64), запросов в секунду (double),
+//!              задержка p50, p90, p99 и максимум (мкс, quint32)
+//!
+
+#include <QDataStream>
+#include <QIODevice>
+#include "pathprotocol.h"
+
+static QByteArray frame(const QByteArray& body) {
+    QByteArray result;
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream << (quint32)body.size();
+    result.append(body);
+    return result;
+}
+
+QByteArray encodePathQuery(const PathQuery& query) {
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream << (quint8)PATH_QUERY << query.id
+           << (qint16)query.start.x() << (qint16)query.start.y()
+           << (qint16)query.finish.x() << (qint16)query.finish.y();
+    return frame(body);
+}
+
+QByteArray encodePathReply(const PathReply& reply) {
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream << (quint8)PATH_REPLY << reply.id << reply.length << (quint8)reply.optimal << reply.bound << (quint32)reply.points.size();
+    for (const QPoint& point : reply.points) stream << (qint16)point.x() << (qint16)point.y();
+    return frame(body);
+}
+
+QByteArray encodeStatsQuery(quint32 id) {
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream << (quint8)STATS_QUERY << id;
+    return frame(body);
+}
+
+QByteArray encodeStatsReply(const PathStats& stats) {
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream << (quint8)STATS_REPLY << stats.id << stats.width << stats.height << stats.served << stats.throughput
+           << stats.p50 << stats.p90 << stats.p99 << stats.max;
+    return frame(body);
+}
+
+//!
+//! Извлечь из буфера следующий полный кадр
+//!
+//! \param buffer Принятые данные; извлечённый кадр из него удаляется
+//! \param frame Тело кадра
+//! \return Был ли в буфере полный кадр
+//!
+bool takeFrame(QByteArray& buffer, QByteArray& frame) {
+    if (buffer.size() < 4) return false;
+    QDataStream stream(buffer);
+    quint32 size;
+    stream >> size;
+    if ((quint32)buffer.size() - 4 < size) return false;
+    frame = buffer.mid(4, size);
+    buffer.remove(0, 4 + size);
+    return true;
+}
+
+quint8 frameType(const QByteArray& frame) {
+    return frame.isEmpty() ? 0 : (quint8)frame[0];
+}
+
+PathQuery decodePathQuery(const QByteArray& frame) {
+    QDataStream stream(frame);
+    quint8 type;
+    qint16 sx, sy, fx, fy;
+    PathQuery query;
+    stream >> type >> query.id >> sx >> sy >> fx >> fy;
+    query.start = QPoint(sx, sy);
+    query.finish = QPoint(fx, fy);
+    return query;
+}
+
+PathReply decodePathReply(const QByteArray& frame) {
+    QDataStream stream(frame);
+    quint8 type, optimal;
+    quint32 count;
+    PathReply reply;
+    stream >> type >> reply.id >> reply.length >> optimal >> reply.bound >> count;
+    reply.optimal = optimal != 0;
+    reply.points.reserve(count);
+    for (quint32 i = 0; i < count && !stream.atEnd(); i++) {
+        qint16 x, y;
+        stream >> x >> y;
+        reply.points.append(QPoint(x, y));
+    }
+    return reply;
+}
+
+quint32 decodeStatsQuery(const QByteArray& frame) {
+    QDataStream stream(frame);
+    quint8 type;
+    quint32 id;
+    stream >> type >> id;
+    return id;
+}
+
+PathStats decodeStatsReply(const QByteArray& frame) {
+    QDataStream stream(frame);
+    quint8 type;
+    PathStats stats;
+    stream >> type >> stats.id >> stats.width >> stats.height >> stats.served >> stats.throughput
+           >> stats.p50 >> stats.p90 >> stats.p99 >> stats.max;
+    return stats;
+}
@@ -0,0 +1,50 @@
+#ifndef PATHPROTOCOL_H
+#define PATHPROTOCOL_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QPoint>
+
+static constexpr const char* pathServerName = "c2-practice-path";
+
+enum PathMessage : quint8 {
+    PATH_QUERY = 1,
+    PATH_REPLY = 2,
+    STATS_QUERY = 3,
+    STATS_REPLY = 4
+};
+
+struct PathQuery {
+    quint32 id = 0;
+    QPoint start, finish;
+};
+
+struct PathReply {
+    quint32 id = 0;
+    double length = -1;
+    bool optimal = true;
+    double bound = 1.;
+    QVector<QPoint> points;
+};
+
+struct PathStats {
+    quint32 id = 0;
+    quint32 width = 0, height = 0;
+    quint64 served = 0;
+    double throughput = 0;
+    quint32 p50 = 0, p90 = 0, p99 = 0, max = 0;
+};
+
+QByteArray encodePathQuery(const PathQuery& query);
+QByteArray encodePathReply(const PathReply& reply);
+QByteArray encodeStatsQuery(quint32 id);
+QByteArray encodeStatsReply(const PathStats& stats);
+
+bool takeFrame(QByteArray& buffer, QByteArray& frame);
+quint8 frameType(const QByteArray& frame);
+PathQuery decodePathQuery(const QByteArray& frame);
+PathReply decodePathReply(const QByteArray& frame);
+quint32 decodeStatsQuery(const QByteArray& frame);
+PathStats decodeStatsReply(const QByteArray& frame);
+
+#endif // PATHPROTOCOL_H
@@ -0,0 +1,58 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThreadPool>
+#include <QDebug>
+#include "field.h"
+#include "pathserver.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Сервер поиска путей по карте");
+    parser.addHelpOption();
+    parser.addPositionalArgument("map", "XML-файл карты");
+    QCommandLineOption nameOption(QStringList() << "n" << "name", "Имя локального сокета", "name", pathServerName);
+    QCommandLineOption threadsOption(QStringList() << "t" << "threads", "Количество рабочих потоков", "count");
+    QCommandLineOption idleOption("idle", "Через сколько секунд простоя рабочий поток завершается и освобождает таблицы поиска", "s", "30");
+    QCommandLineOption batchOption(QStringList() << "b" << "batch", "Количество запросов в одной задаче пула", "count", "8");
+    QCommandLineOption budgetOption("budget", "Бюджет памяти одного поиска пути, КиБ (0 -- без ограничения)", "kib", "0");
+    QCommandLineOption deadlineOption("deadline", "Время на один поиск пути, мс (0 -- без ограничения, иначе ARA*)", "ms", "0");
+    QCommandLineOption radiusOption("radius", "Радиус агента, пикселей (0 -- точечный агент)", "px", "0");
+    QCommandLineOption hierarchyOption("hierarchy", "Искать пути по иерархии сжатия: загрузить её из файла рядом с картой или построить и сохранить");
+    parser.addOption(nameOption);
+    parser.addOption(threadsOption);
+    parser.addOption(idleOption);
+    parser.addOption(batchOption);
+    parser.addOption(budgetOption);
+    parser.addOption(deadlineOption);
+    parser.addOption(radiusOption);
+    parser.addOption(hierarchyOption);
+    parser.process(a);
+    if (parser.positionalArguments().size() != 1) parser.showHelp(1);
+
+    if (parser.isSet(threadsOption)) QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(threadsOption).toInt()));
+    QThreadPool::globalInstance()->setExpiryTimeout(qMax(0, parser.value(idleOption).toInt()) * 1000);
+
+    Field field(Field::minWidth, Field::minHeight);
+    field.hierarchyNearMap = parser.isSet(hierarchyOption);
+    int code = field.loadMap(parser.positionalArguments().first());
+    if (code < 0) {
+        qCritical() << "pathserver" << "Map load failed" << code;
+        return 1;
+    }
+    if (parser.isSet(hierarchyOption) && !field.hasHierarchy()) {
+        qInfo() << "pathserver" << "Hierarchy built in" << field.buildHierarchy() << "ms";
+        if (field.saveHierarchy(parser.positionalArguments().first() + ContractionHierarchy::fileSuffix) < 0) qWarning() << "pathserver" << "Hierarchy not saved";
+    }
+
+    PathServer server(field.getStore(), qMax(1, parser.value(batchOption).toInt()));
+    SearchLimits limits;
+    limits.budget = parser.value(budgetOption).toLongLong() * 1024;
+    limits.deadline = parser.value(deadlineOption).toInt();
+    limits.radius = qMax(0., parser.value(radiusOption).toDouble());
+    server.setLimits(limits);
+    if (!server.listen(parser.value(nameOption))) return 1;
+    return a.exec();
+}
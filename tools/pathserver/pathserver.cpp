@@ -0,0 +1,175 @@
+//!
+//! Сервер поиска путей.
+//! Принимает запросы по локальному сокету (`QLocalServer`, на Unix -- доменный сокет),
+//! собирает пришедшие за одну итерацию цикла событий запросы в пакет и раздаёт его пулу потоков
+//! частями по `batchSize` запросов. Каждый поток ищет пути по одному снимку карты (`MapSnapshot`)
+//! и отправляет ответ сразу после его готовности, не дожидаясь остальных запросов пакета
+//!
+
+#include <algorithm>
+#include <QThreadPool>
+#include <QDebug>
+#include "pathserver.h"
+
+PathServer::PathServer(MapStore& store, int batchSize, QObject* parent) : QObject(parent), store(store), batchSize(batchSize) {
+    clock.start();
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(0);
+    connect(&flushTimer, &QTimer::timeout, this, &PathServer::dispatch);
+    connect(&reportTimer, &QTimer::timeout, this, &PathServer::report);
+    connect(&server, &QLocalServer::newConnection, this, &PathServer::accept);
+    reportTimer.start(5000);
+}
+
+//!
+//! Начать приём подключений
+//!
+//! \param name Имя локального сокета
+//! \return Успех или нет
+//!
+bool PathServer::listen(const QString& name) {
+    QLocalServer::removeServer(name);
+    if (!server.listen(name)) {
+        qWarning() << "PathServer::listen" << server.errorString();
+        return false;
+    }
+    qInfo() << "PathServer::listen" << server.fullServerName() << "Threads" << QThreadPool::globalInstance()->maxThreadCount();
+    return true;
+}
+
+//!
+//! Задать ограничения одного поиска пути: память и время (см. `MapSnapshot::findPath`)
+//!
+//! \param limits Ограничения
+//!
+void PathServer::setLimits(const SearchLimits& limits) {
+    this->limits = limits;
+}
+
+//!
+//! Счётчики сервера
+//! Пропускная способность считается с момента последнего отчёта, задержки -- по последним `latencyWindow` ответам
+//!
+PathStats PathServer::stats() {
+    PathStats result;
+    QSharedPointer<const MapSnapshot> snap = store.snapshot();
+    if (!snap.isNull()) {
+        result.width = snap->width;
+        result.height = snap->height;
+    }
+    result.served = served;
+    qint64 now = clock.elapsed();
+    if (now > lastReport) result.throughput = (served - servedReported) * 1000. / (now - lastReport);
+
+    QVector<quint32> sorted(latencies);
+    std::sort(sorted.begin(), sorted.end());
+    if (!sorted.isEmpty()) {
+        auto at = [&sorted](double q) { return sorted[qMin((int)sorted.size() - 1, (int)(q * sorted.size()))]; };
+        result.p50 = at(0.5);
+        result.p90 = at(0.9);
+        result.p99 = at(0.99);
+        result.max = sorted.last();
+    }
+    return result;
+}
+
+void PathServer::accept() {
+    while (QLocalSocket* socket = server.nextPendingConnection()) {
+        buffers[socket] = QByteArray();
+        connect(socket, &QLocalSocket::readyRead, this, &PathServer::receive);
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+//!
+//! Разбор принятых кадров
+//! Запросы путей откладываются до конца итерации цикла событий, запросы статистики обслуживаются сразу
+//!
+void PathServer::receive() {
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    if (socket == 0) return;
+    QByteArray& buffer = buffers[socket];
+    buffer.append(socket->readAll());
+
+    QByteArray frame;
+    while (takeFrame(buffer, frame)) {
+        switch (frameType(frame)) {
+            case PATH_QUERY: {
+                PendingQuery query;
+                query.socket = socket;
+                query.query = decodePathQuery(frame);
+                query.received = clock.nsecsElapsed();
+                pending.append(query);
+                break;
+            }
+            case STATS_QUERY: {
+                PathStats result = stats();
+                result.id = decodeStatsQuery(frame);
+                socket->write(encodeStatsReply(result));
+                break;
+            }
+            default:
+                qWarning() << "PathServer::receive" << "Unknown message" << frameType(frame);
+                socket->disconnectFromServer();
+                return;
+        }
+    }
+    if (!pending.isEmpty() && !flushTimer.isActive()) flushTimer.start();
+}
+
+//!
+//! Раздать накопленные запросы пулу потоков
+//!
+void PathServer::dispatch() {
+    if (pending.isEmpty()) return;
+    QSharedPointer<const MapSnapshot> snap = store.snapshot();
+    QVector<PendingQuery> batch;
+    batch.swap(pending);
+
+    for (int from = 0; from < batch.size(); from += batchSize) {
+        QVector<PendingQuery> part = batch.mid(from, batchSize);
+        SearchLimits limits = this->limits;
+        QThreadPool::globalInstance()->start([this, snap, part, limits]() {
+            QVector<MeshPoint> way;
+            SearchQuality quality;
+            for (const PendingQuery& query : part) {
+                PathReply reply;
+                reply.id = query.query.id;
+                if (!snap.isNull()) {
+                    reply.length = snap->findPath(query.query.start, query.query.finish, way, limits, &quality);
+                    reply.optimal = quality.optimal;
+                    reply.bound = quality.bound;
+                    for (int i = way.size() - 1; i >= 0; i--) reply.points.append(way[i].realCoord);
+                }
+                QMetaObject::invokeMethod(this, [this, query, reply]() { finish(query, reply); }, Qt::QueuedConnection);
+            }
+        });
+    }
+}
+
+//!
+//! Периодический отчёт в лог
+//!
+void PathServer::report() {
+    if (served == servedReported) return;
+    PathStats result = stats();
+    qInfo() << "PathServer::stats" << "Served" << result.served << "Rate" << result.throughput
+            << "p50" << result.p50 << "p99" << result.p99 << "max" << result.max << "(us)";
+    servedReported = served;
+    lastReport = clock.elapsed();
+}
+
+//!
+//! Отправить ответ и учесть его в счётчиках
+//!
+void PathServer::finish(const PendingQuery& query, const PathReply& reply) {
+    quint32 latency = (clock.nsecsElapsed() - query.received) / 1000;
+    if (latencies.size() < latencyWindow) latencies.append(latency);
+    else latencies[latencyPos] = latency;
+    latencyPos = (latencyPos + 1) % latencyWindow;
+    served++;
+    if (!query.socket.isNull()) query.socket->write(encodePathReply(reply));
+}
@@ -0,0 +1,60 @@
+#ifndef PATHSERVER_H
+#define PATHSERVER_H
+
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QHash>
+#include <QVector>
+#include "mapsnapshot.h"
+#include "pathprotocol.h"
+
+struct PendingQuery {
+    QPointer<QLocalSocket> socket;
+    PathQuery query;
+    qint64 received = 0;
+};
+
+class PathServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    PathServer(MapStore& store, int batchSize, QObject* parent = 0);
+
+    bool listen(const QString& name);
+    PathStats stats();
+    void setLimits(const SearchLimits& limits);
+
+protected slots:
+    void accept();
+    void receive();
+    void dispatch();
+    void report();
+
+protected:
+    static constexpr int latencyWindow = 4096;
+
+    MapStore& store;
+    QLocalServer server;
+    QHash<QLocalSocket*, QByteArray> buffers;
+    QVector<PendingQuery> pending;
+    QTimer flushTimer;
+    QTimer reportTimer;
+    int batchSize;
+    SearchLimits limits;
+
+    QElapsedTimer clock;
+    quint64 served = 0;
+    quint64 servedReported = 0;
+    qint64 lastReport = 0;
+    QVector<quint32> latencies;
+    int latencyPos = 0;
+
+    void finish(const PendingQuery& pending, const PathReply& reply);
+};
+
+#endif // PATHSERVER_H
@@ -0,0 +1,19 @@
+QT       += core gui network concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = pathserver
+
+include(../core.pri)
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    ../pathprotocol.cpp \
+    main.cpp \
+    pathserver.cpp
+
+HEADERS += \
+    ../pathprotocol.h \
+    pathserver.h
@@ -0,0 +1,184 @@
+//!
+//! Воспроизведение трассы работы с картой (см. `TraceRecorder`).
+//! Операции выполняются по порядку без пауз, время каждой операции измеряется отдельно,
+//! в конце выводится распределение задержек по типам операций.
+//! Настройки планировщика (размер ячейки, адаптивная сетка, раскладка клеток, поиск по снимку, ограничения поиска,
+//! радиус агента, альтернативные пути, иерархия сжатия) можно переопределить; если переопределены только раскладка,
+//! поиск по снимку и альтернативные пути, длины найденных путей сверяются с записанными
+//!
+
+#include <algorithm>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QLoggingCategory>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QFile>
+#include <QMap>
+#include <QScopedPointer>
+#include "field.h"
+
+struct ReplayOptions {
+    int cellSize = 0;
+    int adaptive = -1;
+    int layout = -1;
+    bool snapshot = false;
+    bool waitLandmarks = true;
+    bool hierarchy = false;
+    SearchLimits limits;
+    int alternatives = 1;
+};
+
+//!
+//! Выполнить одну операцию трассы
+//! Правки карты, старт, финиш и остановки применяет само поле (`Field::applyEdit`), здесь -- только создание поля,
+//! генерация сетки с переопределёнными настройками и поиск пути
+//!
+//! \return false если операция не распознана или её аргументы не подходят к текущей карте
+//!
+static bool apply(QScopedPointer<Field>& field, const QString& op, const QStringList& args, const ReplayOptions& options, double& length) {
+    auto arg = [&args](int i) { return i < args.size() ? args[i].toInt() : 0; };
+    if (op == "resize") {
+        field.reset(new Field(arg(0), arg(1)));
+        field->searchBudget = options.limits.budget;
+        field->searchDeadline = options.limits.deadline;
+        field->agentRadius = options.limits.radius;
+        field->alternativeCount = options.alternatives;
+        return true;
+    }
+    if (field.isNull()) return false;
+
+    if (op == "regen") {
+        field->cellSize = options.cellSize > 0 ? options.cellSize : arg(0);
+        field->adaptiveMesh = options.adaptive >= 0 ? options.adaptive : arg(1);
+        if (options.layout >= 0) field->cellLayout = (CellGrid::Layout)options.layout;
+        field->regenMesh();
+    } else if (op == "find") {
+        if (options.snapshot) {
+            Waypoint start = field->getStart(), end = field->getEnd();
+            QVector<MeshPoint> way;
+            length = start.has_value() && end.has_value() ? field->snapshot()->findPath(*start, *end, way, options.limits) : -1;
+        } else {
+            length = field->findPath();
+        }
+    } else {
+        return field->applyEdit(op + " " + args.join(" "));
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Воспроизведение трассы работы с картой");
+    parser.addHelpOption();
+    parser.addPositionalArgument("trace", "Файл трассы");
+    QCommandLineOption cellOption(QStringList() << "c" << "cell", "Размер ячейки сетки вместо записанного", "size");
+    QCommandLineOption adaptiveOption(QStringList() << "a" << "adaptive", "Адаптивная сетка вместо записанной настройки (0 или 1)", "flag");
+    QCommandLineOption layoutOption(QStringList() << "l" << "layout", "Раскладка клеток сетки в памяти: linear или tiled (см. `CellGrid`)", "layout");
+    QCommandLineOption snapshotOption(QStringList() << "s" << "snapshot", "Искать пути по снимку карты (MapSnapshot)");
+    QCommandLineOption noWaitOption("no-wait", "Не дожидаться построения ориентиров после генерации сетки");
+    QCommandLineOption repeatOption(QStringList() << "r" << "repeat", "Количество повторов трассы", "count", "1");
+    QCommandLineOption budgetOption("budget", "Бюджет памяти одного поиска пути, КиБ (0 -- без ограничения)", "kib", "0");
+    QCommandLineOption deadlineOption("deadline", "Время на один поиск пути, мс (0 -- без ограничения, иначе ARA*)", "ms", "0");
+    QCommandLineOption radiusOption("radius", "Радиус агента, пикселей (0 -- точечный агент)", "px", "0");
+    QCommandLineOption alternativesOption("alternatives", "Сколько разных путей искать (см. `Field::findAlternatives`, без --snapshot)", "count", "1");
+    QCommandLineOption hierarchyOption("hierarchy", "Строить иерархию сжатия после каждой генерации сетки и искать пути по ней");
+    parser.addOption(cellOption);
+    parser.addOption(adaptiveOption);
+    parser.addOption(layoutOption);
+    parser.addOption(snapshotOption);
+    parser.addOption(noWaitOption);
+    parser.addOption(repeatOption);
+    parser.addOption(budgetOption);
+    parser.addOption(deadlineOption);
+    parser.addOption(radiusOption);
+    parser.addOption(alternativesOption);
+    parser.addOption(hierarchyOption);
+    parser.process(a);
+    if (parser.positionalArguments().size() != 1) parser.showHelp(1);
+
+    ReplayOptions options;
+    if (parser.isSet(cellOption)) options.cellSize = parser.value(cellOption).toInt();
+    if (parser.isSet(adaptiveOption)) options.adaptive = parser.value(adaptiveOption).toInt() != 0;
+    if (parser.isSet(layoutOption)) {
+        QString layout = parser.value(layoutOption);
+        if (layout != "linear" && layout != "tiled") parser.showHelp(1);
+        options.layout = layout == "linear" ? CellGrid::LINEAR : CellGrid::TILED;
+    }
+    options.snapshot = parser.isSet(snapshotOption);
+    options.waitLandmarks = !parser.isSet(noWaitOption);
+    options.hierarchy = parser.isSet(hierarchyOption);
+    options.limits.budget = parser.value(budgetOption).toLongLong() * 1024;
+    options.limits.deadline = parser.value(deadlineOption).toInt();
+    options.limits.radius = qMax(0., parser.value(radiusOption).toDouble());
+    options.alternatives = qMax(1, parser.value(alternativesOption).toInt());
+    // Записанные длины получены с настройками по умолчанию: другие размер ячейки, сетка, бюджет, время, радиус
+    // или иерархия могут дать другой путь
+    bool check = !parser.isSet(cellOption) && !parser.isSet(adaptiveOption) && options.limits.budget == 0
+            && options.limits.deadline == 0 && options.limits.radius == 0. && !options.hierarchy;
+
+    QTextStream out(stdout);
+    QFile file(parser.positionalArguments().first());
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        out << "Cannot open " << file.fileName() << "\n";
+        return 1;
+    }
+    QStringList lines = QString::fromUtf8(file.readAll()).split('\n', Qt::SkipEmptyParts);
+    if (lines.isEmpty() || lines.first() != TraceRecorder::header) {
+        out << "Not a trace file: " << file.fileName() << "\n";
+        return 1;
+    }
+
+    QMap<QString, QVector<qint64>> latencies;
+    int skipped = 0, mismatched = 0, finds = 0;
+    QElapsedTimer clock;
+    for (int repeat = 0; repeat < qMax(1, parser.value(repeatOption).toInt()); repeat++) {
+        QScopedPointer<Field> field;
+        for (int i = 1; i < lines.size(); i++) {
+            QStringList parts = lines[i].split(' ', Qt::SkipEmptyParts);
+            if (parts.size() < 2 || parts[0].startsWith('#')) continue;
+            QString op = parts[1];
+            QStringList args = parts.mid(2);
+
+            double length = 0;
+            clock.start();
+            bool ok = apply(field, op, args, options, length);
+            qint64 elapsed = clock.nsecsElapsed();
+            if (!ok) {
+                skipped++;
+                continue;
+            }
+            latencies[op].append(elapsed);
+
+            if (op == "regen" && options.waitLandmarks) field->waitLandmarks();
+            if (op == "regen" && options.hierarchy) {
+                clock.start();
+                field->buildHierarchy();
+                latencies["hierarchy"].append(clock.nsecsElapsed());
+            }
+            if (op == "find") {
+                finds++;
+                if (check && qAbs(length - args.value(0).toDouble()) > 1e-3) mismatched++;
+            }
+        }
+    }
+
+    out << QString("%1 %2 %3 %4 %5 %6 %7\n").arg("op", -8).arg("count", 8).arg("mean", 10).arg("p50", 10).arg("p90", 10).arg("p99", 10).arg("max", 10);
+    for (auto it = latencies.begin(); it != latencies.end(); ++it) {
+        QVector<qint64>& values = it.value();
+        std::sort(values.begin(), values.end());
+        auto at = [&values](double q) { return values[qMin((int)values.size() - 1, (int)(q * values.size()))] / 1000.; };
+        double mean = 0;
+        for (qint64 v : values) mean += v / 1000.;
+        mean /= values.size();
+        out << QString("%1 %2 %3 %4 %5 %6 %7\n").arg(it.key(), -8).arg(values.size(), 8)
+                   .arg(mean, 10, 'f', 1).arg(at(0.5), 10, 'f', 1).arg(at(0.9), 10, 'f', 1).arg(at(0.99), 10, 'f', 1).arg(values.last() / 1000., 10, 'f', 1);
+    }
+    out << "Latency in microseconds. Skipped operations: " << skipped << "\n";
+    if (check) out << "Path lengths different from the trace: " << mismatched << " of " << finds << "\n";
+    return mismatched == 0 ? 0 : 2;
+}
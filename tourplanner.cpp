@@ -0,0 +1,320 @@
+//!
+//! Маршрут через несколько остановок.
+//! Стоимости переходов между всеми парами остановок считаются одним проходом Дейкстры от каждой
+//! остановки до всех остальных сразу (проходы независимы и идут параллельно в пуле потоков), а не
+//! N² отдельными поисками. Ветви дерева до остальных остановок сохраняются как отрезки маршрута.
+//! Первая остановка -- старт, последняя -- финиш, порядок промежуточных подбирается: точно
+//! динамикой Хелда-Карпа, пока промежуточных не больше `TourPlanner::exactStops`, иначе -- жадно
+//! от ближайшей остановки с доводкой 2-opt и Or-opt до локального минимума
+//!
+
+#include <algorithm>
+#include <limits>
+#include <QtConcurrent>
+#include <QDebug>
+#include <QElapsedTimer>
+#include "tourplanner.h"
+
+static const double infinity = std::numeric_limits<double>::infinity();
+static const double epsilon = 1e-9;
+static const QPoint evenOffsets[4] = { QPoint(0, 1), QPoint(0, -1), QPoint(-1, 0), QPoint(1, 0) };
+static const QPoint oddOffsets[4] = { QPoint(1, 0), QPoint(-1, 0), QPoint(0, -1), QPoint(0, 1) };
+
+//!
+//! \param mesh Сетка
+//! \param cols Количество столбцов сетки
+//! \param rows Количество строк сетки
+//!
+TourPlanner::TourPlanner(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows)
+    : mesh(mesh), cols(cols), rows(rows) {
+}
+
+//!
+//! Учитывать размер агента: клетки, где агент радиуса radius не помещается, считаются стенами
+//!
+//! \param map Карта расстояний до стен (0 -- не учитывать)
+//! \param radius Радиус агента в клетках сетки
+//!
+void TourPlanner::setClearance(const ClearanceMap* map, float radius) {
+    clearance = map;
+    this->radius = radius;
+}
+
+//!
+//! Посчитать стоимости и отрезки маршрута между всеми парами остановок
+//! Стоимость перехода -- сумма 1 + непроходимость по клеткам после начальной (как шаг в `Field::aStarPath`)
+//!
+//! \param stops Остановки (координаты на сетке): старт, промежуточные, финиш
+//! \return false, если какая-то остановка вне сетки или в стене
+//!
+bool TourPlanner::measure(const QVector<QPoint>& stops) {
+    QElapsedTimer timer;
+    timer.start();
+    count = stops.size();
+    costs.fill(infinity, count * count);
+    legs.fill(QVector<QPoint>(), count * count);
+    cells.clear();
+    prepare();
+    for (const QPoint& stop : stops) {
+        if (stop.x() < 0 || stop.y() < 0 || stop.x() >= cols || stop.y() >= rows) return false;
+        int cell = stop.x() * rows + stop.y();
+        if (step[cell] < 0) return false;
+        cells.append(cell);
+    }
+
+    // Отсоединение до параллельной записи: каждый проход пишет только свою строку матрицы
+    double* matrix = costs.data();
+    QVector<QPoint>* paths = legs.data();
+    QVector<int> sources;
+    for (int k = 0; k < count; k++) sources.append(k);
+    QtConcurrent::blockingMap(sources, [this, matrix, paths](int source) { search(source, matrix, paths); });
+    qInfo() << "TourPlanner::measure" << count << "stops in" << timer.elapsed() << "ms";
+    return true;
+}
+
+//!
+//! Стоимость перехода между остановками (бесконечность, если пути нет)
+//!
+double TourPlanner::cost(int from, int to) const {
+    return costs[from * count + to];
+}
+
+//!
+//! Клетки отрезка маршрута между остановками, от from к to включительно
+//!
+const QVector<QPoint>& TourPlanner::leg(int from, int to) const {
+    return legs[from * count + to];
+}
+
+//!
+//! Подобрать порядок обхода остановок
+//!
+//! \return Номера остановок в порядке обхода: первая -- 0, последняя -- count - 1; пусто, если обойти все нельзя
+//!
+QVector<int> TourPlanner::order() const {
+    if (count < 2) return QVector<int>();
+    QVector<int> result;
+    if (count - 2 <= exactStops) {
+        result = exactOrder();
+    } else {
+        result = greedyOrder();
+        for (int pass = 0; pass < maxPasses; pass++) {
+            bool improved = twoOpt(result);
+            improved = orOpt(result) || improved;
+            if (!improved) break;
+        }
+    }
+    if (result.isEmpty() || tourCost(result) == infinity) return QVector<int>();
+    return result;
+}
+
+//!
+//! Стоимость обхода остановок в данном порядке
+//!
+double TourPlanner::tourCost(const QVector<int>& order) const {
+    double total = 0.;
+    for (int k = 1; k < order.size(); k++) total += cost(order[k - 1], order[k]);
+    return total;
+}
+
+//!
+//! Стоимость шага в каждую клетку (индекс `i * rows + j`), -1 -- клетка непроходима
+//!
+void TourPlanner::prepare() {
+    step.fill(-1., cols * rows);
+    for (auto it = mesh.constBegin(); it != mesh.constEnd(); ++it) {
+        const QPoint& p = it.key();
+        if (p.x() >= cols || p.y() >= rows || it->walkness >= 1.) continue;
+        int cell = p.x() * rows + p.y();
+        if (clearance != 0 && !clearance->passable(cell, radius)) continue;
+        step[cell] = 1. + it->walkness;
+    }
+}
+
+//!
+//! Дейкстра от одной остановки до всех остальных
+//! Поиск останавливается, как только закрыты все остановки
+//!
+//! \param source Номер остановки
+//! \param matrix Матрица стоимостей (пишется строка source)
+//! \param paths Отрезки маршрута (пишется строка source)
+//!
+void TourPlanner::search(int source, double* matrix, QVector<QPoint>* paths) const {
+    QVector<double> dist(cols * rows, infinity);
+    QVector<int> parent(cols * rows, -1);
+    QVector<int> targets(cols * rows, -1);
+    int remaining = 0;
+    for (int k = 0; k < count; k++) {
+        if (k == source || targets[cells[k]] >= 0) continue;
+        targets[cells[k]] = k;
+        remaining++;
+    }
+
+    PriorityQueue<int, double> queue;
+    int root = cells[source];
+    dist[root] = 0.;
+    queue.put(root, 0.);
+    while (!queue.empty() && remaining > 0) {
+        double key = queue.top().first;
+        int ci = queue.get();
+        if (key > dist[ci]) continue;
+        if (targets[ci] >= 0) remaining--;
+
+        QPoint current(ci / rows, ci % rows);
+        const QPoint* offsets = (current.x() + current.y()) % 2 == 0 ? evenOffsets : oddOffsets;
+        for (int k = 0; k < 4; k++) {
+            QPoint next = current + offsets[k];
+            if (next.x() < 0 || next.y() < 0 || next.x() >= cols || next.y() >= rows) continue;
+            int ni = next.x() * rows + next.y();
+            if (step[ni] < 0) continue;
+            double cost = key + step[ni];
+            if (cost < dist[ni]) {
+                dist[ni] = cost;
+                parent[ni] = ci;
+                queue.put(ni, cost);
+            }
+        }
+    }
+
+    for (int k = 0; k < count; k++) {
+        int target = cells[k];
+        if (dist[target] == infinity) continue;
+        matrix[source * count + k] = dist[target];
+        QVector<QPoint>& path = paths[source * count + k];
+        for (int c = target; c >= 0; c = parent[c]) path.append(QPoint(c / rows, c % rows));
+        std::reverse(path.begin(), path.end());
+    }
+}
+
+//!
+//! Точный порядок обхода динамикой Хелда-Карпа по подмножествам промежуточных остановок
+//!
+QVector<int> TourPlanner::exactOrder() const {
+    int m = count - 2;
+    int last = count - 1;
+    if (m == 0) return { 0, last };
+    int full = (1 << m) - 1;
+    // best[mask * m + j] -- обход старта и остановок mask, заканчивающийся в остановке j + 1
+    QVector<double> best((full + 1) * m, infinity);
+    QVector<int> from((full + 1) * m, -1);
+    for (int j = 0; j < m; j++) best[(1 << j) * m + j] = cost(0, j + 1);
+    for (int mask = 1; mask <= full; mask++) {
+        for (int j = 0; j < m; j++) {
+            double base = best[mask * m + j];
+            if (!(mask & (1 << j)) || base == infinity) continue;
+            for (int k = 0; k < m; k++) {
+                if (mask & (1 << k)) continue;
+                int next = mask | (1 << k);
+                double value = base + cost(j + 1, k + 1);
+                if (value < best[next * m + k]) {
+                    best[next * m + k] = value;
+                    from[next * m + k] = j;
+                }
+            }
+        }
+    }
+
+    int end = -1;
+    double total = infinity;
+    for (int j = 0; j < m; j++) {
+        double value = best[full * m + j] + cost(j + 1, last);
+        if (value < total) {
+            total = value;
+            end = j;
+        }
+    }
+    if (end < 0) return QVector<int>();
+
+    QVector<int> result = { last };
+    for (int mask = full, j = end; j >= 0; ) {
+        result.append(j + 1);
+        int previous = from[mask * m + j];
+        mask &= ~(1 << j);
+        j = previous;
+    }
+    result.append(0);
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+//!
+//! Жадный порядок: каждый раз к ближайшей из непосещённых промежуточных остановок
+//!
+QVector<int> TourPlanner::greedyOrder() const {
+    QVector<bool> visited(count, false);
+    QVector<int> result = { 0 };
+    for (int k = 1; k < count - 1; k++) {
+        int current = result.last();
+        int next = -1;
+        for (int j = 1; j < count - 1; j++) {
+            if (!visited[j] && (next < 0 || cost(current, j) < cost(current, next))) next = j;
+        }
+        visited[next] = true;
+        result.append(next);
+    }
+    result.append(count - 1);
+    return result;
+}
+
+//!
+//! Один проход 2-opt: разворот участка order[i..j], если обход от этого дешевеет
+//! Переходы несимметричны (шаг стоит по клетке назначения), поэтому стоимость участка в обратную
+//! сторону берётся из отдельных префиксных сумм
+//!
+//! \param order Порядок обхода (старт и финиш остаются на местах)
+//! \return Было ли улучшение
+//!
+bool TourPlanner::twoOpt(QVector<int>& order) const {
+    int n = order.size();
+    QVector<double> along(n, 0.), against(n, 0.);
+    auto prefix = [&]() {
+        for (int k = 1; k < n; k++) {
+            along[k] = along[k - 1] + cost(order[k - 1], order[k]);
+            against[k] = against[k - 1] + cost(order[k], order[k - 1]);
+        }
+    };
+    prefix();
+    bool improved = false;
+    for (int i = 1; i < n - 2; i++) {
+        for (int j = i + 1; j < n - 1; j++) {
+            double before = cost(order[i - 1], order[i]) + (along[j] - along[i]) + cost(order[j], order[j + 1]);
+            double after = cost(order[i - 1], order[j]) + (against[j] - against[i]) + cost(order[i], order[j + 1]);
+            if (after < before - epsilon) {
+                std::reverse(order.begin() + i, order.begin() + j + 1);
+                prefix();
+                improved = true;
+            }
+        }
+    }
+    return improved;
+}
+
+//!
+//! Один проход Or-opt: перенос участка из 1-3 остановок в другое место обхода, если так дешевле
+//!
+//! \param order Порядок обхода (старт и финиш остаются на местах)
+//! \return Было ли улучшение
+//!
+bool TourPlanner::orOpt(QVector<int>& order) const {
+    int n = order.size();
+    bool improved = false;
+    for (int length = 1; length <= 3; length++) {
+        for (int i = 1; i + length - 1 < n - 1; i++) {
+            int e = i + length - 1;
+            double removed = cost(order[i - 1], order[i]) + cost(order[e], order[e + 1]) - cost(order[i - 1], order[e + 1]);
+            for (int k = 0; k < n - 1; k++) {
+                if (k >= i - 1 && k <= e) continue;
+                double added = cost(order[k], order[i]) + cost(order[e], order[k + 1]) - cost(order[k], order[k + 1]);
+                if (added < removed - epsilon) {
+                    QVector<int> segment = order.mid(i, length);
+                    order.remove(i, length);
+                    int at = k < i ? k + 1 : k + 1 - length;
+                    for (int s = 0; s < length; s++) order.insert(at + s, segment[s]);
+                    improved = true;
+                    break;
+                }
+            }
+        }
+    }
+    return improved;
+}
@@ -0,0 +1,44 @@
+#ifndef TOURPLANNER_H
+#define TOURPLANNER_H
+
+#include <QVector>
+#include <QHash>
+#include <QPoint>
+#include "meshpoint.h"
+#include "prioqueue.h"
+#include "clearance.h"
+
+class TourPlanner {
+public:
+    static constexpr int exactStops = 12;
+    static constexpr int maxPasses = 64;
+
+    TourPlanner(const QHash<QPoint, MeshPoint>& mesh, int cols, int rows);
+    void setClearance(const ClearanceMap* map, float radius);
+    bool measure(const QVector<QPoint>& stops);
+    double cost(int from, int to) const;
+    const QVector<QPoint>& leg(int from, int to) const;
+    QVector<int> order() const;
+    double tourCost(const QVector<int>& order) const;
+
+protected:
+    const QHash<QPoint, MeshPoint>& mesh;
+    int cols, rows;
+    const ClearanceMap* clearance = 0;
+    float radius = 0.f;
+
+    int count = 0;
+    QVector<double> step;
+    QVector<int> cells;
+    QVector<double> costs;
+    QVector<QVector<QPoint>> legs;
+
+    void prepare();
+    void search(int source, double* matrix, QVector<QPoint>* paths) const;
+    QVector<int> exactOrder() const;
+    QVector<int> greedyOrder() const;
+    bool twoOpt(QVector<int>& order) const;
+    bool orOpt(QVector<int>& order) const;
+};
+
+#endif // TOURPLANNER_H
@@ -0,0 +1,67 @@
+//!
+//! Запись трассы работы с картой.
+//! Трасса -- текстовый файл, по одной операции в строке: время от начала записи (мкс), операция и её аргументы.
+//! Операции пишет `Field` (изменения карты и поиск пути), воспроизводит их `tools/tracereplay`:
+//!
+//! resize W H                  -- новая карта размером W x H
+//! add WALKNESS N X1 Y1 ...    -- добавлено препятствие из N точек
+//! remove I                    -- удалено препятствие I
+//! insert I X Y                -- в препятствие I добавлена точка (`Field::addToObstacle`)
+//! erase I X Y                 -- из препятствия I удалена точка рядом с (X, Y) (`Field::removeFromObstacle`)
+//! move I K X Y                -- вершина K препятствия I перемещена (`Field::moveVertex`)
+//! start X Y | start -         -- установлен/убран старт
+//! end X Y | end -             -- установлен/убран финиш
+//! stop X Y | stop -           -- добавлена промежуточная остановка/убраны все остановки
+//! unstop X Y                  -- убрана остановка рядом с (X, Y) (`Field::removeStop`)
+//! regen CELL ADAPTIVE         -- сгенерирована сетка
+//! find LENGTH                 -- найден путь между текущими стартом и финишем (через остановки), LENGTH -- результат `Field::findPath`
+//!
+
+#include "tracerecorder.h"
+
+TraceRecorder::~TraceRecorder() {
+    close();
+}
+
+//!
+//! Начать запись трассы в файл
+//!
+//! \param path Путь до файла
+//! \return Успех или нет
+//!
+bool TraceRecorder::open(const QString& path) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) return false;
+    file.write(header);
+    file.write("\n");
+    clock.start();
+    return true;
+}
+
+//!
+//! Закончить запись
+//!
+void TraceRecorder::close() {
+    if (file.isOpen()) file.close();
+}
+
+bool TraceRecorder::isOpen() const {
+    return file.isOpen();
+}
+
+QString TraceRecorder::fileName() const {
+    return file.fileName();
+}
+
+//!
+//! Записать операцию
+//! Строка сразу сбрасывается на диск, чтобы трасса сохранилась и при аварийном завершении
+//!
+//! \param operation Операция с аргументами
+//!
+void TraceRecorder::record(const QString& operation) {
+    if (!file.isOpen()) return;
+    file.write(QString("%1 %2\n").arg(clock.nsecsElapsed() / 1000).arg(operation).toUtf8());
+    file.flush();
+}
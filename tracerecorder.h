@@ -0,0 +1,26 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QFile>
+#include <QString>
+#include <QElapsedTimer>
+
+class TraceRecorder {
+public:
+    static constexpr const char* header = "# c2-practice trace 1";
+
+    ~TraceRecorder();
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const;
+    QString fileName() const;
+
+    void record(const QString& operation);
+
+protected:
+    QFile file;
+    QElapsedTimer clock;
+};
+
+#endif // TRACERECORDER_H
@@ -87,16 +87,57 @@ QPoint nearestPointOnLine(const QLine& l, const QPoint& p){
 }
 
 //!
-//! Проверка на пересечение линии и полигона
+//! Проверка на пересечение двух отрезков
+//! Касание концом отрезка также считается пересечением
 //!
-//! \param line Линия
-//! \param polygon Полигон
+//! \param l1 Отрезок 1
+//! \param l2 Отрезок 2
 //! \return Успех или нет
 //!
-bool lineIntersectsPolygon(const QLine& line, const QPolygon& polygon) {
-    QPolygon t;
-    t << line.p1() << line.p2();
-    return polygon.intersects(t);
+bool linesIntersect(const QLine& l1, const QLine& l2) {
+    auto orient = [](const QPoint& a, const QPoint& b, const QPoint& c) {
+        qint64 v = (qint64)(b.x() - a.x()) * (c.y() - a.y()) - (qint64)(b.y() - a.y()) * (c.x() - a.x());
+        return (v > 0) - (v < 0);
+    };
+    auto onSegment = [](const QPoint& a, const QPoint& b, const QPoint& c) {
+        return qMin(a.x(), b.x()) <= c.x() && c.x() <= qMax(a.x(), b.x())
+            && qMin(a.y(), b.y()) <= c.y() && c.y() <= qMax(a.y(), b.y());
+    };
+
+    int o1 = orient(l1.p1(), l1.p2(), l2.p1());
+    int o2 = orient(l1.p1(), l1.p2(), l2.p2());
+    int o3 = orient(l2.p1(), l2.p2(), l1.p1());
+    int o4 = orient(l2.p1(), l2.p2(), l1.p2());
+
+    if (o1 != o2 && o3 != o4) return true;
+    if (o1 == 0 && onSegment(l1.p1(), l1.p2(), l2.p1())) return true;
+    if (o2 == 0 && onSegment(l1.p1(), l1.p2(), l2.p2())) return true;
+    if (o3 == 0 && onSegment(l2.p1(), l2.p2(), l1.p1())) return true;
+    if (o4 == 0 && onSegment(l2.p1(), l2.p2(), l1.p2())) return true;
+    return false;
+}
+
+//!
+//! Проверка на пересечение отрезка и прямоугольника
+//! Прямоугольник считается замкнутой областью [left; left + width] x [top; top + height]
+//!
+//! \param line Отрезок
+//! \param rect Прямоугольник
+//! \return Успех или нет
+//!
+bool lineIntersectsRect(const QLine& line, const QRect& rect) {
+    int x1 = rect.left(), y1 = rect.top();
+    int x2 = rect.left() + rect.width(), y2 = rect.top() + rect.height();
+    auto inside = [&](const QPoint& p) {
+        return p.x() >= x1 && p.x() <= x2 && p.y() >= y1 && p.y() <= y2;
+    };
+    if (inside(line.p1()) || inside(line.p2())) return true;
+    if (qMax(line.x1(), line.x2()) < x1 || qMin(line.x1(), line.x2()) > x2) return false;
+    if (qMax(line.y1(), line.y2()) < y1 || qMin(line.y1(), line.y2()) > y2) return false;
+    return linesIntersect(line, QLine(x1, y1, x2, y1))
+        || linesIntersect(line, QLine(x2, y1, x2, y2))
+        || linesIntersect(line, QLine(x2, y2, x1, y2))
+        || linesIntersect(line, QLine(x1, y2, x1, y1));
 }
 
 //!
@@ -11,7 +11,8 @@ double euclideanDistance(const QPoint& p1, const QPoint& p2);
 double simpleDistance(const QPoint& p1, const QPoint& p2);
 double vectorLength(const QPoint& p1);
 QPoint nearestPointOnLine(const QLine& l, const QPoint& p);
-bool lineIntersectsPolygon(const QLine& line, const QPolygon& polygon);
+bool linesIntersect(const QLine& l1, const QLine& l2);
+bool lineIntersectsRect(const QLine& line, const QRect& rect);
 QPoint polygonCentroid(const QPolygon& poly);
 
 #endif // UTILS_H